@@ -7,12 +7,30 @@
 #include "imgui_impl_opengl3.h"
 
 #include <Physics/SPHSolver.h>
+#include <Physics/SoftBodyWorld.h>
+#include <Graphic/SurfaceExtractor.h>
+#include <Graphic/ScreenSpaceFluid.h>
+#include <checkpoint.h>
+#include <trajectory.h>
+#include <Graphic/TrajectoryPlayer.h>
 
 class GUIManager
 {
 public:
     ImGuiIO *io;
     SPHSolver *solver;
+    SoftBodyWorld *softBodyWorld = nullptr;
+    SurfaceExtractor *surface = nullptr;
+    ScreenSpaceFluid *screen_fluid = nullptr;
+
+    CheckpointWriter checkpoint_writer; // saves in the background while the simulation keeps running
+    char checkpoint_path[256] = "simulation.ckpt";
+
+    TrajectoryWriter *recorder = nullptr; // owned by the physics engine
+    char trajectory_path[256] = "simulation.traj";
+
+    TrajectoryPlayer *player = nullptr; // owned by the graphic engine
+    char playback_path[256] = "simulation.traj";
 
     float dummyVal1;
 
@@ -61,6 +79,23 @@ public:
             ImGui::SliderFloat("Viscosity (Mu)", &(solver->MU), 0.0f, 10.0f);
             ImGui::Checkbox("Using predicted position", &(solver->USE_PREDICTED));
 
+            ImGui::Text("Settled regions");
+            ImGui::Text("Active: %.1f%% (%d of %d particles)", 100.0f * solver->activeFraction, solver->activeParticles, solver->alive);
+            ImGui::Checkbox("Skip settled cells", &(solver->SLEEPING));
+            ImGui::SliderFloat("Settle velocity", &(solver->SLEEP_VELOCITY), 0.0f, 1.0f);
+            ImGui::SliderFloat("Settle density change", &(solver->SLEEP_DENSITY_CHANGE), 0.0f, 0.01f, "%.4f");
+            ImGui::SliderInt("Settle steps", &(solver->SLEEP_STEPS), 1, 1000);
+
+            ImGui::Text("Adaptive resolution");
+            ImGui::Checkbox("Split / merge particles", &(solver->ADAPTIVE));
+            ImGui::SliderInt("Max level", &(solver->MAX_LEVEL), 0, SPHSolver::MAX_LEVELS - 1);
+            ImGui::SliderFloat("Split surface offset", &(solver->SPLIT_SURFACE), 0.0f, 1.0f);
+            ImGui::SliderFloat("Merge surface offset", &(solver->MERGE_SURFACE), 0.0f, 1.0f);
+            ImGui::SliderFloat("Camera distance", &(solver->SPLIT_CAMERA_DISTANCE), 0.0f, 100.0f);
+            ImGui::Text("%d particles, %d at the finest level (%.1fx saved)", solver->alive, solver->fineEquivalent,
+                        solver->alive > 0 ? (float)solver->fineEquivalent / (float)solver->alive : 1.0f);
+            ImGui::Text("Split %d, merged %d", solver->lastSplits, solver->lastMerges);
+
             ImGui::Text("Environment");
             ImGui::SliderFloat("Gravity", &(solver->GRAVITY), 0.0f, 100.0f);
             ImGui::SliderFloat("Bounding box dampening", &(solver->RESTITUTION), 0.0f, 1.0f);
@@ -68,6 +103,21 @@ public:
             ImGui::Text("Spawning");
             ImGui::SliderInt("No. of Particles", &(solver->N_PARTICLES), 1, 100000);
             ImGui::SliderFloat("Spawning gap", &(solver->SPAWN_GAP), 0.0f, 10.0f);
+            ImGui::Text("Alive: %d / %zu (emitted %d, drained %d)", solver->alive, solver->capacity(), solver->lastEmitted, solver->lastDrained);
+            for (size_t e = 0; e < solver->emitters.size(); e++)
+            {
+                ImGui::PushID((int)e);
+                ImGui::Checkbox("Emitter", &(solver->emitters[e].enabled));
+                ImGui::SameLine();
+                ImGui::SliderFloat("Rate", &(solver->emitters[e].rate), 0.0f, 5000.0f);
+                ImGui::PopID();
+            }
+            for (size_t k = 0; k < solver->sinks.size(); k++)
+            {
+                ImGui::PushID((int)(solver->emitters.size() + k));
+                ImGui::Checkbox("Sink", &(solver->sinks[k].enabled));
+                ImGui::PopID();
+            }
 
             ImGui::SliderFloat3("Spawning position", glm::value_ptr(solver->SPAWN_POS), *glm::value_ptr(glm::vec3(-50.0f, -50.0f, -50.0f)), *glm::value_ptr(glm::vec3(50.0f, 50.0f, 50.0f)));
 
@@ -75,6 +125,121 @@ public:
             ImGui::SliderFloat3("Box size max", glm::value_ptr(solver->BOX_MAX), *glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)), *glm::value_ptr(glm::vec3(50.0f, 50.0f, 50.0f)));
         }
 
+        if (surface != nullptr)
+        {
+            ImGui::Text("Fluid surface");
+            ImGui::Checkbox("Surface mesh (replaces particles)", &(surface->ENABLED));
+            ImGui::SliderFloat("Voxel size", &(surface->VOXEL_SIZE), 0.05f, 2.0f);
+            ImGui::SliderFloat("Splat radius", &(surface->SPLAT_RADIUS), 0.1f, 5.0f);
+            ImGui::SliderFloat("Iso level", &(surface->ISO_LEVEL), 0.01f, 5.0f);
+            ImGui::Checkbox("Reuse settled blocks", &(surface->INCREMENTAL));
+            ImGui::Text("%.2f ms, %d blocks (%d rebuilt), %zu triangles", surface->lastExtractMs, surface->activeBlocks,
+                        surface->rebuiltBlocks, surface->triangleCount());
+        }
+
+        if (screen_fluid != nullptr)
+        {
+            ImGui::Text("Screen space fluid");
+            ImGui::Checkbox("Screen space fluid (replaces particles)", &(screen_fluid->ENABLED));
+            ImGui::SliderInt("Downsample", &(screen_fluid->DOWNSAMPLE), 1, 4);
+            ImGui::SliderFloat("Particle radius", &(screen_fluid->PARTICLE_RADIUS), 0.05f, 2.0f);
+            ImGui::SliderInt("Blur radius", &(screen_fluid->BLUR_RADIUS), 0, 32);
+            ImGui::SliderFloat("Blur scale", &(screen_fluid->BLUR_SCALE), 0.01f, 1.0f);
+            ImGui::SliderFloat("Blur depth falloff", &(screen_fluid->BLUR_DEPTH_FALLOFF), 0.0f, 20.0f);
+            ImGui::SliderInt("Blur iterations", &(screen_fluid->BLUR_ITERATIONS), 0, 8);
+            ImGui::SliderFloat("Absorption", &(screen_fluid->ABSORPTION), 0.0f, 4.0f);
+            ImGui::ColorEdit4("Fluid color", glm::value_ptr(screen_fluid->FLUID_COLOR));
+            ImGui::Text("Offscreen %d x %d", screen_fluid->width, screen_fluid->height);
+        }
+
+        if (softBodyWorld != nullptr)
+        {
+            ImGui::Text("Soft bodies");
+            ImGui::Text("Awake: %d  Asleep: %d  Islands: %d", softBodyWorld->awakeBodies(), softBodyWorld->asleepBodies(), softBodyWorld->lastIslandCount);
+            ImGui::Checkbox("Sleeping", &(softBodyWorld->SLEEPING));
+            ImGui::SliderFloat("Sleep energy", &(softBodyWorld->SLEEP_ENERGY), 0.0f, 1e-3f, "%.2e");
+            ImGui::SliderInt("Sleep steps", &(softBodyWorld->SLEEP_STEPS), 1, 1000);
+        }
+
+        if (solver != nullptr || softBodyWorld != nullptr)
+        {
+            ImGui::Text("Checkpoint");
+            ImGui::InputText("File", checkpoint_path, sizeof(checkpoint_path));
+            if (ImGui::Button("Save"))
+                checkpoint_writer.save(checkpoint_path, solver, softBodyWorld);
+            ImGui::SameLine();
+            if (ImGui::Button("Load"))
+            {
+                checkpoint_writer.flush(); // the file may still be in flight
+                SimulationCheckpoint::load(checkpoint_path, solver, softBodyWorld);
+            }
+            ImGui::Text("Written %d, dropped %d, failed %d, last write %.2f ms", checkpoint_writer.written.load(),
+                        checkpoint_writer.dropped.load(), checkpoint_writer.failed.load(), checkpoint_writer.lastWriteMs.load());
+        }
+
+        if (recorder != nullptr)
+        {
+            ImGui::Text("Trajectory recording");
+            ImGui::InputText("Trajectory file", trajectory_path, sizeof(trajectory_path));
+            if (!recorder->isOpen())
+            {
+                ImGui::SliderInt("Quantization bits", &(recorder->QUANT_BITS), 8, 16);
+                ImGui::SliderInt("Keyframe interval", &(recorder->KEYFRAME_INTERVAL), 1, 600);
+                ImGui::SliderInt("Steps per frame", &(recorder->RECORD_EVERY), 1, 60);
+                if (ImGui::Button("Record"))
+                {
+                    // one box holding the fluid and the soft bodies
+                    glm::vec3 boxMin(0.0f), boxMax(0.0f);
+                    if (solver != nullptr)
+                    {
+                        boxMin = solver->BOX_MIN;
+                        boxMax = solver->BOX_MAX;
+                    }
+                    if (softBodyWorld != nullptr)
+                    {
+                        boxMin = solver != nullptr ? glm::min(boxMin, softBodyWorld->BOX_MIN) : softBodyWorld->BOX_MIN;
+                        boxMax = solver != nullptr ? glm::max(boxMax, softBodyWorld->BOX_MAX) : softBodyWorld->BOX_MAX;
+                    }
+                    recorder->open(trajectory_path, boxMin, boxMax);
+                }
+            }
+            else if (ImGui::Button("Stop recording"))
+            {
+                recorder->close();
+            }
+            if (recorder->writeFailed.load())
+                ImGui::Text("Write failed, recording stopped (frames before the failure are kept)");
+            uint64_t bytes = recorder->bytesWritten.load();
+            ImGui::Text("%llu frames (%llu dropped), %.2f MB, ratio %.1f, encode %.2f ms", (unsigned long long)recorder->framesWritten.load(),
+                        (unsigned long long)recorder->framesDropped.load(), bytes / (1024.0 * 1024.0),
+                        bytes > 0 ? (double)recorder->rawBytes.load() / bytes : 0.0, recorder->lastEncodeMs.load());
+        }
+
+        if (player != nullptr)
+        {
+            ImGui::Text("Playback");
+            ImGui::InputText("Playback file", playback_path, sizeof(playback_path));
+            if (!player->isOpen())
+            {
+                if (ImGui::Button("Play recording"))
+                    player->open(playback_path);
+            }
+            else
+            {
+                if (ImGui::Button("Close recording"))
+                    player->close();
+                ImGui::Checkbox("Playing", &(player->PLAYING));
+                ImGui::SameLine();
+                ImGui::Checkbox("Loop", &(player->LOOP));
+                ImGui::SliderFloat("Speed", &(player->SPEED), -4.0f, 4.0f);
+                int frame = (int)std::max(player->currentFrame(), 0ll);
+                if (ImGui::SliderInt("Frame", &frame, 0, (int)player->frameCount() - 1))
+                    player->seek((size_t)frame);
+                ImGui::Text("%zu frames, %.1f s, %d late, %d bad", player->frameCount(), player->duration(), player->framesLate,
+                            player->framesBad);
+            }
+        }
+
         ImGui::End();
         //===========================================
 
@@ -10,6 +10,11 @@
 #include <Graphic/TextRenderer.h>
 #include <Graphic/Camera.h>
 #include <Graphic/GUIManager.h>
+#include <Graphic/SurfaceExtractor.h>
+#include <Graphic/SurfaceRenderBuffer.h>
+#include <Graphic/SurfaceWorker.h>
+#include <Graphic/ScreenSpaceFluid.h>
+#include <Graphic/TrajectoryPlayer.h>
 #include <Physics/PhysicsObject.h>
 #include <Physics/PhysicsEngine.h>
 
@@ -46,6 +51,8 @@ public:
         // change to your project path
         shader = new Shader("D:/CODE/ComGraphic/project-rework/src/shader.vs", "D:/CODE/ComGraphic/project-rework/src/shader.fs");
         container_shader = new Shader("D:/CODE/ComGraphic/project-rework/src/container_shader.vs", "D:/CODE/ComGraphic/project-rework/src/container_shader.fs");
+        surface_shader = new Shader("D:/CODE/ComGraphic/project-rework/src/fluid_surface.vs", "D:/CODE/ComGraphic/project-rework/src/fluid_surface.fs");
+        screen_fluid.create("D:/CODE/ComGraphic/project-rework/src/");
         text_renderer = new TextRenderer(SCR_WIDTH, SCR_HEIGHT);
         // text_renderer->loadFont("D:/CODE/ComGraphic/project-space/resources/fonts/OpenSans-Regular.ttf", 24);
 
@@ -189,6 +196,7 @@ public:
         processMouse();
 
         user_callback(deltaTime); // custom callback
+        updatePlayback();         // a recording overrides the simulated state
 
         // //====================[general mesh rendering]====================
         // // update position buffer
@@ -203,7 +211,12 @@ public:
         // //============================================================
 
         renderContainer(true);
-        renderPhysicsParticles(); // render particles
+        if (fluid_surface.ENABLED)
+            renderFluidSurface(); // surface mesh instead of the particles
+        else if (screen_fluid.ENABLED)
+            renderScreenSpaceFluid(); // smoothed splats instead of the particles
+        else
+            renderPhysicsParticles(); // render particles
         renderSkybox();
         gui_mgr->showGUI(); // render GUI
 
@@ -420,15 +433,17 @@ public:
 
         //  config positionsVBO
         // position (x,y,z) for each object
+        // sized to the pool capacity, emitters and sinks only change the drawn count
+        physics_data.particleCapacity = physics_data.p->sph_solver->capacity();
         glBindBuffer(GL_ARRAY_BUFFER, physics_data.positionsVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * physics_data.p->sph_solver->positions.size(), physics_data.p->sph_solver->positions.data(), GL_DYNAMIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * physics_data.particleCapacity, physics_data.p->sph_solver->positions.data(), GL_DYNAMIC_DRAW);
         glEnableVertexAttribArray(1); // (location = 1)
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
         glVertexAttribDivisor(1, 1);
 
         // color attribute
         glBindBuffer(GL_ARRAY_BUFFER, physics_data.colorsVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * physics_data.p->sph_solver->colors.size(), physics_data.p->sph_solver->colors.data(), GL_DYNAMIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * physics_data.particleCapacity, physics_data.p->sph_solver->colors.data(), GL_DYNAMIC_DRAW);
         glEnableVertexAttribArray(2); // (location = 2)
         glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)0);
         glVertexAttribDivisor(2, 1);
@@ -451,6 +466,11 @@ public:
         //=========================================================
 
         gui_mgr->solver = physics_data.p->sph_solver; // connect solver with GUI
+        gui_mgr->surface = &fluid_surface;
+        gui_mgr->screen_fluid = &screen_fluid;
+        gui_mgr->softBodyWorld = physics_data.p->softBodyWorld;
+        gui_mgr->recorder = &physics_data.p->recorder;
+        gui_mgr->player = &player;
     }
 
     void renderPhysicsParticles()
@@ -463,33 +483,109 @@ public:
             shader->setMat4("view", camera.GetViewMatrix()); // camera view update
             shader->setMat4("projection", projection);
 
+            int alive = uploadParticles();
             // start using sphere mesh
             glBindVertexArray(physics_data.particlesVAO);
 
-            // update position buffer
-            glBindBuffer(GL_ARRAY_BUFFER, physics_data.positionsVBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, physics_data.p->sph_solver->positions.size() * sizeof(glm::vec3), physics_data.p->sph_solver->positions.data());
-            glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind
-            // update color buffer
-            glBindBuffer(GL_ARRAY_BUFFER, physics_data.colorsVBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, physics_data.p->sph_solver->colors.size() * sizeof(glm::vec4), physics_data.p->sph_solver->colors.data());
-            glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind
-
-            // glDrawElementsInstanced(GL_TRIANGLES, SPHSolver::sphereIndices.size(), GL_UNSIGNED_INT, 0, physics_data.p->sph_solver->positions.size()); // draw instances
-            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, SPHSolver::sphereIndices.size(), physics_data.p->sph_solver->positions.size()); // draw instances
+            // glDrawElementsInstanced(GL_TRIANGLES, SPHSolver::sphereIndices.size(), GL_UNSIGNED_INT, 0, alive); // draw instances
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, SPHSolver::sphereIndices.size(), alive); // draw instances
             glEnable(GL_BLEND);
         }
     }
 
-    // reallocate buffer of particles data
+    // stream the alive particles into the instance buffers, returns how many
+    int uploadParticles()
+    {
+        // the pool grew past the buffers, the only time they are reallocated
+        if (physics_data.p->sph_solver->capacity() > physics_data.particleCapacity)
+        {
+            updateSolverBuffer();
+        }
+        int alive = physics_data.p->sph_solver->alive;
+        physics_data.p->sph_solver->camera_position = camera.Position; // refinement follows the camera
+
+        // update position buffer
+        glBindBuffer(GL_ARRAY_BUFFER, physics_data.positionsVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, alive * sizeof(glm::vec3), physics_data.p->sph_solver->positions.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind
+        // update color buffer
+        glBindBuffer(GL_ARRAY_BUFFER, physics_data.colorsVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, alive * sizeof(glm::vec4), physics_data.p->sph_solver->colors.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind
+        return alive;
+    }
+
+    // splat the particles offscreen, smooth and composite them as a fluid surface
+    void renderScreenSpaceFluid()
+    {
+        if (physics_data.p == nullptr || physics_data.p->sph_solver == nullptr)
+            return;
+        int alive = uploadParticles();
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        screen_fluid.render(physics_data.particlesVAO, alive, camera.GetViewMatrix(), projection,
+                            width, height, glm::vec3(-0.2f, -1.0f, -0.3f));
+    }
+
+    // while a recording is open it replaces the solvers and the physics engine stays paused, closing it hands back the state and pause flag from before
+    void updatePlayback()
+    {
+        if (physics_data.p == nullptr)
+            return;
+        PhysicsEngine *physics = physics_data.p;
+        if (!player.isOpen())
+        {
+            // recording closed: the simulation gets its state and its pause flag back
+            if (playback_active)
+            {
+                player.restoreLive(physics->sph_solver, physics->softBodyWorld);
+                physics->is_pause = pause_before_playback;
+                playback_active = false;
+            }
+            return;
+        }
+        if (!playback_active)
+        {
+            player.saveLive(physics->sph_solver, physics->softBodyWorld);
+            pause_before_playback = physics->is_pause;
+            playback_active = true;
+        }
+        physics->is_pause = true;
+        if (player.update(deltaTime))
+            player.apply(physics->sph_solver, physics->softBodyWorld);
+    }
+
+    // draw the last surface mesh the worker finished, then hand it the current particles
+    void renderFluidSurface()
+    {
+        if (physics_data.p == nullptr || physics_data.p->sph_solver == nullptr)
+            return;
+        SPHSolver *solver = physics_data.p->sph_solver;
+        solver->camera_position = camera.Position; // refinement follows the camera
+        // the mesh trails the particles by one extraction, the buffer keeps the old one until a new one is done
+        if (surface_worker.collect(fluid_surface))
+            fluid_surface_buffer.update(fluid_surface);
+        surface_worker.submit(fluid_surface, solver->positions.data(), solver->alive);
+
+        surface_shader->use();
+        surface_shader->setMat4("view", camera.GetViewMatrix());
+        surface_shader->setMat4("projection", projection);
+        surface_shader->setVec3("viewPos", camera.Position);
+        surface_shader->setVec3("lightDir", glm::vec3(-0.2f, -1.0f, -0.3f));
+        surface_shader->setVec4("color", glm::vec4(0.2f, 0.45f, 0.8f, 1.0f));
+        fluid_surface_buffer.draw();
+    }
+
+    // reallocate buffer of particles data to the pool capacity
     void updateSolverBuffer()
     {
         if (physics_data.p != nullptr && physics_data.p->sph_solver != nullptr)
         {
+            physics_data.particleCapacity = physics_data.p->sph_solver->capacity();
             glBindBuffer(GL_ARRAY_BUFFER, physics_data.positionsVBO);
-            glBufferData(GL_ARRAY_BUFFER, physics_data.p->sph_solver->positions.size() * sizeof(glm::vec3), physics_data.p->sph_solver->positions.data(), GL_DYNAMIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, physics_data.particleCapacity * sizeof(glm::vec3), physics_data.p->sph_solver->positions.data(), GL_DYNAMIC_DRAW);
             glBindBuffer(GL_ARRAY_BUFFER, physics_data.colorsVBO);
-            glBufferData(GL_ARRAY_BUFFER, physics_data.p->sph_solver->colors.size() * sizeof(glm::vec4), physics_data.p->sph_solver->colors.data(), GL_DYNAMIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, physics_data.particleCapacity * sizeof(glm::vec4), physics_data.p->sph_solver->colors.data(), GL_DYNAMIC_DRAW);
         }
     }
     //===============================================================================
@@ -518,6 +614,7 @@ public:
         unsigned int particlesVAO,
             verticesVBO, indicesEBO, positionsVBO, colorsVBO,
             boxVBO, boxVAO;
+        size_t particleCapacity = 0; // particles the instance buffers hold
     };
     PhysicsEngineData physics_data;
 
@@ -591,6 +688,20 @@ public:
         1.0f, -1.0f, 1.0f};
     Shader *skyboxShader;
 
+    // [Fluid surface]
+    SurfaceExtractor fluid_surface; // parameters for the GUI and the mesh on screen, extracted by surface_worker
+    SurfaceWorker surface_worker;
+    SurfaceRenderBuffer fluid_surface_buffer;
+    Shader *surface_shader;
+
+    // [Screen space fluid]
+    ScreenSpaceFluid screen_fluid;
+
+    // [Playback]
+    TrajectoryPlayer player;
+    bool playback_active = false;       // the player overrides the simulation since the last updatePlayback
+    bool pause_before_playback = false; // is_pause when the recording was opened
+
     // [Container for particle]
     unsigned int containerVAO, containerVBO, containerEBO;
     std::vector<float> container_vertices;
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <algorithm>
+#include <iostream>
+
+#include <Graphic/shader_s.h>
+
+/**
+ * Screen space fluid rendering of SPH particles (van der Laan et al. 2009)
+ * - splat: every particle is a sphere impostor on the instanced particle quad, its eye depth goes into an offscreen R32F target
+ * - thickness: the same impostors blended additively, the chord length through each sphere
+ * - smoothing: separable bilateral blur of the depth, the depth falloff keeps silhouettes from melting into the background
+ * - composite: eye positions back from the smoothed depth, normals by finite differences, shaded with Fresnel and
+ *   Beer-Lambert absorption by the thickness, written with its own depth so the scene still occludes the fluid
+ * - the offscreen passes run at 1/DOWNSAMPLE of the screen: past the splat everything costs per pixel, not per particle
+ */
+class ScreenSpaceFluid
+{
+public:
+    //=======[adjustable parameters]========
+    bool ENABLED = false;
+    int DOWNSAMPLE = 2;              // offscreen targets are the screen size divided by this on both axes
+    float PARTICLE_RADIUS = 0.6f;    // radius of the splatted spheres
+    int BLUR_RADIUS = 8;             // taps on each side, in offscreen pixels
+    float BLUR_SCALE = 0.15f;        // spatial falloff per tap
+    float BLUR_DEPTH_FALLOFF = 2.0f; // larger keeps depth discontinuities sharper
+    int BLUR_ITERATIONS = 2;         // horizontal + vertical passes
+    float ABSORPTION = 0.4f;         // per unit thickness
+    glm::vec4 FLUID_COLOR = glm::vec4(0.2f, 0.5f, 0.9f, 1.0f);
+    //======================================
+
+    int width = 0, height = 0; // offscreen size
+
+    ScreenSpaceFluid() {}
+    ~ScreenSpaceFluid()
+    {
+        destroy();
+    }
+
+    ScreenSpaceFluid(const ScreenSpaceFluid &) = delete;
+    ScreenSpaceFluid &operator=(const ScreenSpaceFluid &) = delete;
+
+    // compile the pass shaders found in shaderDirectory (needs a current GL context)
+    void create(const std::string &shaderDirectory)
+    {
+        std::string splat = shaderDirectory + "ssf_splat.vs", quad = shaderDirectory + "ssf_quad.vs";
+        depthShader = new Shader(splat.c_str(), (shaderDirectory + "ssf_depth.fs").c_str());
+        thicknessShader = new Shader(splat.c_str(), (shaderDirectory + "ssf_thickness.fs").c_str());
+        blurShader = new Shader(quad.c_str(), (shaderDirectory + "ssf_blur.fs").c_str());
+        compositeShader = new Shader(quad.c_str(), (shaderDirectory + "ssf_composite.fs").c_str());
+        glGenVertexArrays(1, &quadVAO); // the full screen triangle comes from gl_VertexID, core profile still wants a VAO
+    }
+
+    /**
+     * Draw count particles of particlesVAO (attribute 0: quad corner in [-0.5, 0.5], attribute 1: instance center)
+     * - renders into the currently bound framebuffer of size screenWidth x screenHeight, depth test on
+     */
+    void render(unsigned int particlesVAO, int count, const glm::mat4 &view, const glm::mat4 &projection,
+                int screenWidth, int screenHeight, glm::vec3 lightDirection)
+    {
+        if (depthShader == nullptr || count <= 0)
+            return;
+        int scale = std::max(DOWNSAMPLE, 1);
+        resize(std::max(screenWidth / scale, 1), std::max(screenHeight / scale, 1));
+        GLint previousFramebuffer = 0;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glViewport(0, 0, width, height);
+        glDisable(GL_BLEND);
+
+        // depth of the nearest sphere surface, 0 is empty
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO[0]);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        depthShader->use();
+        depthShader->setMat4("view", view);
+        depthShader->setMat4("projection", projection);
+        depthShader->setFloat("radius", PARTICLE_RADIUS);
+        glBindVertexArray(particlesVAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+
+        // thickness, every sphere adds its chord
+        glBindFramebuffer(GL_FRAMEBUFFER, thicknessFBO);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        thicknessShader->use();
+        thicknessShader->setMat4("view", view);
+        thicknessShader->setMat4("projection", projection);
+        thicknessShader->setFloat("radius", PARTICLE_RADIUS);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+        glDisable(GL_BLEND);
+
+        // bilateral blur, ping-pong between the two depth targets, ends in depthTexture[0]
+        glBindVertexArray(quadVAO);
+        blurShader->use();
+        blurShader->setInt("depthMap", 0);
+        blurShader->setInt("filterRadius", BLUR_RADIUS);
+        blurShader->setFloat("blurScale", BLUR_SCALE);
+        blurShader->setFloat("depthFalloff", BLUR_DEPTH_FALLOFF);
+        glActiveTexture(GL_TEXTURE0);
+        for (int iteration = 0; iteration < BLUR_ITERATIONS; iteration++)
+        {
+            for (int pass = 0; pass < 2; pass++)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, depthFBO[1 - pass]);
+                glBindTexture(GL_TEXTURE_2D, depthTexture[pass]);
+                blurShader->setVec2("direction", pass == 0 ? 1.0f / width : 0.0f, pass == 0 ? 0.0f : 1.0f / height);
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+        }
+
+        // composite at full resolution into the scene
+        glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+        glViewport(0, 0, screenWidth, screenHeight);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        compositeShader->use();
+        compositeShader->setInt("depthMap", 0);
+        compositeShader->setInt("thicknessMap", 1);
+        compositeShader->setMat4("projection", projection);
+        compositeShader->setVec2("texelSize", 1.0f / width, 1.0f / height);
+        compositeShader->setVec3("lightDir", glm::normalize(glm::vec3(view * glm::vec4(lightDirection, 0.0f))));
+        compositeShader->setVec4("fluidColor", FLUID_COLOR);
+        compositeShader->setFloat("absorption", ABSORPTION);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture[0]);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, thicknessTexture);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(0);
+    }
+
+    void destroy()
+    {
+        releaseTargets();
+        if (quadVAO != 0)
+            glDeleteVertexArrays(1, &quadVAO);
+        quadVAO = 0;
+        delete depthShader;
+        delete thicknessShader;
+        delete blurShader;
+        delete compositeShader;
+        depthShader = thicknessShader = blurShader = compositeShader = nullptr;
+    }
+
+private:
+    Shader *depthShader = nullptr;
+    Shader *thicknessShader = nullptr;
+    Shader *blurShader = nullptr;
+    Shader *compositeShader = nullptr;
+    unsigned int quadVAO = 0;
+    unsigned int depthFBO[2] = {0, 0};
+    unsigned int depthTexture[2] = {0, 0};
+    unsigned int depthBuffer = 0; // z-test between splats, attached to depthFBO[0]
+    unsigned int thicknessFBO = 0;
+    unsigned int thicknessTexture = 0;
+
+    // (re)create the offscreen targets when the screen or DOWNSAMPLE changed
+    void resize(int w, int h)
+    {
+        if (w == width && h == height && depthFBO[0] != 0)
+            return;
+        releaseTargets();
+        width = w;
+        height = h;
+
+        glGenFramebuffers(2, depthFBO);
+        glGenTextures(2, depthTexture);
+        for (int k = 0; k < 2; k++)
+        {
+            createTarget(depthFBO[k], depthTexture[k], GL_R32F);
+        }
+        glGenTextures(1, &depthBuffer);
+        glBindTexture(GL_TEXTURE_2D, depthBuffer);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO[0]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthBuffer, 0);
+
+        glGenFramebuffers(1, &thicknessFBO);
+        glGenTextures(1, &thicknessTexture);
+        createTarget(thicknessFBO, thicknessTexture, GL_R16F);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::SCREEN_SPACE_FLUID:: offscreen target incomplete" << std::endl;
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // single channel float texture as the color attachment of fbo, linear so the composite upsamples smoothly
+    void createTarget(unsigned int fbo, unsigned int texture, GLint format)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    }
+
+    void releaseTargets()
+    {
+        if (depthFBO[0] != 0)
+        {
+            glDeleteFramebuffers(2, depthFBO);
+            glDeleteTextures(2, depthTexture);
+            glDeleteTextures(1, &depthBuffer);
+            glDeleteFramebuffers(1, &thicknessFBO);
+            glDeleteTextures(1, &thicknessTexture);
+        }
+        depthFBO[0] = depthFBO[1] = depthTexture[0] = depthTexture[1] = depthBuffer = thicknessFBO = thicknessTexture = 0;
+        width = height = 0;
+    }
+};
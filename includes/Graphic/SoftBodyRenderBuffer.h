@@ -0,0 +1,240 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <omp.h>
+
+#include <objectloader.h>
+
+/**
+ * Indexed GPU buffer of a soft body mesh
+ * - one render vertex per unique v/vn/vt corner (mesh.renderCorners), triangles drawn through an EBO
+ * - VBO holds three tightly packed streams: positions | normals | uvs
+ * - uvs and the index buffer are uploaded once, a frame only streams positions and normals
+ * - normals of the deformed mesh are recomputed every update:
+ *     face normals (one pass over triangles), then one pass over render vertices that gathers the
+ *     normal from its faces and writes position + normal, no atomics, no scatter
+ *     a render vertex only averages faces that share its OBJ normal, so hard edges stay hard
+ * - gather goes through remap tables built at create(), no allocation per frame
+ */
+class SoftBodyRenderBuffer
+{
+public:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+
+    //=======[adjustable parameters]========
+    bool RECOMPUTE_NORMALS = true; // false keeps the normals of the OBJ
+    //======================================
+
+    SoftBodyRenderBuffer() {}
+    ~SoftBodyRenderBuffer()
+    {
+        destroy();
+    }
+
+    SoftBodyRenderBuffer(const SoftBodyRenderBuffer &) = delete;
+    SoftBodyRenderBuffer &operator=(const SoftBodyRenderBuffer &) = delete;
+
+    // build remap tables and GL objects (needs a current GL context)
+    void create(const SoftBodyMesh &mesh)
+    {
+        destroy();
+        buildRemap(mesh);
+        fillStaging(mesh);
+
+        std::vector<glm::vec2> uvs(renderVertexCount);
+        for (size_t r = 0; r < renderVertexCount; r++)
+        {
+            unsigned int t = texCoordRemap[r];
+            uvs[r] = t < mesh.texCoords.size() ? mesh.texCoords[t] : glm::vec2(0.0f);
+        }
+
+        GLsizeiptr streamSize = (GLsizeiptr)(renderVertexCount * sizeof(glm::vec3));
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, streamSize * 2 + (GLsizeiptr)(renderVertexCount * sizeof(glm::vec2)), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, streamSize * 2, staging.data());
+        glBufferSubData(GL_ARRAY_BUFFER, streamSize * 2, (GLsizeiptr)(renderVertexCount * sizeof(glm::vec2)), uvs.data());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(mesh.renderIndices.size() * sizeof(unsigned int)), mesh.renderIndices.data(), GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)(streamSize));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)(streamSize * 2));
+        glEnableVertexAttribArray(2);
+        glBindVertexArray(0);
+
+        indexCount = mesh.renderIndices.size();
+    }
+
+    // stream the simulated state of the mesh, positions and normals go up in one upload
+    void update(const SoftBodyMesh &mesh)
+    {
+        if (VBO == 0)
+            return;
+        fillStaging(mesh);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)(staging.size() * sizeof(glm::vec3)), staging.data());
+    }
+
+    void draw() const
+    {
+        if (VAO == 0)
+            return;
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    void destroy()
+    {
+        if (VAO != 0)
+            glDeleteVertexArrays(1, &VAO);
+        if (VBO != 0)
+            glDeleteBuffers(1, &VBO);
+        if (EBO != 0)
+            glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+        indexCount = 0;
+    }
+
+    size_t vertexCount() const
+    {
+        return renderVertexCount;
+    }
+
+    // bytes sent to the GPU by update(), for the stats panel
+    size_t bytesPerUpdate() const
+    {
+        return staging.size() * sizeof(glm::vec3);
+    }
+
+private:
+    size_t renderVertexCount = 0;
+    size_t indexCount = 0;
+    std::vector<unsigned int> positionRemap; // render vertex -> mesh vertex
+    std::vector<unsigned int> normalRemap;   // render vertex -> mesh normal
+    std::vector<unsigned int> texCoordRemap; // render vertex -> mesh uv
+    std::vector<glm::vec3> staging;          // persistent, positions [0, R) then normals [R, 2R), refilled every update
+    std::vector<unsigned int> triangles;     // 3 vertex indices per triangle, faces without the vn/vt slots
+    std::vector<glm::vec3> faceNormals;      // area weighted, scratch of the normal pass
+    std::vector<unsigned int> normalFaceStart; // faces averaged by render vertex r: normalFaces[normalFaceStart[r] .. normalFaceStart[r + 1])
+    std::vector<unsigned int> normalFaces;
+
+    // renderCorners holds v/vn/vt triples, split into one table per stream
+    void buildRemap(const SoftBodyMesh &mesh)
+    {
+        renderVertexCount = mesh.renderCorners.size() / 3;
+        positionRemap.resize(renderVertexCount);
+        normalRemap.resize(renderVertexCount);
+        texCoordRemap.resize(renderVertexCount);
+        for (size_t r = 0; r < renderVertexCount; r++)
+        {
+            positionRemap[r] = mesh.renderCorners[r * 3];
+            normalRemap[r] = mesh.renderCorners[r * 3 + 1];
+            texCoordRemap[r] = mesh.renderCorners[r * 3 + 2];
+        }
+        staging.resize(renderVertexCount * 2);
+
+        size_t triCount = mesh.faces.size() / 9;
+        triangles.resize(triCount * 3);
+        for (size_t c = 0; c < triCount * 3; c++)
+        {
+            triangles[c] = mesh.faces[c * 3];
+        }
+        faceNormals.resize(triCount);
+
+        // narrow the vertex -> face CSR down to the faces whose corner uses the same OBJ normal
+        normalFaceStart.clear();
+        normalFaces.clear();
+        if (mesh.vertexFaceStart.size() != mesh.vertices.size() + 1)
+            return;
+        normalFaceStart.resize(renderVertexCount + 1, 0);
+        normalFaces.reserve(triCount * 3);
+        for (size_t r = 0; r < renderVertexCount; r++)
+        {
+            unsigned int v = positionRemap[r];
+            for (unsigned int k = mesh.vertexFaceStart[v]; k < mesh.vertexFaceStart[v + 1]; k++)
+            {
+                unsigned int t = mesh.vertexFaces[k];
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    if (mesh.faces[t * 9 + corner * 3] == v && mesh.faces[t * 9 + corner * 3 + 1] == normalRemap[r])
+                    {
+                        normalFaces.push_back(t);
+                        break;
+                    }
+                }
+            }
+            normalFaceStart[r + 1] = (unsigned int)normalFaces.size();
+        }
+    }
+
+    void fillStaging(const SoftBodyMesh &mesh)
+    {
+        bool recompute = RECOMPUTE_NORMALS && !normalFaceStart.empty();
+        if (recompute)
+            computeFaceNormals(mesh.vertices.data());
+
+        const glm::vec3 *x = mesh.vertices.data();
+        const unsigned int *faceStart = normalFaceStart.data();
+        const unsigned int *faceList = normalFaces.data();
+        glm::vec3 *positions = staging.data();
+        glm::vec3 *normals = staging.data() + renderVertexCount;
+        long long count = (long long)renderVertexCount;
+#pragma omp parallel if (count > 16384)
+        {
+            // render vertices are sorted by v/vn/vt, corners that only differ by uv reuse the previous normal
+            long long last = -2;
+#pragma omp for schedule(static)
+            for (long long r = 0; r < count; r++)
+            {
+                unsigned int v = positionRemap[r];
+                positions[r] = x[v];
+                if (recompute)
+                {
+                    if (last == r - 1 && positionRemap[last] == v && normalRemap[last] == normalRemap[r])
+                    {
+                        normals[r] = normals[last];
+                    }
+                    else
+                    {
+                        glm::vec3 sum(0.0f);
+                        for (unsigned int k = faceStart[r]; k < faceStart[r + 1]; k++)
+                        {
+                            sum += faceNormals[faceList[k]];
+                        }
+                        float len = glm::length(sum);
+                        normals[r] = len > 1e-12f ? sum / len : glm::vec3(0.0f, 1.0f, 0.0f);
+                    }
+                    last = r;
+                }
+                else
+                {
+                    unsigned int n = normalRemap[r];
+                    normals[r] = n < mesh.normals.size() ? mesh.normals[n] : glm::vec3(0.0f, 1.0f, 0.0f);
+                }
+            }
+        }
+    }
+
+    // cross product of two edges, its length is twice the area so big triangles weigh more
+    void computeFaceNormals(const glm::vec3 *x)
+    {
+        const unsigned int *tri = triangles.data();
+        glm::vec3 *out = faceNormals.data();
+        long long triCount = (long long)faceNormals.size();
+#pragma omp parallel for simd if (triCount > 16384)
+        for (long long t = 0; t < triCount; t++)
+        {
+            glm::vec3 a = x[tri[t * 3]], b = x[tri[t * 3 + 1]], c = x[tri[t * 3 + 2]];
+            out[t] = glm::cross(b - a, c - a);
+        }
+    }
+};
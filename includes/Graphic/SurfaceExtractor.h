@@ -0,0 +1,554 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <omp.h>
+
+/**
+ * Fluid surface mesh from particles, sparse marching cubes
+ * - particles are binned into blocks of BLOCK^3 voxels, only blocks holding particles and their 26 neighbors are touched
+ * - every block splats the particles of the 27 bins around it into its own nodes, in the same order as its neighbors do,
+ *   so nodes on a shared face come out bit identical and both blocks agree on the crossings
+ * - a grid edge belongs to the block holding its lower node, only that block places the vertex, triangles name their
+ *   edges by block + local edge and are resolved to indices after a prefix sum over the vertex counts: the mesh is
+ *   welded across blocks without a global hash
+ * - blocks run in parallel, incremental: a block whose 27 bins hold the same particles at the same positions as in the
+ *   last extraction keeps its vertices and triangles, settled fluid costs only the binning
+ */
+class SurfaceExtractor
+{
+public:
+    static constexpr int BLOCK = 8;         // voxels per block side
+    static constexpr int NODES = BLOCK + 3; // samples per block side, a ghost layer on both sides gives central difference normals
+
+    //=======[adjustable parameters]========
+    bool ENABLED = false;
+    float VOXEL_SIZE = 0.4f;   // grid spacing of the mesh
+    float SPLAT_RADIUS = 1.6f; // reach of one particle, capped at BLOCK - 1 voxels so the 27 bins around a block are enough
+    float ISO_LEVEL = 0.6f;    // field value on the surface, a lone particle peaks at 1
+    bool INCREMENTAL = true;   // keep the blocks whose particles did not move
+    //======================================
+
+    // indexed triangle mesh of the last extraction
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
+
+    // stats of last extraction
+    double lastExtractMs = 0.0;
+    int activeBlocks = 0;
+    int rebuiltBlocks = 0;
+    int droppedTriangles = 0; // a neighbor had no vertex on a shared edge, stays 0 while the splats agree
+
+    void extract(const glm::vec3 *positions, size_t count)
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        float radius = std::min(SPLAT_RADIUS, (BLOCK - 1) * VOXEL_SIZE);
+        float blockSize = BLOCK * VOXEL_SIZE;
+
+        // bin particles by block, sorted by key then index so every block reads its bins in the same order
+        bins.resize(count);
+#pragma omp parallel for
+        for (long long i = 0; i < (long long)count; i++)
+        {
+            bins[i] = {packKey(glm::ivec3(glm::floor(positions[i] / blockSize))), (unsigned int)i};
+        }
+        std::sort(bins.begin(), bins.end());
+
+        binKeys.clear();
+        binStart.clear();
+        for (size_t k = 0; k < count; k++)
+        {
+            if (k == 0 || bins[k].key != bins[k - 1].key)
+            {
+                binKeys.push_back(bins[k].key);
+                binStart.push_back((unsigned int)k);
+            }
+        }
+        binStart.push_back((unsigned int)count);
+
+        // a bin changes when its particles or their positions do, the parameters seed every signature
+        uint64_t seed = mix(mix(mix(0x9e3779b97f4a7c15ull, floatBits(VOXEL_SIZE)), floatBits(radius)), floatBits(ISO_LEVEL));
+        binSignature.resize(binKeys.size());
+        long long binCount = (long long)binKeys.size();
+#pragma omp parallel for
+        for (long long b = 0; b < binCount; b++)
+        {
+            uint64_t h = seed;
+            for (unsigned int k = binStart[b]; k < binStart[b + 1]; k++)
+            {
+                const glm::vec3 &p = positions[bins[k].particle];
+                h = mix(h, bins[k].particle);
+                h = mix(h, floatBits(p.x) | ((uint64_t)floatBits(p.y) << 32));
+                h = mix(h, floatBits(p.z));
+            }
+            binSignature[b] = h;
+        }
+
+        // active blocks: every bin and its 26 neighbors
+        std::vector<uint64_t> keys;
+        keys.reserve(binKeys.size() * 27);
+        for (uint64_t key : binKeys)
+        {
+            glm::ivec3 c = unpackKey(key);
+            for (int dz = -1; dz <= 1; dz++)
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++)
+                        keys.push_back(packKey(c + glm::ivec3(dx, dy, dz)));
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        // searched instead of blocks, whose entries are swapped out while the loop runs
+        previousKeys.resize(blocks.size());
+        for (size_t k = 0; k < blocks.size(); k++)
+        {
+            previousKeys[k] = blocks[k].key;
+        }
+
+        long long blockCount = (long long)keys.size();
+        std::vector<Block> next(blockCount);
+        int rebuilt = 0;
+#pragma omp parallel reduction(+ : rebuilt)
+        {
+            std::vector<glm::vec3> gathered;
+            std::vector<float> nodes(NODES * NODES * NODES);
+#pragma omp for schedule(dynamic, 4)
+            for (long long k = 0; k < blockCount; k++)
+            {
+                Block &block = next[k];
+                block.key = keys[k];
+                glm::ivec3 c = unpackKey(block.key);
+                uint64_t signature = seed;
+                for (int dz = -1; dz <= 1; dz++)
+                    for (int dy = -1; dy <= 1; dy++)
+                        for (int dx = -1; dx <= 1; dx++)
+                        {
+                            long long bin = findBin(packKey(c + glm::ivec3(dx, dy, dz)));
+                            signature = mix(signature, bin < 0 ? 0 : binSignature[bin]);
+                        }
+
+                long long previous = INCREMENTAL ? findKey(previousKeys, block.key) : -1;
+                if (previous >= 0 && blocks[previous].signature == signature)
+                {
+                    std::swap(block, blocks[previous]); // keys are unique, no other block takes this one
+                    continue;
+                }
+                block.signature = signature;
+                buildBlock(block, c, positions, radius, gathered, nodes);
+                rebuilt++;
+            }
+        }
+        blocks.swap(next);
+        blockKeys.swap(keys);
+        activeBlocks = (int)blockCount;
+        rebuiltBlocks = rebuilt;
+
+        // prefix sums, then every block writes its slice and resolves its edges to global indices
+        vertexStart.resize(blockCount + 1);
+        triangleStart.resize(blockCount + 1);
+        vertexStart[0] = triangleStart[0] = 0;
+        for (long long k = 0; k < blockCount; k++)
+        {
+            vertexStart[k + 1] = vertexStart[k] + (unsigned int)blocks[k].vertices.size();
+            triangleStart[k + 1] = triangleStart[k] + (unsigned int)blocks[k].triangleEdges.size() / 3;
+        }
+        vertices.resize(vertexStart[blockCount]);
+        normals.resize(vertexStart[blockCount]);
+        indices.resize(triangleStart[blockCount] * 3);
+
+        int dropped = 0;
+#pragma omp parallel for schedule(dynamic, 16) reduction(+ : dropped)
+        for (long long k = 0; k < blockCount; k++)
+        {
+            const Block &block = blocks[k];
+            std::copy(block.vertices.begin(), block.vertices.end(), vertices.begin() + vertexStart[k]);
+            std::copy(block.normals.begin(), block.normals.end(), normals.begin() + vertexStart[k]);
+            glm::ivec3 c = unpackKey(block.key);
+            unsigned int *out = indices.data() + triangleStart[k] * 3;
+            size_t edgeCount = block.triangleEdges.size();
+            for (size_t t = 0; t < edgeCount; t += 3)
+            {
+                long long v[3];
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    v[corner] = resolveEdge(k, c, block.triangleEdges[t + corner]);
+                }
+                if (v[0] < 0 || v[1] < 0 || v[2] < 0)
+                {
+                    out[t] = out[t + 1] = out[t + 2] = 0; // degenerate, draws nothing
+                    dropped++;
+                    continue;
+                }
+                out[t] = (unsigned int)v[0];
+                out[t + 1] = (unsigned int)v[1];
+                out[t + 2] = (unsigned int)v[2];
+            }
+        }
+        droppedTriangles = dropped;
+        lastExtractMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+    }
+
+    size_t triangleCount() const
+    {
+        return indices.size() / 3;
+    }
+
+private:
+    struct BinEntry
+    {
+        uint64_t key;
+        unsigned int particle;
+
+        bool operator<(const BinEntry &other) const
+        {
+            return key < other.key || (key == other.key && particle < other.particle);
+        }
+    };
+
+    struct Block
+    {
+        uint64_t key = 0;
+        uint64_t signature = 0;
+        std::vector<glm::vec3> vertices;
+        std::vector<glm::vec3> normals;
+        std::vector<int> edgeVertex;          // owned edge -> local vertex or -1, BLOCK^3 * 3
+        std::vector<uint16_t> triangleEdges;  // 3 per triangle, edges of the (BLOCK + 1)^3 node box, the far faces belong to neighbors
+    };
+
+    std::vector<BinEntry> bins;
+    std::vector<uint64_t> binKeys;
+    std::vector<unsigned int> binStart; // particles of bin b: bins[binStart[b] .. binStart[b + 1])
+    std::vector<uint64_t> binSignature;
+    std::vector<Block> blocks;          // sorted by key, kept for the next extraction
+    std::vector<uint64_t> blockKeys;    // keys of blocks
+    std::vector<uint64_t> previousKeys;
+    std::vector<unsigned int> vertexStart;
+    std::vector<unsigned int> triangleStart;
+
+    /**
+     * Splat, classify and triangulate one block
+     * - nodes span local [-1, BLOCK + 1], cubes [0, BLOCK), owned edges start at [0, BLOCK)
+     */
+    void buildBlock(Block &block, glm::ivec3 c, const glm::vec3 *positions, float radius,
+                    std::vector<glm::vec3> &gathered, std::vector<float> &nodes)
+    {
+        float h = VOXEL_SIZE;
+        glm::ivec3 origin = c * BLOCK; // global node of local node 0
+        glm::vec3 lo = glm::vec3(origin - 1) * h - glm::vec3(radius);
+        glm::vec3 hi = glm::vec3(origin + BLOCK + 1) * h + glm::vec3(radius);
+
+        // bins in a fixed world order, particles by index
+        gathered.clear();
+        for (int dz = -1; dz <= 1; dz++)
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    long long bin = findBin(packKey(c + glm::ivec3(dx, dy, dz)));
+                    if (bin < 0)
+                        continue;
+                    for (unsigned int k = binStart[bin]; k < binStart[bin + 1]; k++)
+                    {
+                        const glm::vec3 &p = positions[bins[k].particle];
+                        if (p.x >= lo.x && p.y >= lo.y && p.z >= lo.z && p.x <= hi.x && p.y <= hi.y && p.z <= hi.z)
+                            gathered.push_back(p);
+                    }
+                }
+
+        block.vertices.clear();
+        block.normals.clear();
+        block.triangleEdges.clear();
+        block.edgeVertex.assign(BLOCK * BLOCK * BLOCK * 3, -1);
+        if (gathered.empty())
+            return;
+
+        // (1 - d^2 / R^2)^3 from per axis squared distances, the inner loop is a plain row the compiler vectorizes
+        std::fill(nodes.begin(), nodes.end(), 0.0f);
+        float invR2 = 1.0f / (radius * radius);
+        float dx2[NODES], dy2[NODES], dz2[NODES];
+        for (const glm::vec3 &p : gathered)
+        {
+            glm::ivec3 first = glm::max(glm::ivec3(glm::ceil((p - radius) / h)) - origin, glm::ivec3(-1));
+            glm::ivec3 last = glm::min(glm::ivec3(glm::floor((p + radius) / h)) - origin, glm::ivec3(BLOCK + 1));
+            for (int i = -1; i <= BLOCK + 1; i++)
+            {
+                glm::vec3 d = glm::vec3(origin + glm::ivec3(i)) * h - p;
+                dx2[i + 1] = d.x * d.x * invR2;
+                dy2[i + 1] = d.y * d.y * invR2;
+                dz2[i + 1] = d.z * d.z * invR2;
+            }
+            for (int z = first.z; z <= last.z; z++)
+                for (int y = first.y; y <= last.y; y++)
+                {
+                    float *row = &nodes[nodeIndex(0, y, z)];
+                    float base = 1.0f - dy2[y + 1] - dz2[z + 1];
+                    if (base <= 0.0f)
+                        continue;
+#pragma omp simd
+                    for (int x = first.x; x <= last.x; x++)
+                    {
+                        float q = std::max(base - dx2[x + 1], 0.0f);
+                        row[x] += q * q * q;
+                    }
+                }
+        }
+
+        const Tables &table = tables();
+        float iso = ISO_LEVEL;
+        auto inside = [&](int x, int y, int z)
+        { return nodes[nodeIndex(x, y, z)] > iso; };
+
+        // vertices on owned edges
+        for (int z = 0; z < BLOCK; z++)
+            for (int y = 0; y < BLOCK; y++)
+                for (int x = 0; x < BLOCK; x++)
+                {
+                    bool in0 = inside(x, y, z);
+                    for (int a = 0; a < 3; a++)
+                    {
+                        glm::ivec3 n1(x, y, z);
+                        n1[a]++;
+                        if (in0 == inside(n1.x, n1.y, n1.z))
+                            continue;
+                        float v0 = nodes[nodeIndex(x, y, z)], v1 = nodes[nodeIndex(n1.x, n1.y, n1.z)];
+                        float t = (iso - v0) / (v1 - v0);
+                        glm::vec3 p0 = glm::vec3(origin + glm::ivec3(x, y, z)) * h;
+                        glm::vec3 p1 = glm::vec3(origin + n1) * h;
+                        glm::vec3 g = glm::mix(gradient(nodes, glm::ivec3(x, y, z)), gradient(nodes, n1), t);
+                        float len = glm::length(g);
+                        block.edgeVertex[((z * BLOCK + y) * BLOCK + x) * 3 + a] = (int)block.vertices.size();
+                        block.vertices.push_back(glm::mix(p0, p1, t));
+                        block.normals.push_back(len > 1e-12f ? -g / len : glm::vec3(0.0f, 1.0f, 0.0f)); // the field grows inward
+                    }
+                }
+
+        // triangles of every cube, edges named in the node box so the far faces point into the neighbors
+        for (int z = 0; z < BLOCK; z++)
+            for (int y = 0; y < BLOCK; y++)
+                for (int x = 0; x < BLOCK; x++)
+                {
+                    int config = 0;
+                    for (int corner = 0; corner < 8; corner++)
+                    {
+                        if (inside(x + (corner & 1), y + ((corner >> 1) & 1), z + ((corner >> 2) & 1)))
+                            config |= 1 << corner;
+                    }
+                    for (int e : table.triangles[config])
+                    {
+                        int s = table.edgeStart[e];
+                        int sx = x + (s & 1), sy = y + ((s >> 1) & 1), sz = z + ((s >> 2) & 1);
+                        block.triangleEdges.push_back((uint16_t)(((sz * (BLOCK + 1) + sy) * (BLOCK + 1) + sx) * 3 + table.edgeAxis[e]));
+                    }
+                }
+    }
+
+    // global vertex of an edge named in the node box of block k, -1 when the owner has none
+    long long resolveEdge(long long k, glm::ivec3 c, uint16_t edge)
+    {
+        int a = edge % 3, node = edge / 3;
+        glm::ivec3 s(node % (BLOCK + 1), (node / (BLOCK + 1)) % (BLOCK + 1), node / ((BLOCK + 1) * (BLOCK + 1)));
+        glm::ivec3 offset(s.x == BLOCK, s.y == BLOCK, s.z == BLOCK);
+        long long owner = k;
+        if (offset != glm::ivec3(0))
+        {
+            owner = findKey(blockKeys, packKey(c + offset));
+            if (owner < 0)
+                return -1;
+            s -= offset * BLOCK;
+        }
+        int local = blocks[owner].edgeVertex[((s.z * BLOCK + s.y) * BLOCK + s.x) * 3 + a];
+        return local < 0 ? -1 : (long long)vertexStart[owner] + local;
+    }
+
+    static int nodeIndex(int x, int y, int z)
+    {
+        return ((z + 1) * NODES + (y + 1)) * NODES + (x + 1);
+    }
+
+    // central differences, n in [0, BLOCK]
+    static glm::vec3 gradient(const std::vector<float> &nodes, glm::ivec3 n)
+    {
+        return glm::vec3(nodes[nodeIndex(n.x + 1, n.y, n.z)] - nodes[nodeIndex(n.x - 1, n.y, n.z)],
+                         nodes[nodeIndex(n.x, n.y + 1, n.z)] - nodes[nodeIndex(n.x, n.y - 1, n.z)],
+                         nodes[nodeIndex(n.x, n.y, n.z + 1)] - nodes[nodeIndex(n.x, n.y, n.z - 1)]);
+    }
+
+    long long findBin(uint64_t key) const
+    {
+        return findKey(binKeys, key);
+    }
+
+    static long long findKey(const std::vector<uint64_t> &sorted, uint64_t key)
+    {
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), key);
+        return it != sorted.end() && *it == key ? it - sorted.begin() : -1;
+    }
+
+    // 21 bits per axis, z in the high bits
+    static uint64_t packKey(glm::ivec3 c)
+    {
+        const int bias = 1 << 20;
+        return ((uint64_t)(c.z + bias) << 42) | ((uint64_t)(c.y + bias) << 21) | (uint64_t)(c.x + bias);
+    }
+
+    static glm::ivec3 unpackKey(uint64_t key)
+    {
+        const int bias = 1 << 20;
+        const uint64_t mask = (1ull << 21) - 1;
+        return glm::ivec3((int)(key & mask) - bias, (int)((key >> 21) & mask) - bias, (int)(key >> 42) - bias);
+    }
+
+    static uint32_t floatBits(float f)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+
+    static uint64_t mix(uint64_t h, uint64_t value)
+    {
+        h ^= value + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        h ^= h >> 31;
+        h *= 0xbf58476d1ce4e5b9ull;
+        return h ^ (h >> 29);
+    }
+
+    //================[case tables]========================
+    /**
+     * Triangles of the 256 corner configurations, derived once instead of spelled out
+     * - corner c sits at (c & 1, c >> 1 & 1, c >> 2 & 1), an edge joins two corners one bit apart
+     * - on every face the crossings are walked counter clockwise seen from outside the cube, each exit (inside to outside)
+     *   is joined to the entry before it: ambiguous faces keep their inside corners apart, and a face read from the
+     *   neighbor cube gives the same segments reversed, so the surface is closed and consistently wound
+     * - the directed segments chain into loops around the cube, each loop is fanned into triangles
+     */
+    struct Tables
+    {
+        int edgeStart[12];
+        int edgeAxis[12];
+        std::vector<int> triangles[256]; // 3 edges per triangle
+    };
+
+    static const Tables &tables()
+    {
+        static const Tables built = buildTables();
+        return built;
+    }
+
+    static Tables buildTables()
+    {
+        Tables t;
+        int edgeOf[8][8];
+        int edgeCount = 0;
+        for (int c = 0; c < 8; c++)
+            for (int a = 0; a < 3; a++)
+            {
+                if (c & (1 << a))
+                    continue;
+                int d = c | (1 << a);
+                t.edgeStart[edgeCount] = c;
+                t.edgeAxis[edgeCount] = a;
+                edgeOf[c][d] = edgeOf[d][c] = edgeCount++;
+            }
+
+        // faces as corner loops, counter clockwise seen along the outward normal
+        int faces[6][4];
+        for (int a = 0; a < 3; a++)
+        {
+            int u = (a + 1) % 3, v = (a + 2) % 3;
+            const int loop[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+            for (int side = 0; side < 2; side++)
+            {
+                for (int k = 0; k < 4; k++)
+                {
+                    // the low face is seen from the other side, walk it mirrored
+                    int cu = loop[k][side ? 0 : 1], cv = loop[k][side ? 1 : 0];
+                    faces[a * 2 + side][k] = (side << a) | (cu << u) | (cv << v);
+                }
+            }
+        }
+
+        for (int config = 0; config < 256; config++)
+        {
+            int next[12];
+            std::fill(next, next + 12, -1);
+            for (int f = 0; f < 6; f++)
+            {
+                int crossing[4], exits[4], count = 0;
+                for (int k = 0; k < 4; k++)
+                {
+                    int p = faces[f][k], q = faces[f][(k + 1) % 4];
+                    bool inP = config >> p & 1, inQ = config >> q & 1;
+                    if (inP == inQ)
+                        continue;
+                    crossing[count] = edgeOf[p][q];
+                    exits[count++] = inP;
+                }
+                for (int k = 0; k < count; k++)
+                {
+                    if (exits[k])
+                        next[crossing[k]] = crossing[(k + count - 1) % count];
+                }
+            }
+
+            bool visited[12] = {};
+            for (int e = 0; e < 12; e++)
+            {
+                if (next[e] < 0 || visited[e])
+                    continue;
+                std::vector<int> loop;
+                for (int k = e; !visited[k]; k = next[k])
+                {
+                    visited[k] = true;
+                    loop.push_back(k);
+                }
+                // a diagonal lying in a cube face would be shared with the neighbor cube and pinch the surface there
+                size_t n = loop.size(), first = 0;
+                for (size_t r = 0; r < n; r++)
+                {
+                    bool inFace = false;
+                    for (size_t k = 2; k + 1 < n && !inFace; k++)
+                    {
+                        inFace = shareFace(t, loop[r], loop[(r + k) % n]);
+                    }
+                    if (!inFace)
+                    {
+                        first = r;
+                        break;
+                    }
+                }
+                // the loops run clockwise seen from outside the fluid, the triangles are wound counter clockwise
+                for (size_t k = 1; k + 1 < n; k++)
+                {
+                    t.triangles[config].push_back(loop[first]);
+                    t.triangles[config].push_back(loop[(first + k + 1) % n]);
+                    t.triangles[config].push_back(loop[(first + k) % n]);
+                }
+            }
+        }
+        return t;
+    }
+
+    // both edges lie on one of the six faces: their four corners agree on one axis
+    static bool shareFace(const Tables &t, int e0, int e1)
+    {
+        int corners[4] = {t.edgeStart[e0], t.edgeStart[e0] | (1 << t.edgeAxis[e0]),
+                          t.edgeStart[e1], t.edgeStart[e1] | (1 << t.edgeAxis[e1])};
+        for (int a = 0; a < 3; a++)
+        {
+            int bits = 0;
+            for (int c : corners)
+            {
+                bits += c >> a & 1;
+            }
+            if (bits == 0 || bits == 4)
+                return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+
+#include <Graphic/SurfaceExtractor.h>
+
+/**
+ * Indexed GPU buffer of the extracted fluid surface
+ * - VBO holds two tightly packed streams: positions | normals, triangles drawn through an EBO
+ * - the mesh changes size every extraction, buffers are sized to a capacity that doubles,
+ *   a frame only streams the used part with glBufferSubData
+ */
+class SurfaceRenderBuffer
+{
+public:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+
+    SurfaceRenderBuffer() {}
+    ~SurfaceRenderBuffer()
+    {
+        destroy();
+    }
+
+    SurfaceRenderBuffer(const SurfaceRenderBuffer &) = delete;
+    SurfaceRenderBuffer &operator=(const SurfaceRenderBuffer &) = delete;
+
+    // upload the last extraction (needs a current GL context)
+    void update(const SurfaceExtractor &surface)
+    {
+        size_t vertexCount = surface.vertices.size();
+        indexCount = surface.indices.size();
+        if (VAO == 0)
+        {
+            glGenVertexArrays(1, &VAO);
+            glGenBuffers(1, &VBO);
+            glGenBuffers(1, &EBO);
+        }
+        glBindVertexArray(VAO);
+        if (vertexCount > vertexCapacity || VBO == 0)
+        {
+            vertexCapacity = std::max(vertexCount, vertexCapacity * 2);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertexCapacity * 2 * sizeof(glm::vec3)), nullptr, GL_DYNAMIC_DRAW);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)(vertexCapacity * sizeof(glm::vec3)));
+            glEnableVertexAttribArray(1);
+        }
+        if (indexCount > indexCapacity)
+        {
+            indexCapacity = std::max(indexCount, indexCapacity * 2);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indexCapacity * sizeof(unsigned int)), nullptr, GL_DYNAMIC_DRAW);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)(vertexCount * sizeof(glm::vec3)), surface.vertices.data());
+        glBufferSubData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertexCapacity * sizeof(glm::vec3)), (GLsizeiptr)(vertexCount * sizeof(glm::vec3)), surface.normals.data());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, (GLsizeiptr)(indexCount * sizeof(unsigned int)), surface.indices.data());
+        glBindVertexArray(0);
+    }
+
+    void draw() const
+    {
+        if (VAO == 0 || indexCount == 0)
+            return;
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    void destroy()
+    {
+        if (VAO != 0)
+            glDeleteVertexArrays(1, &VAO);
+        if (VBO != 0)
+            glDeleteBuffers(1, &VBO);
+        if (EBO != 0)
+            glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+        vertexCapacity = indexCapacity = indexCount = 0;
+    }
+
+private:
+    size_t vertexCapacity = 0;
+    size_t indexCapacity = 0;
+    size_t indexCount = 0;
+};
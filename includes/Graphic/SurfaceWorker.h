@@ -0,0 +1,144 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <omp.h>
+
+#include <Graphic/SurfaceExtractor.h>
+
+/**
+ * Runs the fluid surface extraction on a worker thread so a frame never waits for the mesh
+ * - submit() copies the particle positions and the GUI parameters, the worker extracts from that snapshot with its own
+ *   SurfaceExtractor (which keeps the settled blocks between runs)
+ * - the finished mesh waits in a back buffer, collect() swaps it into the front extractor the renderer uploads from,
+ *   until then the GPU keeps the last finished mesh and that is what gets drawn
+ * - one snapshot in flight at a time, a submit while the worker is busy is dropped and the next frame tries again
+ */
+class SurfaceWorker
+{
+public:
+    //=======[adjustable parameters]========
+    int THREADS = std::max(1, omp_get_num_procs() / 2); // OpenMP threads of the worker, the rest stay with the solver
+    //======================================
+
+    SurfaceWorker() {}
+    ~SurfaceWorker()
+    {
+        stop();
+    }
+
+    SurfaceWorker(const SurfaceWorker &) = delete;
+    SurfaceWorker &operator=(const SurfaceWorker &) = delete;
+
+    /**
+     * Hand a snapshot of the particles to the worker, started on first use
+     * - settings - extractor whose parameters are used (the GUI edits them on the render thread)
+     * - returns false when the last snapshot is still being extracted
+     */
+    bool submit(const SurfaceExtractor &settings, const glm::vec3 *positions, size_t count)
+    {
+        if (!worker.joinable())
+        {
+            stopping = false;
+            worker = std::thread(&SurfaceWorker::run, this);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (requested || working)
+                return false;
+            snapshot.assign(positions, positions + count);
+            voxelSize = settings.VOXEL_SIZE;
+            splatRadius = settings.SPLAT_RADIUS;
+            isoLevel = settings.ISO_LEVEL;
+            incremental = settings.INCREMENTAL;
+            requested = true;
+        }
+        wakeWorker.notify_one();
+        return true;
+    }
+
+    // swap the last finished mesh and its stats into front, false when nothing finished since the last call
+    bool collect(SurfaceExtractor &front)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!finished)
+            return false;
+        front.vertices.swap(back.vertices);
+        front.normals.swap(back.normals);
+        front.indices.swap(back.indices);
+        front.lastExtractMs = back.lastExtractMs;
+        front.activeBlocks = back.activeBlocks;
+        front.rebuiltBlocks = back.rebuiltBlocks;
+        front.droppedTriangles = back.droppedTriangles;
+        finished = false;
+        return true;
+    }
+
+    void stop()
+    {
+        if (!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeWorker.notify_one();
+        worker.join();
+        requested = working = finished = false;
+    }
+
+private:
+    // shared with the worker, guarded by mutex
+    std::vector<glm::vec3> snapshot;
+    float voxelSize = 0.0f, splatRadius = 0.0f, isoLevel = 0.0f;
+    bool incremental = true;
+    SurfaceExtractor back; // only the mesh and the stats are used
+    bool requested = false;
+    bool working = false;
+    bool finished = false;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable wakeWorker;
+    std::thread worker;
+
+    void run()
+    {
+        omp_set_num_threads(THREADS); // per thread setting, the render thread keeps its own
+        SurfaceExtractor extractor;   // worker only
+        std::vector<glm::vec3> positions;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wakeWorker.wait(lock, [&]
+                            { return stopping || requested; });
+            if (stopping)
+                return;
+            positions.swap(snapshot);
+            extractor.VOXEL_SIZE = voxelSize;
+            extractor.SPLAT_RADIUS = splatRadius;
+            extractor.ISO_LEVEL = isoLevel;
+            extractor.INCREMENTAL = incremental;
+            requested = false;
+            working = true;
+            lock.unlock();
+
+            extractor.extract(positions.data(), positions.size());
+
+            lock.lock();
+            // the extractor rebuilds its mesh vectors from scratch, whatever the swap leaves in them is overwritten
+            back.vertices.swap(extractor.vertices);
+            back.normals.swap(extractor.normals);
+            back.indices.swap(extractor.indices);
+            back.lastExtractMs = extractor.lastExtractMs;
+            back.activeBlocks = extractor.activeBlocks;
+            back.rebuiltBlocks = extractor.rebuiltBlocks;
+            back.droppedTriangles = extractor.droppedTriangles;
+            working = false;
+            finished = true;
+        }
+    }
+};
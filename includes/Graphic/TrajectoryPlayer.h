@@ -0,0 +1,399 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+
+#include <trajectory.h>
+#include <Physics/SPHSolver.h>
+#include <Physics/SoftBodyWorld.h>
+
+/**
+ * Plays a recorded .traj file in place of the solvers
+ * - a worker thread decodes the READ_AHEAD frames following the play cursor (in play direction) into a small cache,
+ *   the render thread only swaps a finished frame out of it, a frame that is not ready yet keeps the last one on screen
+ * - play time advances by SPEED recorded seconds per second, negative plays backwards (every frame then decodes
+ *   from its keyframe), seek() scrubs
+ * - apply() writes the frame into the solver pools (positions, velocities from the frame difference, speed colors),
+ *   so every renderer and the GUI keep reading the state they always read
+ * - saveLive() / restoreLive() keep what apply() overwrites, the simulation resumes where it was when playback ends
+ */
+class TrajectoryPlayer
+{
+public:
+    //=======[adjustable parameters]========
+    bool PLAYING = true;
+    float SPEED = 1.0f; // recorded seconds per second, negative plays backwards
+    bool LOOP = true;
+    //======================================
+
+    static constexpr int READ_AHEAD = 16; // decoded frames kept ahead of the cursor
+
+    // stats
+    int framesShown = 0;
+    int framesLate = 0; // the cursor moved on before the worker had the frame
+    int framesBad = 0;  // failed to decode, skipped with the last good frame left on screen
+
+    TrajectoryPlayer() {}
+    ~TrajectoryPlayer()
+    {
+        close();
+    }
+
+    TrajectoryPlayer(const TrajectoryPlayer &) = delete;
+    TrajectoryPlayer &operator=(const TrajectoryPlayer &) = delete;
+
+    bool open(const std::string &path)
+    {
+        close();
+        TrajectoryReader reader(path);
+        if (!reader.isOpen() || reader.frameCount() == 0)
+            return false;
+        frameTimes.resize(reader.frameCount());
+        for (size_t f = 0; f < frameTimes.size(); f++)
+        {
+            frameTimes[f] = reader.frameTime(f);
+        }
+        this->path = path;
+        playTime = frameTimes.front();
+        cursor = 0;
+        shown = -1;
+        direction = 1;
+        looping = LOOP;
+        framesShown = framesLate = framesBad = 0;
+        for (Frame &slot : cache)
+        {
+            slot.index = -1;
+        }
+        stopping = false;
+        worker = std::thread(&TrajectoryPlayer::run, this);
+        return true;
+    }
+
+    void close()
+    {
+        if (!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeWorker.notify_one();
+        worker.join();
+        frameTimes.clear();
+    }
+
+    bool isOpen() const
+    {
+        return worker.joinable();
+    }
+
+    size_t frameCount() const
+    {
+        return frameTimes.size();
+    }
+
+    // frame on screen, -1 before the first one arrived
+    long long currentFrame() const
+    {
+        return shown;
+    }
+
+    double duration() const
+    {
+        return frameTimes.empty() ? 0.0 : frameTimes.back() - frameTimes.front();
+    }
+
+    // jump to frame, the worker starts decoding there right away
+    void seek(size_t frame)
+    {
+        if (frameTimes.empty())
+            return;
+        frame = std::min(frame, frameTimes.size() - 1);
+        playTime = frameTimes[frame];
+        moveCursor((long long)frame, direction);
+    }
+
+    /**
+     * Advance the play time by deltaTime * SPEED and pick up the frame under it
+     * - returns true when a new frame is ready for apply()
+     */
+    bool update(float deltaTime)
+    {
+        if (!isOpen())
+            return false;
+        if (PLAYING && SPEED != 0.0f)
+        {
+            playTime += (double)deltaTime * SPEED;
+            if (playTime > frameTimes.back() || playTime < frameTimes.front())
+            {
+                double length = duration();
+                if (LOOP && length > 0.0)
+                {
+                    // keep the overshoot, a fast loop wraps by the same amount of time every time
+                    double offset = std::fmod(playTime - frameTimes.front(), length);
+                    playTime = frameTimes.front() + (offset < 0.0 ? offset + length : offset);
+                }
+                else if (LOOP)
+                    playTime = frameTimes.front();
+                else
+                    playTime = std::min(std::max(playTime, frameTimes.front()), frameTimes.back());
+            }
+            // last frame recorded at or before the play time
+            long long frame = (long long)(std::upper_bound(frameTimes.begin(), frameTimes.end(), playTime) - frameTimes.begin()) - 1;
+            moveCursor(std::max(frame, 0ll), SPEED < 0.0f ? -1 : 1);
+        }
+
+        long long wanted = cursor;
+        if (wanted == shown)
+            return false;
+        bool bad;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Frame *slot = find(wanted);
+            if (slot == nullptr)
+            {
+                framesLate++;
+                return false;
+            }
+            bad = slot->bad;
+            if (!bad)
+                std::swap(*slot, display);
+            slot->index = -1;
+            shown = wanted; // a bad frame is passed over like a shown one, so the worker does not decode it again
+        }
+        wakeWorker.notify_one(); // a slot is free again
+        if (bad)
+        {
+            framesBad++;
+            return false; // display still holds the last good frame
+        }
+        framesShown++;
+        return true;
+    }
+
+    /**
+     * Write the frame on screen into the solvers, either may be nullptr
+     * - the fluid pool grows to the recorded count, the soft body pool is only written when the counts match
+     */
+    void apply(SPHSolver *solver, SoftBodyWorld *world) const
+    {
+        if (shown < 0)
+            return;
+        if (solver != nullptr)
+        {
+            int count = (int)display.fluid.size();
+            solver->reserveParticles(count);
+            solver->alive = count;
+            std::copy(display.fluid.begin(), display.fluid.end(), solver->positions.begin());
+            std::copy(display.fluid.begin(), display.fluid.end(), solver->predicted_positions.begin());
+            std::copy(display.velocities.begin(), display.velocities.end(), solver->velocities.begin());
+            std::copy(display.colors.begin(), display.colors.end(), solver->colors.begin());
+        }
+        if (world != nullptr && display.soft.size() == world->positions.size())
+        {
+            std::copy(display.soft.begin(), display.soft.end(), world->positions.begin());
+            world->triangleCollision.invalidateTrees(); // sleeping bodies moved too
+        }
+    }
+
+    // copy the pool parts apply() overwrites, either may be nullptr
+    void saveLive(const SPHSolver *solver, const SoftBodyWorld *world)
+    {
+        live.saved = true;
+        live.alive = solver != nullptr ? solver->alive : 0;
+        if (solver != nullptr)
+        {
+            live.positions.assign(solver->positions.begin(), solver->positions.begin() + live.alive);
+            live.predicted.assign(solver->predicted_positions.begin(), solver->predicted_positions.begin() + live.alive);
+            live.velocities.assign(solver->velocities.begin(), solver->velocities.begin() + live.alive);
+            live.colors.assign(solver->colors.begin(), solver->colors.begin() + live.alive);
+        }
+        live.soft.clear();
+        if (world != nullptr)
+            live.soft = world->positions;
+    }
+
+    // put the state of the last saveLive() back, the pools only grew in between so it fits
+    void restoreLive(SPHSolver *solver, SoftBodyWorld *world)
+    {
+        if (!live.saved)
+            return;
+        live.saved = false;
+        if (solver != nullptr && (size_t)live.alive <= solver->positions.size())
+        {
+            solver->alive = live.alive;
+            std::copy(live.positions.begin(), live.positions.end(), solver->positions.begin());
+            std::copy(live.predicted.begin(), live.predicted.end(), solver->predicted_positions.begin());
+            std::copy(live.velocities.begin(), live.velocities.end(), solver->velocities.begin());
+            std::copy(live.colors.begin(), live.colors.end(), solver->colors.begin());
+        }
+        if (world != nullptr && live.soft.size() == world->positions.size())
+        {
+            std::copy(live.soft.begin(), live.soft.end(), world->positions.begin());
+            world->triangleCollision.invalidateTrees();
+        }
+    }
+
+private:
+    struct Frame
+    {
+        long long index = -1;
+        bool bad = false; // readFrame failed, the vectors hold nothing usable
+        std::vector<glm::vec3> fluid;
+        std::vector<glm::vec3> soft;
+        std::vector<glm::vec3> velocities; // fluid, from the previous frame
+        std::vector<glm::vec4> colors;
+    };
+
+    std::string path;
+    std::vector<double> frameTimes;
+    double playTime = 0.0;
+    Frame display; // render thread only
+
+    // simulation state from before playback, render thread only
+    struct LiveState
+    {
+        bool saved = false;
+        int alive = 0;
+        std::vector<glm::vec3> positions, predicted, velocities;
+        std::vector<glm::vec4> colors;
+        std::vector<glm::vec3> soft;
+    } live;
+
+    // shared with the worker, guarded by mutex (the render thread reads its own writes without it)
+    Frame cache[READ_AHEAD];
+    long long cursor = 0;
+    long long shown = -1;
+    int direction = 1;
+    bool looping = true; // LOOP as of the last cursor move
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable wakeWorker;
+    std::thread worker;
+
+    void moveCursor(long long frame, int dir)
+    {
+        if (frame == cursor && dir == direction && looping == LOOP)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cursor = frame;
+            direction = dir;
+            looping = LOOP;
+        }
+        wakeWorker.notify_one();
+    }
+
+    Frame *find(long long index)
+    {
+        for (Frame &slot : cache)
+        {
+            if (slot.index == index)
+                return &slot;
+        }
+        return nullptr;
+    }
+
+    // position of frame in the read ahead window, outside when not in [0, READ_AHEAD)
+    long long windowOffset(long long frame) const
+    {
+        long long offset = (frame - cursor) * direction;
+        if (looping && offset < 0)
+            offset += (long long)frameTimes.size();
+        return offset;
+    }
+
+    // empty slot or one holding a frame the window left behind, -1 when every slot is still wanted
+    int freeSlot() const
+    {
+        for (int s = 0; s < READ_AHEAD; s++)
+        {
+            long long offset = windowOffset(cache[s].index);
+            if (cache[s].index < 0 || offset < 0 || offset >= READ_AHEAD)
+                return s;
+        }
+        return -1;
+    }
+
+    // nearest frame of the window that is neither cached nor on screen, -1 when there is nothing to do
+    long long nextMissing()
+    {
+        if (freeSlot() < 0)
+            return -1;
+        long long frames = (long long)frameTimes.size();
+        for (int k = 0; k < READ_AHEAD; k++)
+        {
+            long long f = cursor + k * direction;
+            if (looping)
+                f = ((f % frames) + frames) % frames;
+            if (f < 0 || f >= frames)
+                break;
+            if (f != shown && find(f) == nullptr)
+                return f;
+        }
+        return -1;
+    }
+
+    void run()
+    {
+        TrajectoryReader reader(path);
+        Frame decoded;
+        std::vector<glm::vec3> previousFluid, previousSoft;
+        long long previousIndex = -1; // frame held by previousFluid
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            long long f = -1;
+            wakeWorker.wait(lock, [&]
+                            { return stopping || (f = nextMissing()) >= 0; });
+            if (stopping)
+                return;
+            lock.unlock();
+
+            // the frame before gives the velocities, in sequential play it is the last decoded one
+            if (f > 0 && previousIndex != f - 1)
+                previousIndex = reader.readFrame((size_t)f - 1, previousFluid, previousSoft) ? f - 1 : -1;
+            decoded.bad = !reader.readFrame((size_t)f, decoded.fluid, decoded.soft);
+            if (!decoded.bad)
+            {
+                bool hasPrevious = f > 0 && previousIndex == f - 1 && previousFluid.size() == decoded.fluid.size();
+                float dt = hasPrevious ? (float)(frameTimes[f] - frameTimes[f - 1]) : 0.0f;
+                fillVelocities(decoded, hasPrevious && dt > 0.0f ? previousFluid.data() : nullptr, dt);
+                previousFluid = decoded.fluid;
+                previousIndex = f;
+            }
+            decoded.index = f;
+
+            lock.lock();
+            // the window may have moved while decoding, the frame goes in only if it still belongs there
+            long long offset = windowOffset(f);
+            int slot = freeSlot();
+            if (offset >= 0 && offset < READ_AHEAD && slot >= 0 && f != shown && find(f) == nullptr)
+                std::swap(cache[slot], decoded);
+        }
+    }
+
+    // particle velocities and the solver's blue to red speed colors
+    static void fillVelocities(Frame &frame, const glm::vec3 *previous, float dt)
+    {
+        size_t count = frame.fluid.size();
+        frame.velocities.resize(count);
+        frame.colors.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            glm::vec3 v = previous != nullptr ? (frame.fluid[i] - previous[i]) / dt : glm::vec3(0.0f);
+            float velSqr = glm::dot(v, v);
+            float t = velSqr < 1.0f ? 0.0f : std::min(velSqr / 100.0f, 1.0f);
+            frame.velocities[i] = v;
+            frame.colors[i] = glm::vec4(t, 0.0f, 1.0f - t, 1.0f);
+        }
+    }
+};
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <omp.h>
+
+struct AABB
+{
+    glm::vec3 lo = glm::vec3(FLT_MAX);
+    glm::vec3 hi = glm::vec3(-FLT_MAX);
+
+    void grow(const glm::vec3 &p)
+    {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    void grow(const AABB &box)
+    {
+        lo = glm::min(lo, box.lo);
+        hi = glm::max(hi, box.hi);
+    }
+    void inflate(float margin)
+    {
+        lo -= glm::vec3(margin);
+        hi += glm::vec3(margin);
+    }
+    bool overlaps(const AABB &box) const
+    {
+        return lo.x <= box.hi.x && box.lo.x <= hi.x &&
+               lo.y <= box.hi.y && box.lo.y <= hi.y &&
+               lo.z <= box.hi.z && box.lo.z <= hi.z;
+    }
+    bool contains(const glm::vec3 &p) const
+    {
+        return p.x >= lo.x && p.x <= hi.x && p.y >= lo.y && p.y <= hi.y && p.z >= lo.z && p.z <= hi.z;
+    }
+    glm::vec3 center() const
+    {
+        return (lo + hi) * 0.5f;
+    }
+    float surfaceArea() const
+    {
+        glm::vec3 d = glm::max(hi - lo, glm::vec3(0.0f));
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+};
+
+/**
+ * Bounding volume hierarchy over a fixed set of primitive boxes (triangles of a body, or bodies of a world)
+ * - built once top down (median split on the longest centroid axis), after that only refit bottom up
+ * - refit walks the tree level by level from the deepest one, nodes of a level are independent so each level is a parallel loop
+ * - quality = summed node surface area relative to the root, compared to the value right after the last build,
+ *   the topology is rebuilt when it degrades past REBUILD_THRESHOLD
+ */
+class BVH
+{
+public:
+    //=======[adjustable parameters]========
+    int LEAF_SIZE = 4;
+    float REBUILD_THRESHOLD = 1.5f; // rebuild when the cost grew by this factor since the last build
+    int PARALLEL_MIN_NODES = 2048;  // smaller levels are refit serially
+    //======================================
+
+    struct Node
+    {
+        AABB box;
+        int left = -1, right = -1;             // children of an inner node
+        unsigned int first = 0, count = 0;     // primitives[first .. first + count) of a leaf, count == 0 for inner nodes
+    };
+
+    std::vector<Node> nodes; // nodes[0] is the root
+    std::vector<unsigned int> primitives;
+
+    // stats
+    double lastRefitMs = 0.0;
+    double lastRebuildMs = 0.0;
+    int refitCount = 0;
+    int rebuildCount = 0;
+    float quality = 1.0f; // current cost / cost after build, 1 is as good as new
+
+    bool empty() const
+    {
+        return nodes.empty();
+    }
+
+    const AABB &bounds() const
+    {
+        return nodes[0].box;
+    }
+
+    void build(const std::vector<AABB> &boxes)
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        nodes.clear();
+        levels.clear();
+        primitives.resize(boxes.size());
+        for (size_t i = 0; i < boxes.size(); i++)
+        {
+            primitives[i] = (unsigned int)i;
+        }
+        if (!boxes.empty())
+        {
+            nodes.reserve(boxes.size() * 2);
+            buildNode(boxes, 0, (unsigned int)boxes.size(), 0);
+        }
+        builtCost = cost();
+        quality = 1.0f;
+        rebuildCount++;
+        lastRebuildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+    }
+
+    // refit to the new primitive boxes, returns true when it had to rebuild
+    bool update(const std::vector<AABB> &boxes)
+    {
+        if (boxes.size() != primitives.size() || nodes.empty())
+        {
+            build(boxes);
+            return true;
+        }
+        refit(boxes);
+        if (quality > REBUILD_THRESHOLD)
+        {
+            build(boxes);
+            return true;
+        }
+        return false;
+    }
+
+    void refit(const std::vector<AABB> &boxes)
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        for (int depth = (int)levels.size() - 1; depth >= 0; depth--)
+        {
+            const std::vector<int> &level = levels[depth];
+            long long count = (long long)level.size();
+#pragma omp parallel for if (count >= PARALLEL_MIN_NODES)
+            for (long long k = 0; k < count; k++)
+            {
+                Node &node = nodes[level[k]];
+                AABB box;
+                if (node.count > 0)
+                {
+                    for (unsigned int p = node.first; p < node.first + node.count; p++)
+                    {
+                        box.grow(boxes[primitives[p]]);
+                    }
+                }
+                else
+                {
+                    box.grow(nodes[node.left].box);
+                    box.grow(nodes[node.right].box);
+                }
+                node.box = box;
+            }
+        }
+        quality = builtCost > 0.0f ? cost() / builtCost : 1.0f;
+        refitCount++;
+        lastRefitMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+    }
+
+    // calls callback(primitive) for every primitive whose leaf box overlaps box
+    template <typename Func>
+    void query(const AABB &box, Func callback) const
+    {
+        if (nodes.empty())
+            return;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node &node = nodes[stack[--top]];
+            if (!node.box.overlaps(box))
+                continue;
+            if (node.count > 0)
+            {
+                for (unsigned int p = node.first; p < node.first + node.count; p++)
+                {
+                    callback(primitives[p]);
+                }
+            }
+            else
+            {
+                stack[top++] = node.left;
+                stack[top++] = node.right;
+            }
+        }
+    }
+
+    /**
+     * Closest primitive to p, branch and bound with the nearer child first
+     * - distanceSq(primitive) - exact squared distance from p to a primitive
+     * - maxDistanceSq - nothing farther is reported
+     * returns the primitive or -1, bestSq receives its squared distance
+     */
+    template <typename Func>
+    int nearest(const glm::vec3 &p, Func distanceSq, float &bestSq, float maxDistanceSq = FLT_MAX) const
+    {
+        bestSq = maxDistanceSq;
+        int best = -1;
+        if (nodes.empty())
+            return best;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node &node = nodes[stack[--top]];
+            if (boxDistanceSq(node.box, p) >= bestSq)
+                continue;
+            if (node.count > 0)
+            {
+                for (unsigned int k = node.first; k < node.first + node.count; k++)
+                {
+                    float d = distanceSq(primitives[k]);
+                    if (d < bestSq)
+                    {
+                        bestSq = d;
+                        best = (int)primitives[k];
+                    }
+                }
+                continue;
+            }
+            // the nearer child goes on top so it is searched first and tightens bestSq
+            float dl = boxDistanceSq(nodes[node.left].box, p), dr = boxDistanceSq(nodes[node.right].box, p);
+            if (dl < dr)
+            {
+                stack[top++] = node.right;
+                stack[top++] = node.left;
+            }
+            else
+            {
+                stack[top++] = node.left;
+                stack[top++] = node.right;
+            }
+        }
+        return best;
+    }
+
+    static float boxDistanceSq(const AABB &box, const glm::vec3 &p)
+    {
+        glm::vec3 d = glm::max(glm::max(box.lo - p, p - box.hi), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+
+private:
+    std::vector<std::vector<int>> levels; // node indices by depth, refit goes from the back
+    float builtCost = 0.0f;
+
+    int buildNode(const std::vector<AABB> &boxes, unsigned int first, unsigned int count, int depth)
+    {
+        int index = (int)nodes.size();
+        nodes.emplace_back();
+        if ((int)levels.size() <= depth)
+            levels.resize(depth + 1);
+        levels[depth].push_back(index);
+
+        AABB box, centroids;
+        for (unsigned int p = first; p < first + count; p++)
+        {
+            box.grow(boxes[primitives[p]]);
+            centroids.grow(boxes[primitives[p]].center());
+        }
+        nodes[index].box = box;
+
+        // the median split keeps the depth at log2(n / LEAF_SIZE), well inside the query stack
+        if ((int)count <= LEAF_SIZE)
+        {
+            nodes[index].first = first;
+            nodes[index].count = count;
+            return index;
+        }
+
+        glm::vec3 extent = centroids.hi - centroids.lo;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        unsigned int half = count / 2;
+        std::nth_element(primitives.begin() + first, primitives.begin() + first + half, primitives.begin() + first + count,
+                         [&](unsigned int a, unsigned int b)
+                         { return boxes[a].center()[axis] < boxes[b].center()[axis]; });
+
+        int left = buildNode(boxes, first, half, depth + 1);
+        int right = buildNode(boxes, first + half, count - half, depth + 1);
+        nodes[index].left = left;
+        nodes[index].right = right;
+        return index;
+    }
+
+    // SAH style cost: summed surface area of all nodes relative to the root
+    float cost() const
+    {
+        if (nodes.empty())
+            return 0.0f;
+        float root = nodes[0].box.surfaceArea();
+        if (root <= 0.0f)
+            return 0.0f;
+        double sum = 0.0;
+        for (const Node &node : nodes)
+        {
+            sum += node.box.surfaceArea();
+        }
+        return (float)(sum / root);
+    }
+};
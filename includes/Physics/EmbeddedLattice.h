@@ -0,0 +1,233 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <omp.h>
+
+#include <objectloader.h>
+
+/**
+ * Trilinear embedding of a render mesh inside a coarse voxel cage.
+ * every render vertex stores the 8 cage nodes of its cell and their weights
+ */
+struct LatticeEmbedding
+{
+    std::vector<unsigned int> nodes; // 8 cage node indices per render vertex
+    std::vector<float> weights;      // 8 trilinear weights per render vertex
+    size_t renderVertexCount = 0;
+};
+
+class EmbeddedLattice
+{
+public:
+    /**
+     * Voxelize the mesh into a solid coarse cage and compute the embedding
+     * - mesh - dense render mesh (rest shape)
+     * - resolution - number of cells along the longest side of the bounding box
+     * - outCage - cage as a soft body mesh (no faces), ready for SoftBodyWorld::addBody
+     * - outEmbedding - weights to rebuild render vertices from cage nodes
+     */
+    static bool buildCage(const SoftBodyMesh &mesh, int resolution, SoftBodyMesh &outCage, LatticeEmbedding &outEmbedding)
+    {
+        if (mesh.vertices.empty() || resolution < 1)
+            return false;
+
+        glm::vec3 bbMin = mesh.vertices[0], bbMax = mesh.vertices[0];
+        for (auto &p : mesh.vertices)
+        {
+            bbMin = glm::min(bbMin, p);
+            bbMax = glm::max(bbMax, p);
+        }
+        glm::vec3 extent = bbMax - bbMin;
+        float cell_size = std::max(extent.x, std::max(extent.y, extent.z)) / (float)resolution;
+        if (cell_size <= 0.0f)
+            cell_size = 1.0f;
+
+        // one layer of padding around the mesh so the outside is connected for the flood fill
+        glm::vec3 origin = bbMin - glm::vec3(cell_size);
+        glm::ivec3 dim(
+            (int)std::ceil(extent.x / cell_size) + 2,
+            (int)std::ceil(extent.y / cell_size) + 2,
+            (int)std::ceil(extent.z / cell_size) + 2);
+        dim = glm::max(dim, glm::ivec3(3, 3, 3));
+
+        auto cellIndex = [&](int x, int y, int z)
+        { return (size_t)x + (size_t)dim.x * ((size_t)y + (size_t)dim.y * (size_t)z); };
+        auto toCell = [&](glm::vec3 p)
+        {
+            glm::ivec3 c(glm::floor((p - origin) / cell_size));
+            return glm::clamp(c, glm::ivec3(0, 0, 0), dim - glm::ivec3(1, 1, 1));
+        };
+
+        // 0 = unknown, 1 = surface, 2 = outside
+        std::vector<unsigned char> cells((size_t)dim.x * dim.y * dim.z, 0);
+
+        // rasterize triangle bounding boxes (faces hold v/vn/vt triples, 3 per corner)
+        for (size_t f = 0; f + 8 < mesh.faces.size(); f += 9)
+        {
+            glm::vec3 a = mesh.vertices[mesh.faces[f]];
+            glm::vec3 b = mesh.vertices[mesh.faces[f + 3]];
+            glm::vec3 c = mesh.vertices[mesh.faces[f + 6]];
+            glm::ivec3 lo = toCell(glm::min(a, glm::min(b, c)));
+            glm::ivec3 hi = toCell(glm::max(a, glm::max(b, c)));
+            for (int z = lo.z; z <= hi.z; z++)
+                for (int y = lo.y; y <= hi.y; y++)
+                    for (int x = lo.x; x <= hi.x; x++)
+                        cells[cellIndex(x, y, z)] = 1;
+        }
+        for (auto &p : mesh.vertices)
+        {
+            glm::ivec3 c = toCell(p);
+            cells[cellIndex(c.x, c.y, c.z)] = 1;
+        }
+
+        // flood fill the outside from the padded corner, whatever is left is solid
+        std::vector<glm::ivec3> stack = {glm::ivec3(0, 0, 0)};
+        cells[0] = 2;
+        while (!stack.empty())
+        {
+            glm::ivec3 c = stack.back();
+            stack.pop_back();
+            for (int k = 0; k < 6; k++)
+            {
+                glm::ivec3 n = c;
+                n[k / 2] += (k % 2) ? 1 : -1;
+                if (n.x < 0 || n.y < 0 || n.z < 0 || n.x >= dim.x || n.y >= dim.y || n.z >= dim.z)
+                    continue;
+                unsigned char &state = cells[cellIndex(n.x, n.y, n.z)];
+                if (state != 0)
+                    continue;
+                state = 2;
+                stack.push_back(n);
+            }
+        }
+
+        // cage nodes on the (dim+1)^3 lattice, only the ones used by a solid cell
+        glm::ivec3 ndim = dim + glm::ivec3(1, 1, 1);
+        auto nodeIndex = [&](int x, int y, int z)
+        { return (size_t)x + (size_t)ndim.x * ((size_t)y + (size_t)ndim.y * (size_t)z); };
+        std::vector<int> nodeId((size_t)ndim.x * ndim.y * ndim.z, -1);
+
+        outCage = SoftBodyMesh();
+        std::vector<uint64_t> edgeKeys;
+        for (int z = 0; z < dim.z; z++)
+            for (int y = 0; y < dim.y; y++)
+                for (int x = 0; x < dim.x; x++)
+                {
+                    if (cells[cellIndex(x, y, z)] == 2)
+                        continue;
+
+                    unsigned int corner[8];
+                    for (int k = 0; k < 8; k++)
+                    {
+                        int cx = x + (k & 1), cy = y + ((k >> 1) & 1), cz = z + ((k >> 2) & 1);
+                        int &id = nodeId[nodeIndex(cx, cy, cz)];
+                        if (id < 0)
+                        {
+                            id = (int)outCage.vertices.size();
+                            outCage.vertices.push_back(origin + glm::vec3((float)cx, (float)cy, (float)cz) * cell_size);
+                        }
+                        corner[k] = (unsigned int)id;
+                    }
+
+                    // 12 cell edges + 4 body diagonals for shear resistance
+                    for (int k = 0; k < 8; k++)
+                    {
+                        for (int bit = 1; bit < 8; bit <<= 1)
+                        {
+                            if (!(k & bit))
+                                edgeKeys.push_back(packEdge(corner[k], corner[k | bit]));
+                        }
+                    }
+                    for (int k = 0; k < 4; k++)
+                    {
+                        edgeKeys.push_back(packEdge(corner[k], corner[7 - k]));
+                    }
+                }
+
+        std::sort(edgeKeys.begin(), edgeKeys.end());
+        edgeKeys.erase(std::unique(edgeKeys.begin(), edgeKeys.end()), edgeKeys.end());
+        outCage.structuralPairs.reserve(edgeKeys.size());
+        for (uint64_t key : edgeKeys)
+        {
+            unsigned int a = (unsigned int)(key >> 32), b = (unsigned int)(key & 0xffffffffu);
+            outCage.structuralPairs.push_back({{a, b}, glm::distance(outCage.vertices[a], outCage.vertices[b])});
+        }
+
+        outCage.velocities = std::vector<glm::vec3>(outCage.vertices.size(), glm::vec3(0.0f));
+        glm::vec3 xcm0(0.0f);
+        for (auto &p : outCage.vertices)
+        {
+            xcm0 += p;
+        }
+        outCage.x_cm_zero = xcm0 / (float)outCage.vertices.size();
+        outCage.x_offset_zero = outCage.vertices;
+        for (auto &p : outCage.x_offset_zero)
+        {
+            p -= outCage.x_cm_zero;
+        }
+
+        // trilinear weights of every render vertex inside its cell
+        outEmbedding.renderVertexCount = mesh.vertices.size();
+        outEmbedding.nodes.resize(mesh.vertices.size() * 8);
+        outEmbedding.weights.resize(mesh.vertices.size() * 8);
+#pragma omp parallel for
+        for (int i = 0; i < (int)mesh.vertices.size(); i++)
+        {
+            glm::vec3 local = (mesh.vertices[i] - origin) / cell_size;
+            glm::ivec3 c = toCell(mesh.vertices[i]);
+            glm::vec3 t = glm::clamp(local - glm::vec3(c), 0.0f, 1.0f);
+            for (int k = 0; k < 8; k++)
+            {
+                int cx = c.x + (k & 1), cy = c.y + ((k >> 1) & 1), cz = c.z + ((k >> 2) & 1);
+                float w = ((k & 1) ? t.x : 1.0f - t.x) *
+                          (((k >> 1) & 1) ? t.y : 1.0f - t.y) *
+                          (((k >> 2) & 1) ? t.z : 1.0f - t.z);
+                int id = nodeId[nodeIndex(cx, cy, cz)];
+                outEmbedding.nodes[i * 8 + k] = id < 0 ? 0u : (unsigned int)id;
+                outEmbedding.weights[i * 8 + k] = id < 0 ? 0.0f : w;
+            }
+        }
+
+        std::cout << "Lattice cage: " << outCage.vertices.size() << " nodes / " << outCage.structuralPairs.size()
+                  << " springs for " << mesh.vertices.size() << " render vertices\n";
+        return true;
+    }
+
+    /**
+     * Rebuild embedded values (positions or velocities) from cage values
+     * - cage - values of the cage nodes
+     * - out - render values, size of embedding.renderVertexCount
+     */
+    static void reconstruct(const LatticeEmbedding &embedding, const glm::vec3 *cage, glm::vec3 *out)
+    {
+        const unsigned int *nodes = embedding.nodes.data();
+        const float *weights = embedding.weights.data();
+
+#pragma omp parallel for simd
+        for (int i = 0; i < (int)embedding.renderVertexCount; i++)
+        {
+            const unsigned int *n = nodes + (size_t)i * 8;
+            const float *w = weights + (size_t)i * 8;
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            for (int k = 0; k < 8; k++)
+            {
+                const glm::vec3 &p = cage[n[k]];
+                x += w[k] * p.x;
+                y += w[k] * p.y;
+                z += w[k] * p.z;
+            }
+            out[i] = glm::vec3(x, y, z);
+        }
+    }
+
+private:
+    static uint64_t packEdge(unsigned int a, unsigned int b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return ((uint64_t)a << 32) | (uint64_t)b;
+    }
+};
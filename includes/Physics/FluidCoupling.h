@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <omp.h>
+
+#include <Physics/SPHSolver.h>
+#include <Physics/SoftBodyWorld.h>
+
+/**
+ * Two way coupling between the SPH fluid and the soft bodies
+ * - every soft body vertex enters the fluid as an Akinci boundary particle, inserted into the fluid spatial lookup,
+ *   so one neighbor search per step gives the boundary volumes, the fluid density / pressure and the reaction on the bodies
+ * - the fluid is stepped first, the force it put on each vertex is applied as an impulse, then the bodies are stepped
+ * - a body the fluid pushes hard enough is woken up, sleeping bodies still displace the fluid
+ */
+class FluidCoupling
+{
+public:
+    //=======[adjustable parameters]========
+    bool ENABLED = true;
+    float VERTEX_MASS = 0.02f; // mass of a soft body vertex, SPHSolver::MASS makes a vertex as heavy as a fluid particle
+    int BODY_SUBSTEPS = 1;     // soft body steps per fluid step, explicit springs need several
+    //======================================
+
+    // stats of last step
+    double lastFluidMs = 0.0;
+    double lastBodyMs = 0.0;
+    float lastMaxForce = 0.0f; // largest fluid force on one vertex
+
+    /**
+     * Advance fluid and bodies by deltaTime
+     * - boxMin, boxMax - bounding box of the fluid, the bodies keep their own
+     */
+    void step(SPHSolver &fluid, SoftBodyWorld &world, float deltaTime, glm::vec3 boxMin, glm::vec3 boxMax)
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        if (ENABLED)
+            fluid.setBoundary(world.positions.data(), world.velocities.data(), world.positions.size());
+        else
+            fluid.clearBoundary();
+        fluid.solver_step(deltaTime, boxMin, boxMax);
+        auto fluid_time = std::chrono::high_resolution_clock::now();
+
+        lastMaxForce = 0.0f;
+        if (ENABLED && fluid.boundary_forces.size() == world.positions.size())
+        {
+            applyForces(fluid.boundary_forces, world, deltaTime);
+        }
+
+        int substeps = std::max(BODY_SUBSTEPS, 1);
+        for (int s = 0; s < substeps; s++)
+        {
+            world.step(deltaTime / (float)substeps);
+        }
+        auto end_time = std::chrono::high_resolution_clock::now();
+        lastFluidMs = std::chrono::duration<double, std::milli>(fluid_time - start_time).count();
+        lastBodyMs = std::chrono::duration<double, std::milli>(end_time - fluid_time).count();
+    }
+
+private:
+    std::vector<uint8_t> pushed; // per body, a vertex got an impulse above the sleep threshold
+
+    void applyForces(const std::vector<glm::vec3> &forces, SoftBodyWorld &world, float deltaTime)
+    {
+        // an impulse with more kinetic energy than a calm vertex wakes the body
+        float wakeSq = 2.0f * world.SLEEP_ENERGY;
+        float scale = deltaTime / VERTEX_MASS;
+        long long n = (long long)forces.size();
+        pushed.assign(world.bodies.size(), 0);
+        float maxForceSq = 0.0f;
+#pragma omp parallel for reduction(max : maxForceSq)
+        for (long long i = 0; i < n; i++)
+        {
+            float forceSq = glm::dot(forces[i], forces[i]);
+            maxForceSq = std::max(maxForceSq, forceSq);
+            if (forceSq * scale * scale > wakeSq)
+            {
+                uint8_t &flag = pushed[world.vertexBody[i]];
+#pragma omp atomic write
+                flag = 1;
+            }
+        }
+        lastMaxForce = std::sqrt(maxForceSq);
+        for (size_t b = 0; b < world.bodies.size(); b++)
+        {
+            if (pushed[b] && world.isAsleep(b))
+                world.wake(b);
+        }
+
+        // sleeping bodies are not integrated, an impulse would pile up until they wake
+#pragma omp parallel for
+        for (long long i = 0; i < n; i++)
+        {
+            if (!world.bodyAsleep[world.vertexBody[i]])
+                world.velocities[i] += forces[i] * scale;
+        }
+    }
+};
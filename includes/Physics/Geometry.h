@@ -0,0 +1,91 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// closest point queries shared by the collision code
+class Geometry
+{
+public:
+    // Ericson, Real-Time Collision Detection 5.1.5
+    static glm::vec3 closestPointOnTriangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, glm::vec3 &bary)
+    {
+        glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+        {
+            bary = glm::vec3(1.0f, 0.0f, 0.0f);
+            return a;
+        }
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+        {
+            bary = glm::vec3(0.0f, 1.0f, 0.0f);
+            return b;
+        }
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        {
+            float w = d1 / (d1 - d3);
+            bary = glm::vec3(1.0f - w, w, 0.0f);
+            return a + w * ab;
+        }
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+        {
+            bary = glm::vec3(0.0f, 0.0f, 1.0f);
+            return c;
+        }
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        {
+            float w = d2 / (d2 - d6);
+            bary = glm::vec3(1.0f - w, 0.0f, w);
+            return a + w * ac;
+        }
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        {
+            float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            bary = glm::vec3(0.0f, 1.0f - w, w);
+            return b + w * (c - b);
+        }
+        float denom = 1.0f / (va + vb + vc);
+        float v = vb * denom, w = vc * denom;
+        bary = glm::vec3(1.0f - v - w, v, w);
+        return a + ab * v + ac * w;
+    }
+
+    // Ericson 5.1.9, s along p0p1 and u along q0q1
+    static void closestPointsOnSegments(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &q0, const glm::vec3 &q1,
+                                        float &s, float &u, glm::vec3 &c0, glm::vec3 &c1)
+    {
+        glm::vec3 d1 = p1 - p0, d2 = q1 - q0, r = p0 - q0;
+        float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+        float c = glm::dot(d1, r), b = glm::dot(d1, d2);
+        float denom = a * e - b * b;
+        if (a <= 1e-12f || e <= 1e-12f)
+        {
+            // degenerate edge, treated as no edge contact
+            s = u = 0.0f;
+            c0 = p0;
+            c1 = q0;
+            return;
+        }
+        s = denom > 1e-12f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+        u = (b * s + f) / e;
+        if (u < 0.0f)
+        {
+            u = 0.0f;
+            s = glm::clamp(-c / a, 0.0f, 1.0f);
+        }
+        else if (u > 1.0f)
+        {
+            u = 1.0f;
+            s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+        }
+        c0 = p0 + d1 * s;
+        c1 = q0 + d2 * u;
+    }
+};
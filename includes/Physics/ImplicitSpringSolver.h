@@ -0,0 +1,195 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <Eigen/Sparse>
+#include <Eigen/IterativeLinearSolvers>
+
+#include <objectloader.h>
+
+/**
+ * Backward Euler for a spring network (Baraff & Witkin)
+ *   (I - h*D - h^2*K) dv = h * (f0 + h*K*v0)
+ * - K, D are the spring force jacobians w.r.t. position and velocity (unit mass)
+ * - solved with Jacobi preconditioned CG, warm started from last step's dv
+ * - sparsity pattern is built once, values are rewritten in place every step
+ */
+class ImplicitSpringSolver
+{
+public:
+    typedef Eigen::SparseMatrix<double> SpMat;
+
+    //=======[adjustable parameters]========
+    double CG_TOLERANCE = 1e-4;
+    int CG_MAX_ITERATIONS = 200;
+    //======================================
+
+    // stats of last solve
+    int lastIterations = 0;
+    double lastError = 0.0;
+
+    /**
+     * Advance velocities of one body by an implicit spring step
+     * - x, v - body positions/velocities (n vertices), v is updated in place
+     * - c - structural constraints with body local indices
+     */
+    void solve(const glm::vec3 *x, glm::vec3 *v, size_t n, const Constraint *c, size_t constraintCount,
+               float h, float stiffness, float damping)
+    {
+        if (n == 0)
+            return;
+        if (n != vertexCount || constraintCount != springCount)
+        {
+            buildPattern(n, c, constraintCount);
+        }
+
+        double *values = A.valuePtr();
+        std::fill(values, values + A.nonZeros(), 0.0);
+        rhs.setZero();
+
+        for (size_t i = 0; i < n; i++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                values[diagOffsets[i * 3 + col] + col] += 1.0;
+            }
+        }
+
+        for (size_t k = 0; k < constraintCount; k++)
+        {
+            unsigned int a = c[k].pair.first, b = c[k].pair.second;
+            glm::vec3 d = x[b] - x[a];
+            float len = glm::length(d);
+            if (len < 1e-6f)
+                continue;
+            glm::vec3 dir = d / len;
+            glm::vec3 dv = v[b] - v[a];
+
+            // force acting on 'a' (same as the explicit solver), 'b' gets the opposite
+            glm::vec3 f = dir * (stiffness * (len - c[k].distance) + damping * glm::dot(dir, dv));
+
+            // K_ab = k * (dd^T + max(0, 1 - L/l) * (I - dd^T)), clamped to stay definite under compression
+            // D_ab = kd * dd^T
+            double stretch = std::max(0.0, 1.0 - (double)c[k].distance / (double)len);
+            double Kab[3][3], B[3][3];
+            for (int r = 0; r < 3; r++)
+            {
+                for (int col = 0; col < 3; col++)
+                {
+                    double dd = (double)dir[r] * (double)dir[col];
+                    double id = (r == col) ? 1.0 : 0.0;
+                    Kab[r][col] = stiffness * (dd + stretch * (id - dd));
+                    B[r][col] = h * damping * dd + (double)h * h * Kab[r][col];
+                }
+            }
+
+            for (int r = 0; r < 3; r++)
+            {
+                // K*v0 restricted to this spring: (Kv)_a = K_ab (v_b - v_a)
+                double Kv = Kab[r][0] * dv.x + Kab[r][1] * dv.y + Kab[r][2] * dv.z;
+                rhs[a * 3 + r] += h * (f[r] + h * Kv);
+                rhs[b * 3 + r] -= h * (f[r] + h * Kv);
+            }
+
+            const int *off = &springOffsets[k * 12];
+            for (int col = 0; col < 3; col++)
+            {
+                for (int r = 0; r < 3; r++)
+                {
+                    values[off[col] + r] = -B[r][col];     // (a,b)
+                    values[off[3 + col] + r] = -B[r][col]; // (b,a)
+                    values[diagOffsets[a * 3 + col] + r] += B[r][col];
+                    values[diagOffsets[b * 3 + col] + r] += B[r][col];
+                }
+            }
+        }
+
+        cg.setTolerance(CG_TOLERANCE);
+        cg.setMaxIterations(CG_MAX_ITERATIONS);
+        cg.factorize(A); // only refreshes the jacobi diagonal
+        deltaV = cg.solveWithGuess(rhs, deltaV);
+        lastIterations = (int)cg.iterations();
+        lastError = cg.error();
+
+        for (size_t i = 0; i < n; i++)
+        {
+            v[i] += glm::vec3((float)deltaV[i * 3], (float)deltaV[i * 3 + 1], (float)deltaV[i * 3 + 2]);
+        }
+    }
+
+private:
+    SpMat A;
+    Eigen::VectorXd rhs, deltaV;
+    Eigen::ConjugateGradient<SpMat, Eigen::Lower | Eigen::Upper, Eigen::DiagonalPreconditioner<double>> cg;
+
+    size_t vertexCount = 0;
+    size_t springCount = 0;
+    std::vector<int> diagOffsets;   // value index of (3i, 3i+col) per vertex and column
+    std::vector<int> springOffsets; // value index of (3a, 3b+col) then (3b, 3a+col) per spring
+
+    void buildPattern(size_t n, const Constraint *c, size_t constraintCount)
+    {
+        vertexCount = n;
+        springCount = constraintCount;
+
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve(n * 9 + constraintCount * 18);
+        for (size_t i = 0; i < n; i++)
+        {
+            addBlock(triplets, i, i);
+        }
+        for (size_t k = 0; k < constraintCount; k++)
+        {
+            addBlock(triplets, c[k].pair.first, c[k].pair.second);
+            addBlock(triplets, c[k].pair.second, c[k].pair.first);
+        }
+
+        A = SpMat((Eigen::Index)n * 3, (Eigen::Index)n * 3);
+        A.setFromTriplets(triplets.begin(), triplets.end());
+        A.makeCompressed();
+        cg.analyzePattern(A);
+
+        diagOffsets.resize(n * 3);
+        for (size_t i = 0; i < n; i++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                diagOffsets[i * 3 + col] = valueIndex(i * 3, i * 3 + col);
+            }
+        }
+        springOffsets.resize(constraintCount * 12);
+        for (size_t k = 0; k < constraintCount; k++)
+        {
+            size_t a = c[k].pair.first, b = c[k].pair.second;
+            for (int col = 0; col < 3; col++)
+            {
+                springOffsets[k * 12 + col] = valueIndex(a * 3, b * 3 + col);
+                springOffsets[k * 12 + 3 + col] = valueIndex(b * 3, a * 3 + col);
+            }
+        }
+
+        rhs = Eigen::VectorXd::Zero((Eigen::Index)n * 3);
+        deltaV = Eigen::VectorXd::Zero((Eigen::Index)n * 3);
+    }
+
+    static void addBlock(std::vector<Eigen::Triplet<double>> &triplets, size_t bi, size_t bj)
+    {
+        for (int r = 0; r < 3; r++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                triplets.emplace_back((int)(bi * 3 + r), (int)(bj * 3 + col), 0.0);
+            }
+        }
+    }
+
+    // position of (row, col) in valuePtr, rows of a 3x3 block are contiguous in a column
+    int valueIndex(size_t row, size_t col) const
+    {
+        const int *inner = A.innerIndexPtr();
+        const int *begin = inner + A.outerIndexPtr()[col];
+        const int *end = inner + A.outerIndexPtr()[col + 1];
+        return (int)(std::lower_bound(begin, end, (int)row) - inner);
+    }
+};
@@ -9,6 +9,8 @@
 #include <Graphic/GUIManager.h>
 #include <Physics/PhysicsObject.h>
 #include <Physics/SPHsolver.h>
+#include <Physics/FluidCoupling.h>
+#include <trajectory.h>
 
 class PhysicsEngine
 {
@@ -20,7 +22,11 @@ public:
     std::vector<glm::vec3> *instanceBuffer;
     std::vector<glm::vec4> *colorBuffer;
 
-    SPHSolver *sph_solver;
+    SPHSolver *sph_solver = nullptr;
+    SoftBodyWorld *softBodyWorld = nullptr; // bodies floating in the fluid, not owned, attach before binding the graphic engine
+    FluidCoupling coupling;
+    TrajectoryWriter recorder; // every update goes to the recording while it is open
+    double sim_time = 0.0;
 
     glm::vec3 boxPosition, boxMin, boxMax;
     int instance_id_counter = 0;
@@ -52,7 +58,7 @@ public:
     /*
      *  called for each engine time step,
      *  do these in order
-     *  - compute particles force using SPH
+     *  - compute particles force using SPH (with the soft bodies as boundary when attached)
      *  - check & resolve bounding box collision
      *  - update force,velocity,position (also in graphic buffer)
      *
@@ -66,7 +72,13 @@ public:
         if (sph_solver != nullptr)
         {
             // sph_solver->solver_step(1.0f/240.0f, this->boxMin, this->boxMax);
+            if (softBodyWorld != nullptr)
+                coupling.step(*sph_solver, *softBodyWorld, 1.0f / 240.0f, this->boxMin, this->boxMax);
         }
+        sim_time += 1.0 / 240.0;
+
+        if (recorder.isOpen())
+            recorder.record(sim_time, sph_solver, softBodyWorld);
     };
 
     //  add PhysicObject to the class "objectList"
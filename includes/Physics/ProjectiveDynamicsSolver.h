@@ -0,0 +1,210 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <omp.h>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+
+#include <objectloader.h>
+#include <Physics/ShapeMatching.h>
+
+/**
+ * Projective Dynamics (Bouaziz et al. 2014) for fixed topology bodies
+ * - local step: project every constraint on its own (parallel)
+ *     edge springs / bend pairs -> rest length along current direction
+ *     shape matching -> rotated rest shape (one rotation per body)
+ * - global step: (M/h^2 + sum w A^T A) x = M/h^2 s + J p
+ *     the matrix only depends on topology, weights and h so it is factored once (LDLT)
+ *     and every iteration is a back substitution
+ * - optional Chebyshev acceleration (Wang 2015)
+ */
+class ProjectiveDynamicsSolver
+{
+public:
+    typedef Eigen::SparseMatrix<double> SpMat;
+    typedef Eigen::SparseMatrix<double, Eigen::RowMajor> SpMatRow;
+
+    //=======[adjustable parameters]========
+    double SPRING_WEIGHT = 1.0;  // stiffness of edge springs
+    double BEND_WEIGHT = 0.5;    // stiffness of bend pairs
+    double SHAPE_WEIGHT = 25.0;  // pull towards the shape matched rest pose
+    int ITERATIONS = 10;         // local/global iterations per step
+    bool USE_CHEBYSHEV = true;
+    double CHEBYSHEV_RHO = 0.9;  // estimated spectral radius, lower it if the body jitters
+    //======================================
+
+    // stats of last solve
+    int lastIterations = 0;
+
+    bool isFactored() const
+    {
+        return factored;
+    }
+
+    /**
+     * Build and factor the global matrix, done once at load time
+     * (and again only if h, weights or topology change)
+     */
+    void prefactor(size_t n, const Constraint *springs, size_t springCount, const Constraint *bends, size_t bendCount, float h)
+    {
+        vertexCount = n;
+        factoredStep = h;
+        factoredWeights = glm::dvec3(SPRING_WEIGHT, BEND_WEIGHT, SHAPE_WEIGHT);
+
+        // springs and bend pairs are the same kind of constraint, only the weight differs
+        size_t m = springCount + bendCount;
+        ends.resize(m * 2);
+        rest.resize(m);
+        weight.resize(m);
+        for (size_t k = 0; k < m; k++)
+        {
+            const Constraint &c = k < springCount ? springs[k] : bends[k - springCount];
+            ends[k * 2] = c.pair.first;
+            ends[k * 2 + 1] = c.pair.second;
+            rest[k] = c.distance;
+            weight[k] = k < springCount ? SPRING_WEIGHT : BEND_WEIGHT;
+        }
+
+        double inertia = 1.0 / ((double)h * h); // unit mass
+        std::vector<Eigen::Triplet<double>> systemTriplets;
+        std::vector<Eigen::Triplet<double>> projectionTriplets;
+        systemTriplets.reserve(n + m * 4);
+        projectionTriplets.reserve(m * 2);
+        for (size_t i = 0; i < n; i++)
+        {
+            systemTriplets.emplace_back((int)i, (int)i, inertia + SHAPE_WEIGHT);
+        }
+        for (size_t k = 0; k < m; k++)
+        {
+            int a = (int)ends[k * 2], b = (int)ends[k * 2 + 1];
+            double w = weight[k];
+            // w * (e_b - e_a)(e_b - e_a)^T
+            systemTriplets.emplace_back(a, a, w);
+            systemTriplets.emplace_back(b, b, w);
+            systemTriplets.emplace_back(a, b, -w);
+            systemTriplets.emplace_back(b, a, -w);
+            // w * (e_b - e_a) * p_k
+            projectionTriplets.emplace_back(b, (int)k, w);
+            projectionTriplets.emplace_back(a, (int)k, -w);
+        }
+
+        SpMat system((Eigen::Index)n, (Eigen::Index)n);
+        system.setFromTriplets(systemTriplets.begin(), systemTriplets.end());
+        ldlt.compute(system);
+        factored = (ldlt.info() == Eigen::Success);
+        if (!factored)
+        {
+            std::cerr << "Error: Projective Dynamics system could not be factored\n";
+        }
+
+        projection = SpMatRow((Eigen::Index)n, (Eigen::Index)m);
+        projection.setFromTriplets(projectionTriplets.begin(), projectionTriplets.end());
+
+        P.resize((Eigen::Index)m, 3);
+        inertial.resize((Eigen::Index)n, 3);
+        rhs.resize((Eigen::Index)n, 3);
+        current.resize((Eigen::Index)n, 3);
+        previous.resize((Eigen::Index)n, 3);
+        next.resize((Eigen::Index)n, 3);
+    }
+
+    /**
+     * Advance one body by h, positions and velocities are updated in place
+     * - q - rest offsets from center of mass (shape matching)
+     * - acceleration - external acceleration (gravity)
+     * - parallel - split the local step across threads, pass false when already inside a parallel region
+     */
+    void solve(glm::vec3 *x, glm::vec3 *v, const glm::vec3 *q, size_t n,
+               const Constraint *springs, size_t springCount, const Constraint *bends, size_t bendCount,
+               float h, glm::vec3 acceleration, bool parallel = true)
+    {
+        if (n == 0)
+            return;
+        if (!factored || n != vertexCount || h != factoredStep || (size_t)rest.size() != springCount + bendCount ||
+            factoredWeights != glm::dvec3(SPRING_WEIGHT, BEND_WEIGHT, SHAPE_WEIGHT))
+        {
+            prefactor(n, springs, springCount, bends, bendCount, h);
+            if (!factored)
+                return;
+        }
+
+        double inertia = 1.0 / ((double)h * h);
+        for (size_t i = 0; i < n; i++)
+        {
+            glm::vec3 s = x[i] + h * v[i] + (h * h) * acceleration;
+            inertial.row((Eigen::Index)i) << s.x, s.y, s.z;
+        }
+        current = inertial;
+        previous = current;
+
+        int m = (int)rest.size();
+        double omega = 1.0;
+        for (int it = 0; it < ITERATIONS; it++)
+        {
+            //===========[local step]===========
+#pragma omp parallel for if (parallel)
+            for (int k = 0; k < m; k++)
+            {
+                Eigen::RowVector3d d = current.row(ends[k * 2 + 1]) - current.row(ends[k * 2]);
+                double len = d.norm();
+                P.row(k) = len > 1e-9 ? (d * (rest[k] / len)).eval() : d;
+            }
+
+            Eigen::RowVector3d cm = current.colwise().mean();
+            Eigen::Matrix3d apq = Eigen::Matrix3d::Zero();
+            for (size_t i = 0; i < n; i++)
+            {
+                Eigen::Vector3d p = (current.row((Eigen::Index)i) - cm).transpose();
+                apq += p * Eigen::RowVector3d(q[i].x, q[i].y, q[i].z);
+            }
+            Eigen::Matrix3d R = ShapeMatching::polarRotation(apq);
+
+            //===========[global step]===========
+            rhs.noalias() = projection * P;
+#pragma omp parallel for if (parallel)
+            for (int i = 0; i < (int)n; i++)
+            {
+                Eigen::RowVector3d goal = (R * Eigen::Vector3d(q[i].x, q[i].y, q[i].z)).transpose() + cm;
+                rhs.row(i) += inertia * inertial.row(i) + SHAPE_WEIGHT * goal;
+            }
+            next = ldlt.solve(rhs);
+
+            if (USE_CHEBYSHEV)
+            {
+                if (it == 0)
+                    omega = 1.0;
+                else if (it == 1)
+                    omega = 2.0 / (2.0 - CHEBYSHEV_RHO * CHEBYSHEV_RHO);
+                else
+                    omega = 4.0 / (4.0 - CHEBYSHEV_RHO * CHEBYSHEV_RHO * omega);
+                next = omega * (next - previous) + previous;
+            }
+            previous.swap(current);
+            current.swap(next);
+        }
+        lastIterations = ITERATIONS;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            glm::vec3 x_new((float)current((Eigen::Index)i, 0), (float)current((Eigen::Index)i, 1), (float)current((Eigen::Index)i, 2));
+            v[i] = (x_new - x[i]) / h;
+            x[i] = x_new;
+        }
+    }
+
+private:
+    Eigen::SimplicialLDLT<SpMat> ldlt;
+    SpMatRow projection; // n x m, maps constraint projections to the right hand side
+    Eigen::MatrixX3d P, inertial, rhs, current, previous, next;
+
+    std::vector<unsigned int> ends; // constraint end points (a, b)
+    std::vector<double> rest;
+    std::vector<double> weight;
+
+    bool factored = false;
+    size_t vertexCount = 0;
+    float factoredStep = 0.0f;
+    glm::dvec3 factoredWeights;
+};
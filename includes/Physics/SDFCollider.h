@@ -0,0 +1,446 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <cfloat>
+#include <omp.h>
+
+#include <objectloader.h>
+#include <Physics/BVH.h>
+#include <Physics/Geometry.h>
+
+/**
+ * Static collider baked from a triangle mesh into a sparse narrow band signed distance grid
+ * - the grid is split into bricks of BRICK^3 cells, only bricks within the band of a triangle store distances
+ * - a brick stores (BRICK + 1)^3 nodes so the 8 corners of every cell are inside one brick
+ * - other bricks only keep their sign (far outside / far inside) in the coarse table
+ * - distances are clamped to +-band, negative inside
+ * - sign from angle weighted pseudonormals (face, edge or vertex of the closest point), meshes should be closed
+ *   or at least consistently oriented, an open plane treats the side its normals point away from as inside
+ */
+class SDFCollider
+{
+public:
+    static constexpr int BRICK = 8;
+    static constexpr int BRICK_NODES = BRICK + 1;
+
+    // stats of the last bake
+    double lastBakeMs = 0.0;
+    int activeBricks = 0;
+    int totalBricks = 0;
+
+    bool empty() const
+    {
+        return brickIndex.empty();
+    }
+
+    /**
+     * Bake the distance grid of a triangle mesh
+     * - vertices, meshTriangles - indexed triangle list
+     * - voxelSize - distance between grid nodes
+     * - bandVoxels - half width of the stored band in voxels, distances outside are clamped
+     */
+    void bake(const std::vector<glm::vec3> &vertices, const std::vector<unsigned int> &meshTriangles, float voxelSize, int bandVoxels = 3)
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        voxel = voxelSize;
+        band = voxelSize * (float)std::max(bandVoxels, 1);
+        brickIndex.clear();
+        values.clear();
+        activeBricks = totalBricks = 0;
+
+        // (nearly) zero area triangles have no normal to sign with, and every point of one lies on the edges of its neighbors
+        std::vector<unsigned int> triangles;
+        triangles.reserve(meshTriangles.size());
+        for (size_t t = 0; t + 2 < meshTriangles.size(); t += 3)
+        {
+            const unsigned int *tri = &meshTriangles[t];
+            glm::vec3 e0 = vertices[tri[1]] - vertices[tri[0]], e1 = vertices[tri[2]] - vertices[tri[0]], e2 = e1 - e0;
+            float longest_sq = std::max(glm::dot(e0, e0), std::max(glm::dot(e1, e1), glm::dot(e2, e2)));
+            float cross = glm::length(glm::cross(e0, e1));
+            if (cross > 0.0f && cross >= MIN_SINE * longest_sq)
+                triangles.insert(triangles.end(), tri, tri + 3);
+        }
+        size_t triCount = triangles.size() / 3;
+        if (triCount == 0)
+            return;
+
+        // grid covers the mesh plus the band, rounded up to whole bricks
+        AABB bounds;
+        for (const glm::vec3 &p : vertices)
+        {
+            bounds.grow(p);
+        }
+        bounds.inflate(band + voxel);
+        origin = bounds.lo;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int cells = (int)std::ceil((bounds.hi[axis] - bounds.lo[axis]) / voxel);
+            bricks[axis] = std::max((cells + BRICK - 1) / BRICK, 1);
+            cellCount[axis] = bricks[axis] * BRICK;
+        }
+        totalBricks = bricks.x * bricks.y * bricks.z;
+
+        buildPseudonormals(vertices, triangles);
+        std::vector<AABB> boxes(triCount);
+        for (size_t t = 0; t < triCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                boxes[t].grow(vertices[triangles[t * 3 + k]]);
+            }
+        }
+        BVH tree;
+        tree.build(boxes);
+
+        // bricks touched by the band of a triangle store distances
+        brickIndex.assign(totalBricks, FAR_OUTSIDE);
+        float brickSize = voxel * BRICK;
+        for (size_t t = 0; t < triCount; t++)
+        {
+            AABB box = boxes[t];
+            box.inflate(band);
+            glm::ivec3 lo = glm::clamp(glm::ivec3(glm::floor((box.lo - origin) / brickSize)), glm::ivec3(0), bricks - 1);
+            glm::ivec3 hi = glm::clamp(glm::ivec3(glm::floor((box.hi - origin) / brickSize)), glm::ivec3(0), bricks - 1);
+            for (int z = lo.z; z <= hi.z; z++)
+                for (int y = lo.y; y <= hi.y; y++)
+                    for (int x = lo.x; x <= hi.x; x++)
+                    {
+                        brickIndex[brickOf(x, y, z)] = ACTIVE;
+                    }
+        }
+        std::vector<int> active;
+        for (int b = 0; b < totalBricks; b++)
+        {
+            if (brickIndex[b] == ACTIVE)
+            {
+                brickIndex[b] = (int)active.size();
+                active.push_back(b);
+            }
+        }
+        activeBricks = (int)active.size();
+        values.resize((size_t)activeBricks * BRICK_NODES * BRICK_NODES * BRICK_NODES);
+
+        const int nodesPerBrick = BRICK_NODES * BRICK_NODES * BRICK_NODES;
+#pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < activeBricks; k++)
+        {
+            glm::ivec3 base = brickCoord(active[k]) * BRICK;
+            float *out = &values[(size_t)k * nodesPerBrick];
+            std::vector<int> queue;
+            for (int n = 0; n < nodesPerBrick; n++)
+            {
+                glm::vec3 p = origin + glm::vec3(base + nodeCoord(n)) * voxel;
+                out[n] = signedDistance(tree, vertices, triangles, p, band * band);
+                if (out[n] != UNRESOLVED)
+                {
+                    out[n] = glm::clamp(out[n], -band, band);
+                    queue.push_back(n);
+                }
+            }
+            if (queue.empty())
+            {
+                out[0] = signedDistance(tree, vertices, triangles, origin + glm::vec3(base) * voxel) < 0.0f ? -band : band;
+                queue.push_back(0);
+            }
+
+            // a node outside the band is more than a voxel from the surface, so it has the sign of its neighbors
+            for (size_t head = 0; head < queue.size(); head++)
+            {
+                int n = queue[head];
+                glm::ivec3 c = nodeCoord(n);
+                const int step[3] = {1, BRICK_NODES, BRICK_NODES * BRICK_NODES};
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    for (int dir = -1; dir <= 1; dir += 2)
+                    {
+                        int to = c[axis] + dir;
+                        if (to < 0 || to >= BRICK_NODES)
+                            continue;
+                        int m = n + dir * step[axis];
+                        if (out[m] != UNRESOLVED)
+                            continue;
+                        out[m] = out[n] < 0.0f ? -band : band;
+                        queue.push_back(m);
+                    }
+                }
+            }
+        }
+
+        // the sign of a far brick is the sign of its center
+#pragma omp parallel for schedule(dynamic)
+        for (int b = 0; b < totalBricks; b++)
+        {
+            if (brickIndex[b] >= 0)
+                continue;
+            glm::vec3 center = origin + (glm::vec3(brickCoord(b)) + 0.5f) * brickSize;
+            brickIndex[b] = signedDistance(tree, vertices, triangles, center) < 0.0f ? FAR_INSIDE : FAR_OUTSIDE;
+        }
+
+        faceNormals.clear();
+        vertexNormals.clear();
+        edgeNormals.clear();
+        lastBakeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+    }
+
+    // bake the surface of a loaded mesh, faces hold (v, vn, vt) per corner
+    void bake(const SoftBodyMesh &mesh, float voxelSize, int bandVoxels = 3)
+    {
+        std::vector<unsigned int> triangles(mesh.faces.size() / 3);
+        for (size_t c = 0; c < triangles.size(); c++)
+        {
+            triangles[c] = mesh.faces[c * 3];
+        }
+        bake(mesh.vertices, triangles, voxelSize, bandVoxels);
+    }
+
+    float sample(const glm::vec3 &p) const
+    {
+        glm::vec3 gradient;
+        return sample(p, gradient);
+    }
+
+    /**
+     * Trilinear distance at p and its analytic gradient (not normalized)
+     * - outside the grid the distance is +band, in far bricks +-band, both with zero gradient
+     */
+    float sample(const glm::vec3 &p, glm::vec3 &gradient) const
+    {
+        gradient = glm::vec3(0.0f);
+        if (brickIndex.empty())
+            return band;
+        glm::vec3 local = (p - origin) / voxel;
+        glm::vec3 cellf = glm::floor(local);
+        if (cellf.x < 0.0f || cellf.y < 0.0f || cellf.z < 0.0f ||
+            cellf.x >= (float)cellCount.x || cellf.y >= (float)cellCount.y || cellf.z >= (float)cellCount.z)
+            return band;
+        glm::ivec3 cell = glm::ivec3(cellf);
+        glm::ivec3 brick = cell / BRICK;
+        int index = brickIndex[brickOf(brick.x, brick.y, brick.z)];
+        if (index < 0)
+            return index == FAR_INSIDE ? -band : band;
+
+        glm::ivec3 c = cell - brick * BRICK;
+        const float *node = &values[(size_t)index * BRICK_NODES * BRICK_NODES * BRICK_NODES +
+                                    c.x + BRICK_NODES * (c.y + BRICK_NODES * c.z)];
+        const int dy = BRICK_NODES, dz = BRICK_NODES * BRICK_NODES;
+        float v000 = node[0], v100 = node[1], v010 = node[dy], v110 = node[dy + 1];
+        float v001 = node[dz], v101 = node[dz + 1], v011 = node[dz + dy], v111 = node[dz + dy + 1];
+
+        glm::vec3 t = local - cellf;
+        float x00 = v000 + (v100 - v000) * t.x, x10 = v010 + (v110 - v010) * t.x;
+        float x01 = v001 + (v101 - v001) * t.x, x11 = v011 + (v111 - v011) * t.x;
+        float y0 = x00 + (x10 - x00) * t.y, y1 = x01 + (x11 - x01) * t.y;
+
+        float dx0 = (v100 - v000) + ((v110 - v010) - (v100 - v000)) * t.y;
+        float dx1 = (v101 - v001) + ((v111 - v011) - (v101 - v001)) * t.y;
+        gradient.x = (dx0 + (dx1 - dx0) * t.z) / voxel;
+        gradient.y = ((x10 - x00) + ((x11 - x01) - (x10 - x00)) * t.z) / voxel;
+        gradient.z = (y1 - y0) / voxel;
+        return y0 + (y1 - y0) * t.z;
+    }
+
+private:
+    static constexpr int ACTIVE = -3; // marked during a bake, replaced by the slot
+    static constexpr int FAR_OUTSIDE = -1;
+    static constexpr int FAR_INSIDE = -2;
+    static constexpr float UNRESOLVED = FLT_MAX;
+    static constexpr float MIN_SINE = 1e-5f; // triangles with |e0 x e1| under this times the longest edge squared are dropped
+
+    float voxel = 1.0f;
+    float band = 1.0f;
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::ivec3 bricks = glm::ivec3(0);
+    glm::ivec3 cellCount = glm::ivec3(0);
+    std::vector<int> brickIndex; // active brick slot, or FAR_OUTSIDE / FAR_INSIDE
+    std::vector<float> values;   // BRICK_NODES^3 distances per active brick, x fastest
+
+    // pseudonormals, only alive during a bake
+    std::vector<glm::vec3> faceNormals;
+    std::vector<glm::vec3> vertexNormals;
+    std::unordered_map<uint64_t, glm::vec3> edgeNormals;
+
+    int brickOf(int x, int y, int z) const
+    {
+        return x + bricks.x * (y + bricks.y * z);
+    }
+
+    glm::ivec3 brickCoord(int b) const
+    {
+        return glm::ivec3(b % bricks.x, (b / bricks.x) % bricks.y, b / (bricks.x * bricks.y));
+    }
+
+    static uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+    // Baerentzen & Aanaes, angle weighted pseudonormals
+    void buildPseudonormals(const std::vector<glm::vec3> &vertices, const std::vector<unsigned int> &triangles)
+    {
+        size_t triCount = triangles.size() / 3;
+        faceNormals.assign(triCount, glm::vec3(0.0f));
+        vertexNormals.assign(vertices.size(), glm::vec3(0.0f));
+        edgeNormals.clear();
+        for (size_t t = 0; t < triCount; t++)
+        {
+            const unsigned int *tri = &triangles[t * 3];
+            glm::vec3 n = glm::cross(vertices[tri[1]] - vertices[tri[0]], vertices[tri[2]] - vertices[tri[0]]);
+            n /= glm::length(n); // degenerate triangles were dropped by bake
+            faceNormals[t] = n;
+            for (int k = 0; k < 3; k++)
+            {
+                glm::vec3 e1 = vertices[tri[(k + 1) % 3]] - vertices[tri[k]];
+                glm::vec3 e2 = vertices[tri[(k + 2) % 3]] - vertices[tri[k]];
+                float l1 = glm::length(e1), l2 = glm::length(e2);
+                if (l1 > 0.0f && l2 > 0.0f)
+                    vertexNormals[tri[k]] += n * std::acos(glm::clamp(glm::dot(e1, e2) / (l1 * l2), -1.0f, 1.0f));
+                edgeNormals[edgeKey(tri[k], tri[(k + 1) % 3])] += n;
+            }
+        }
+    }
+
+    glm::ivec3 nodeCoord(int n) const
+    {
+        return glm::ivec3(n % BRICK_NODES, (n / BRICK_NODES) % BRICK_NODES, n / (BRICK_NODES * BRICK_NODES));
+    }
+
+    // distance to the closest triangle signed by its pseudonormal, UNRESOLVED when nothing is within sqrt(maxDistanceSq)
+    float signedDistance(const BVH &tree, const std::vector<glm::vec3> &vertices, const std::vector<unsigned int> &triangles,
+                         const glm::vec3 &p, float maxDistanceSq = FLT_MAX) const
+    {
+        auto distanceSq = [&](unsigned int tri)
+        {
+            glm::vec3 bary;
+            glm::vec3 d = p - Geometry::closestPointOnTriangle(p, vertices[triangles[tri * 3]], vertices[triangles[tri * 3 + 1]],
+                                                               vertices[triangles[tri * 3 + 2]], bary);
+            return glm::dot(d, d);
+        };
+        float bestSq;
+        int t = tree.nearest(p, distanceSq, bestSq, maxDistanceSq);
+        if (t < 0)
+            return UNRESOLVED;
+        const unsigned int *tri = &triangles[t * 3];
+        glm::vec3 bary;
+        glm::vec3 c = Geometry::closestPointOnTriangle(p, vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], bary);
+
+        // the closest feature picks the pseudonormal: zero weights mark the edge or vertex regions
+        glm::vec3 normal;
+        int zeros = (bary.x == 0.0f) + (bary.y == 0.0f) + (bary.z == 0.0f);
+        if (zeros == 0)
+        {
+            normal = faceNormals[t];
+        }
+        else if (zeros == 1)
+        {
+            int opposite = bary.x == 0.0f ? 0 : (bary.y == 0.0f ? 1 : 2);
+            auto edge = edgeNormals.find(edgeKey(tri[(opposite + 1) % 3], tri[(opposite + 2) % 3]));
+            normal = edge != edgeNormals.end() ? edge->second : faceNormals[t]; // runs inside the parallel bake, never throw
+        }
+        else
+        {
+            normal = vertexNormals[tri[bary.x != 0.0f ? 0 : (bary.y != 0.0f ? 1 : 2)]];
+        }
+        float distance = std::sqrt(bestSq);
+        return glm::dot(p - c, normal) < 0.0f ? -distance : distance;
+    }
+};
+
+/**
+ * Static colliders shared by the particle solvers (SPH particles, soft body vertices)
+ * - resolve samples every collider for a chunk of points first, then projects the chunk in one branch free loop
+ *   (push out to radius along the gradient, reflect the approaching normal velocity, Coulomb friction on the rest)
+ * - resolveBox is the bounding box as an analytic collider: clamp, then flip the clamped velocity components
+ * - both only touch the given range and keep no scratch state, so bodies can be resolved concurrently
+ */
+class ColliderSet
+{
+public:
+    //=======[adjustable parameters]========
+    float FRICTION = 0.2f;
+    //======================================
+
+    static constexpr int CHUNK = 256; // points sampled before a projection loop
+
+    std::vector<SDFCollider> colliders;
+
+    bool empty() const
+    {
+        return colliders.empty();
+    }
+
+    SDFCollider &add()
+    {
+        colliders.emplace_back();
+        return colliders.back();
+    }
+
+    /**
+     * Keep n points outside every collider
+     * - radius - the points are spheres of this radius
+     * - restitution - share of the normal velocity kept on a hit
+     */
+    void resolve(glm::vec3 *x, glm::vec3 *v, size_t n, float radius, float restitution) const
+    {
+        if (colliders.empty() || n == 0)
+            return;
+        long long chunks = (long long)((n + CHUNK - 1) / CHUNK);
+        const float friction = FRICTION;
+#pragma omp parallel for if (chunks > 1)
+        for (long long k = 0; k < chunks; k++)
+        {
+            float distance[CHUNK];
+            glm::vec3 gradient[CHUNK];
+            size_t first = (size_t)k * CHUNK;
+            size_t count = std::min((size_t)CHUNK, n - first);
+            glm::vec3 *xs = x + first;
+            glm::vec3 *vs = v + first;
+            for (const SDFCollider &collider : colliders)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    distance[i] = collider.sample(xs[i], gradient[i]);
+                }
+#pragma omp simd
+                for (size_t i = 0; i < count; i++)
+                {
+                    float len = std::sqrt(glm::dot(gradient[i], gradient[i]));
+                    glm::vec3 normal = gradient[i] / std::max(len, 1e-12f);
+                    float hit = (distance[i] < radius && len > 1e-12f) ? 1.0f : 0.0f;
+                    xs[i] += normal * (hit * (radius - distance[i]));
+
+                    float vn = glm::dot(vs[i], normal);
+                    float approach = hit * std::min(vn, 0.0f); // only the approaching part is reflected
+                    glm::vec3 tangent = vs[i] - normal * vn;
+                    float vt = std::sqrt(glm::dot(tangent, tangent));
+                    float keep = 1.0f - std::min(friction * (1.0f + restitution) * -approach / std::max(vt, 1e-12f), 1.0f);
+                    vs[i] += tangent * (keep - 1.0f) - normal * ((1.0f + restitution) * approach);
+                }
+            }
+        }
+    }
+
+    /**
+     * Keep n points of the given radius inside [boxMin, boxMax]
+     * - a clamped component of the velocity is reversed and scaled by restitution
+     */
+    static void resolveBox(glm::vec3 *x, glm::vec3 *v, size_t n, const glm::vec3 &boxMin, const glm::vec3 &boxMax,
+                           float radius, float restitution)
+    {
+        const glm::vec3 lo = boxMin + radius, hi = boxMax - radius;
+        long long count = (long long)n;
+#pragma omp parallel for simd if (count >= 4096)
+        for (long long i = 0; i < count; i++)
+        {
+            glm::vec3 clamped = glm::clamp(x[i], lo, hi);
+            glm::vec3 hit = glm::vec3(glm::notEqual(clamped, x[i]));
+            v[i] *= 1.0f - hit * (1.0f + restitution);
+            x[i] = clamped;
+        }
+    }
+};
@@ -1,12 +1,16 @@
 #pragma once
 
 #include <math.h>
+#include <cmath>
 #include <glm/glm.hpp>
 #include <vector>
 #include <iostream>
 #include <omp.h>
 #include <algorithm>
 #include <random>
+#include <cstdint>
+
+#include <Physics/SDFCollider.h>
 
 class SPHSolver
 {
@@ -490,16 +494,46 @@ public:
     const unsigned int DIMENSION = 3;
 
     //======[Particle properties]===========
+    // a pool: particles [0, alive) are simulated, the rest is spare capacity reused by the emitters
+    int alive = 0;
     std::vector<float> densities;
     std::vector<glm::vec3> positions;
     std::vector<glm::vec3> predicted_positions;
     std::vector<glm::vec3> velocities;
     std::vector<glm::vec3> accelerations;
     std::vector<glm::vec4> colors;
+    std::vector<uint8_t> levels;       // resolution level, a particle of level l has MASS / 2^l
+    std::vector<float> surface_offset; // distance to the center of mass of the neighborhood / smoothing radius, 0 inside the fluid
+
+    //======[Boundary particles]===========
+    // soft body vertices sampled into the fluid (Akinci et al. 2012), they follow the fluid in the spatial lookup
+    std::vector<glm::vec3> boundary_positions;
+    std::vector<glm::vec3> boundary_velocities;
+    std::vector<float> boundary_psi;        // rest density * volume of each boundary particle
+    std::vector<glm::vec3> boundary_forces; // force of the fluid on each boundary particle, valid after solver_step
 
     std::vector<SpatialCell> positions_hased; // store hashed position of each particles
     std::vector<int> hash_firstIdx;           // first particle of that group
 
+    //======[Cell activity]===========
+    // per hash cell, recomputed every step so nothing follows the particles through swap removes
+    std::vector<int> cell_calm;               // settled steps in a row
+    std::vector<int> cell_seen;               // last step the cell held a particle, an emptied cell starts over
+    std::vector<uint8_t> particle_active;     // cell or a neighbor cell is active, indexed like the lookup
+    std::vector<uint8_t> particle_restless;   // moved or changed density this step, indexed like the lookup
+    int sleep_step = 0;
+    int activeParticles = 0;
+    float activeFraction = 1.0f; // simulated share of the alive particles in the last step
+
+    //======[Adaptive resolution]===========
+    // a split halves the mass and shrinks the smoothing radius by 2^(1/3), so a child keeps the neighbor count of its parent,
+    // the tables follow MASS and SMOOTHING_RADIUS every step, the sliders keep working on every level
+    static constexpr int MAX_LEVELS = 4;
+    float level_mass[MAX_LEVELS];
+    float level_radius[MAX_LEVELS];
+    std::vector<uint8_t> particle_merge; // interior candidate, cleared when it joined a pair
+    std::vector<uint8_t> particle_dead;  // merged away, compacted at the end of adaptResolution
+
     //=======[adjustable parameters]========
     int N_PARTICLES = 1000;
     float MU = 0.75f;               // viscosity constant
@@ -516,8 +550,61 @@ public:
     glm::vec3 BOX_MAX;
     float SPAWN_GAP = 0.8f;
     bool USE_PREDICTED = false;
+
+    bool SLEEPING = true;                // skip cells whose particles settled
+    float SLEEP_VELOCITY = 0.05f;        // particles slower than this count as settled
+    float SLEEP_DENSITY_CHANGE = 0.001f; // relative density change per step under which a particle counts as settled
+    int SLEEP_STEPS = 60;                // settled steps before a cell goes inactive
+
+    bool ADAPTIVE = false;              // split particles at the surface and near the camera, merge them in the interior
+    int MAX_LEVEL = 2;                  // splits allowed from a spawned particle, at most MAX_LEVELS - 1
+    float SPLIT_SURFACE = 0.1f;         // surface_offset over which a particle is at the free surface
+    float MERGE_SURFACE = 0.04f;        // surface_offset under which a particle is in the interior
+    float SPLIT_CAMERA_DISTANCE = 5.0f; // particles closer to the camera split, merging needs twice the distance
     //======================================
 
+    glm::vec3 camera_position = glm::vec3(0.0f); // set by the renderer, drives the refinement around the camera
+
+    const ColliderSet *colliders = nullptr; // static geometry, not owned
+
+    //======[Emitters and sinks]===========
+    enum EmitterType
+    {
+        NOZZLE,     // disk of radius extent.x at position, shooting along velocity
+        VOLUME_FILL // random points in the box [position, position + extent]
+    };
+
+    struct Emitter
+    {
+        EmitterType type = NOZZLE;
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::vec3 extent = glm::vec3(1.0f);
+        glm::vec3 velocity = glm::vec3(0.0f, -1.0f, 0.0f); // initial velocity of emitted particles
+        float rate = 100.0f;                                // particles per second
+        int maxAlive = 100000;                              // no emission while the pool holds this many
+        bool enabled = true;
+        float pending = 0.0f; // fraction of a particle carried to the next step
+    };
+
+    // particles entering the box [min, max] are removed
+    struct Sink
+    {
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+        bool enabled = true;
+    };
+
+    std::vector<Emitter> emitters;
+    std::vector<Sink> sinks;
+
+    // stats
+    int lastEmitted = 0; // last step
+    int lastDrained = 0; // last step
+    int growCount = 0;   // pool reallocations since start
+    int lastSplits = 0;  // last step
+    int lastMerges = 0;  // last step
+    int fineEquivalent = 0; // particles a uniform fluid at the finest level would need for the same mass
+
     std::random_device rd;
     std::mt19937 gen;
     std::uniform_real_distribution<float> dis1;
@@ -534,12 +621,9 @@ public:
         BOX_MIN = glm::vec3(-10.0f, -10.0f, -10.0f);
         BOX_MAX = glm::vec3(10.0f, 10.0f, 10.0f);
 
-        densities = std::vector<float>(N_PARTICLES, 0.0f);
-        accelerations = std::vector<glm::vec3>(N_PARTICLES, glm::vec3(0.0f));
-        velocities = std::vector<glm::vec3>(N_PARTICLES, glm::vec3(0.0f));
-        positions = std::vector<glm::vec3>(N_PARTICLES, glm::vec3(0.0f));
-        predicted_positions = std::vector<glm::vec3>(positions);
-        colors = std::vector<glm::vec4>(N_PARTICLES, glm::vec4(0.8f, 0.2f, 0.2f, 1.0f));
+        reserveParticles(N_PARTICLES);
+        alive = N_PARTICLES;
+        updateLevelTables();
 
         positions_hased.resize(N_PARTICLES);
         hash_firstIdx = std::vector<int>(BUCKET_SIZE, -1);
@@ -598,28 +682,69 @@ public:
         }
     }
 
+    /**
+     * Boundary particles for the next step, they push the fluid and receive its reaction in boundary_forces
+     * - x, v - positions and velocities of n boundary particles, copied
+     */
+    void setBoundary(const glm::vec3 *x, const glm::vec3 *v, size_t n)
+    {
+        boundary_positions.assign(x, x + n);
+        boundary_velocities.assign(v, v + n);
+        boundary_psi.resize(n);
+        boundary_forces.assign(n, glm::vec3(0.0f));
+    }
+
+    void clearBoundary()
+    {
+        setBoundary(nullptr, nullptr, 0);
+    }
+
     // update simulation step
     void solver_step(float deltaTime, glm::vec3 boxMin = glm::vec3(0.0f), glm::vec3 boxMax = glm::vec3(0.0f))
     {
+        drainParticles();
+        emitParticles(deltaTime);
+        updateLevelTables();
 
 #pragma omp parallel for
-        for (int i = 0; i < densities.size(); i++)
+        for (int i = 0; i < alive; i++)
         {
             predicted_positions[i] = positions[i] + (velocities[i] * deltaTime);
         }
 
         updateSpatialLookup(USE_PREDICTED ? predicted_positions : positions);
+        updateActiveParticles();
 
+        // boundary volumes first, the fluid density depends on them
 #pragma omp parallel for
-        for (int i = 0; i < densities.size(); i++)
+        for (int b = 0; b < boundary_positions.size(); b++)
         {
+            boundary_psi[b] = calculateBoundaryPsi(b);
+        }
+
+#pragma omp parallel for
+        for (int i = 0; i < alive; i++)
+        {
+            if (!particle_active[i])
+                continue;
+            float previous = densities[i];
             densities[i] = calculateDensity(i); // recompute all density
+            particle_restless[i] = std::fabs(densities[i] - previous) > SLEEP_DENSITY_CHANGE * previous;
+        }
+
+        // reaction on the boundary, before the fluid velocities change
+#pragma omp parallel for
+        for (int b = 0; b < boundary_positions.size(); b++)
+        {
+            boundary_forces[b] = calculateBoundaryForce(b);
         }
 
         // accmulate velocity by pressure force and other
 #pragma omp parallel for
-        for (int i = 0; i < densities.size(); i++)
+        for (int i = 0; i < alive; i++)
         {
+            if (!particle_active[i])
+                continue;
             glm::vec3 a = (calculatePressureTerm(i) + calculateViscosityTerm(i)) / (densities[i] + 1e-6f);
             a += glm::vec3(0.0f, -GRAVITY, 0.0f);
 
@@ -632,72 +757,173 @@ public:
 
         setColorsByVelocity();
 
-// update position & resolve collision of given bounding box
+// update position
 #pragma omp parallel for
-        for (int i = 0; i < densities.size(); i++)
+        for (int i = 0; i < alive; i++)
         {
+            if (!particle_active[i])
+                continue;
             // positions[i] += velocities[i] * deltaTime;
 
             // leap fron integration
             positions[i] += (velocities[i] * deltaTime) + (0.5f * accelerations[i] * deltaTime * deltaTime);
+            particle_restless[i] |= glm::dot(velocities[i], velocities[i]) > SLEEP_VELOCITY * SLEEP_VELOCITY;
+        }
 
-            // Check X boundaries
-            if (positions[i].x - this->SPHERE_RADIUS < boxMin.x)
-            {
-                positions[i].x = boxMin.x + this->SPHERE_RADIUS;
-                velocities[i].x = -velocities[i].x * this->RESTITUTION;
-            }
-            else if (positions[i].x + this->SPHERE_RADIUS > boxMax.x)
-            {
-                positions[i].x = boxMax.x - this->SPHERE_RADIUS;
-                velocities[i].x = -velocities[i].x * this->RESTITUTION;
-            }
+        // bounding box and static geometry
+        ColliderSet::resolveBox(positions.data(), velocities.data(), alive, boxMin, boxMax, this->SPHERE_RADIUS, this->RESTITUTION);
+        if (colliders)
+            colliders->resolve(positions.data(), velocities.data(), alive, this->SPHERE_RADIUS, this->RESTITUTION);
 
-            // Check Y boundaries
-            if (positions[i].y - this->SPHERE_RADIUS < boxMin.y)
-            {
-                positions[i].y = boxMin.y + this->SPHERE_RADIUS;
-                velocities[i].y = -velocities[i].y * this->RESTITUTION;
-            }
-            else if (positions[i].y + this->SPHERE_RADIUS > boxMax.y)
-            {
-                positions[i].y = boxMax.y - this->SPHERE_RADIUS;
-                velocities[i].y = -velocities[i].y * this->RESTITUTION;
-            }
-
-            // Check Z boundaries
-            if (positions[i].z - this->SPHERE_RADIUS < boxMin.z)
-            {
-                positions[i].z = boxMin.z + this->SPHERE_RADIUS;
-                velocities[i].z = -velocities[i].z * this->RESTITUTION;
-            }
-            else if (positions[i].z + this->SPHERE_RADIUS > boxMax.z)
-            {
-                positions[i].z = boxMax.z - this->SPHERE_RADIUS;
-                velocities[i].z = -velocities[i].z * this->RESTITUTION;
-            }
-        }
+        updateCellActivity();
+        adaptResolution();
     }
 
     /**
      * Reset all particles values to initial state, position
+     * - reuses the pool, it only grows when N_PARTICLES is above the capacity
      */
     void resetSimulation()
     {
-        densities = std::vector<float>(N_PARTICLES, 0.0f);
-        accelerations = std::vector<glm::vec3>(N_PARTICLES, glm::vec3(0.0f));
-        velocities = std::vector<glm::vec3>(N_PARTICLES, glm::vec3(0.0f));
-        positions = std::vector<glm::vec3>(N_PARTICLES, glm::vec3(0.0f));
-        predicted_positions = std::vector<glm::vec3>(positions);
-        colors = std::vector<glm::vec4>(N_PARTICLES, glm::vec4(0.8f, 0.2f, 0.2f, 1.0f));
-
-        positions_hased.resize(N_PARTICLES);
-        hash_firstIdx = std::vector<int>(BUCKET_SIZE, -1);
+        reserveParticles(N_PARTICLES);
+        alive = N_PARTICLES;
+        std::fill(densities.begin(), densities.begin() + alive, 0.0f);
+        std::fill(accelerations.begin(), accelerations.begin() + alive, glm::vec3(0.0f));
+        std::fill(velocities.begin(), velocities.begin() + alive, glm::vec3(0.0f));
+        std::fill(colors.begin(), colors.begin() + alive, glm::vec4(0.8f, 0.2f, 0.2f, 1.0f));
+        std::fill(levels.begin(), levels.begin() + alive, 0);
+        std::fill(surface_offset.begin(), surface_offset.begin() + alive, 0.0f);
+        for (Emitter &emitter : emitters)
+        {
+            emitter.pending = 0.0f;
+        }
+        std::fill(cell_calm.begin(), cell_calm.end(), 0);
 
-        grid_init_particle(SPAWN_POS, densities.size(), SPAWN_GAP, DIMENSION);
+        grid_init_particle(SPAWN_POS, alive, SPAWN_GAP, DIMENSION);
         updateSpatialLookup(USE_PREDICTED ? predicted_positions : positions);
     }
 
+    size_t capacity() const
+    {
+        return positions.size();
+    }
+
+    /**
+     * Make room for count particles, the capacity doubles so a stream of emitted particles reallocates rarely
+     * - the renderer compares capacity() against its buffers and only reallocates them after a growth
+     */
+    void reserveParticles(size_t count)
+    {
+        if (count <= capacity())
+            return;
+        size_t grown = std::max(count, capacity() * 2);
+        densities.resize(grown, 0.0f);
+        accelerations.resize(grown, glm::vec3(0.0f));
+        velocities.resize(grown, glm::vec3(0.0f));
+        positions.resize(grown, glm::vec3(0.0f));
+        predicted_positions.resize(grown, glm::vec3(0.0f));
+        colors.resize(grown, glm::vec4(0.8f, 0.2f, 0.2f, 1.0f));
+        levels.resize(grown, 0);
+        surface_offset.resize(grown, 0.0f);
+        growCount++;
+    }
+
+    // append a particle to the pool, returns its index
+    int spawnParticle(const glm::vec3 &position, const glm::vec3 &velocity)
+    {
+        reserveParticles(alive + 1);
+        int i = alive++;
+        positions[i] = position;
+        predicted_positions[i] = position;
+        velocities[i] = velocity;
+        accelerations[i] = glm::vec3(0.0f);
+        densities[i] = 0.0f;
+        colors[i] = glm::vec4(0.8f, 0.2f, 0.2f, 1.0f);
+        levels[i] = 0;
+        surface_offset[i] = 0.0f;
+        return i;
+    }
+
+    // swap remove: the last alive particle takes the slot of i
+    void removeParticle(int i)
+    {
+        int last = --alive;
+        if (i == last)
+            return;
+        positions[i] = positions[last];
+        predicted_positions[i] = predicted_positions[last];
+        velocities[i] = velocities[last];
+        accelerations[i] = accelerations[last];
+        densities[i] = densities[last];
+        colors[i] = colors[last];
+        levels[i] = levels[last];
+        surface_offset[i] = surface_offset[last];
+    }
+
+    // spawn the particles every emitter owes for deltaTime
+    void emitParticles(float deltaTime)
+    {
+        lastEmitted = 0;
+        for (Emitter &emitter : emitters)
+        {
+            if (!emitter.enabled)
+                continue;
+            emitter.pending += emitter.rate * deltaTime;
+            int count = (int)emitter.pending;
+            emitter.pending -= (float)count;
+            count = std::min(count, std::max(emitter.maxAlive - alive, 0));
+
+            // nozzle: disk across the velocity, particles of one step are spread along the stream so they do not overlap
+            glm::vec3 dir = glm::length(emitter.velocity) > 1e-6f ? glm::normalize(emitter.velocity) : glm::vec3(0.0f, -1.0f, 0.0f);
+            glm::vec3 side = glm::normalize(glm::cross(dir, std::fabs(dir.y) < 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f)));
+            glm::vec3 up = glm::cross(dir, side);
+            for (int k = 0; k < count; k++)
+            {
+                glm::vec3 position;
+                if (emitter.type == NOZZLE)
+                {
+                    float angle = dis1(gen);
+                    float radius = emitter.extent.x * std::sqrt(0.5f * (dis2(gen) + 1.0f));
+                    position = emitter.position + (side * std::cos(angle) + up * std::sin(angle)) * radius +
+                               emitter.velocity * (deltaTime * (float)k / (float)count);
+                }
+                else
+                {
+                    glm::vec3 u(0.5f * (dis2(gen) + 1.0f), 0.5f * (dis2(gen) + 1.0f), 0.5f * (dis2(gen) + 1.0f));
+                    position = emitter.position + emitter.extent * u;
+                }
+                spawnParticle(position, emitter.velocity);
+            }
+            lastEmitted += count;
+        }
+    }
+
+    // remove particles inside any sink
+    void drainParticles()
+    {
+        lastDrained = 0;
+        for (const Sink &sink : sinks)
+        {
+            if (!sink.enabled)
+                continue;
+            for (int i = 0; i < alive;)
+            {
+                const glm::vec3 &p = positions[i];
+                bool inside = p.x >= sink.min.x && p.x <= sink.max.x && p.y >= sink.min.y && p.y <= sink.max.y &&
+                              p.z >= sink.min.z && p.z <= sink.max.z;
+                if (inside)
+                {
+                    removeParticle(i); // i now holds the former last particle, test it again
+                    lastDrained++;
+                }
+                else
+                {
+                    i++;
+                }
+            }
+        }
+    }
+
 private:
     //=================[Smoothing Kernel function]===========================
     float smoothingKernel(float distance, float radius)
@@ -784,16 +1010,33 @@ private:
     }
 
     //====================[properties compute function]==============================
+    /**
+     * Fluid pairs use the mean smoothing radius of both particles, symmetric so the pressure forces stay equal and opposite
+     * - boundary particles are sampled at the spawned resolution and keep SMOOTHING_RADIUS
+     * - the same sum weights the neighbor positions into surface_offset of i: a full neighborhood is centered on i,
+     *   at the free surface (and along the box walls) the neighbors sit on one side
+     */
     float calculateDensity(int i)
     {
-        float density = MASS * poly6Kernel(0.0f, SMOOTHING_RADIUS);
+        float h_i = level_radius[levels[i]];
+        float density = level_mass[levels[i]] * poly6Kernel(0.0f, h_i);
         glm::vec3 pos_i = USE_PREDICTED ? predicted_positions[i] : positions[i];
+        glm::vec3 offset(0.0f);
 
-        forEachWithinRadius(i, USE_PREDICTED, [&](int j)
-                            {
+        forEachNeighbor(pos_i, i, USE_PREDICTED, [&](int j)
+                        {
             glm::vec3 pos_j = USE_PREDICTED ? predicted_positions[j] : positions[j];
-            density += MASS * poly6Kernel(glm::length(pos_i-pos_j) , SMOOTHING_RADIUS); });
-
+            float h_ij = 0.5f * (h_i + level_radius[levels[j]]);
+            float w = level_mass[levels[j]] * poly6Kernel(glm::length(pos_i-pos_j) , h_ij);
+            density += w;
+            offset += w * (pos_j - pos_i); },
+                        [&](int b)
+                        {
+            float w = boundary_psi[b] * poly6Kernel(glm::length(pos_i - boundary_positions[b]), SMOOTHING_RADIUS);
+            density += w;
+            offset += w * (boundary_positions[b] - pos_i); });
+
+        surface_offset[i] = glm::length(offset) / (density * h_i);
         return density;
     }
 
@@ -803,9 +1046,10 @@ private:
         glm::vec3 pos_i = USE_PREDICTED ? predicted_positions[i] : positions[i];
         float rho_i = densities[i];
         float p_i = (PRESSURE_MULT * (rho_i - DENSITY_0));
+        float h_i = level_radius[levels[i]];
 
-        forEachWithinRadius(i, USE_PREDICTED, [&](int j)
-                            {
+        forEachNeighbor(pos_i, i, USE_PREDICTED, [&](int j)
+                        {
                                 glm::vec3 pos_j = USE_PREDICTED ? predicted_positions[j] : positions[j];
                                 glm::vec3 r_vec = pos_i - pos_j;
                                 
@@ -815,7 +1059,13 @@ private:
                                 float rho_j = densities[j];
                                 float p_j = (PRESSURE_MULT * (rho_j - DENSITY_0));
 
-                                force += MASS * ((p_i + p_j) / 2.0f) * spikyKernelGradient(r_vec, SMOOTHING_RADIUS); });
+                                float h_ij = 0.5f * (h_i + level_radius[levels[j]]);
+                                force += level_mass[levels[j]] * ((p_i + p_j) / 2.0f) * spikyKernelGradient(r_vec, h_ij); },
+                        [&](int b)
+                        {
+                                // a boundary particle mirrors the pressure of i
+                                glm::vec3 r_vec = pos_i - boundary_positions[b];
+                                force += boundary_psi[b] * p_i * spikyKernelGradient(r_vec, SMOOTHING_RADIUS); });
         return force;
     }
 
@@ -823,15 +1073,55 @@ private:
     {
         glm::vec3 force(0.0f);
         glm::vec3 pos_i = USE_PREDICTED ? predicted_positions[i] : positions[i];
+        float h_i = level_radius[levels[i]];
 
-        forEachWithinRadius(i, USE_PREDICTED, [&](int j)
-                            {
+        forEachNeighbor(pos_i, i, USE_PREDICTED, [&](int j)
+                        {
             glm::vec3 pos_j = USE_PREDICTED ? predicted_positions[j] : positions[j];
-            force += MASS * ((velocities[j] - velocities[i])/(densities[j] + 1e-6f)) * laplacianViscosityKernel(glm::length(pos_j - pos_i) , SMOOTHING_RADIUS); });
+            float h_ij = 0.5f * (h_i + level_radius[levels[j]]);
+            force += level_mass[levels[j]] * ((velocities[j] - velocities[i])/(densities[j] + 1e-6f)) * laplacianViscosityKernel(glm::length(pos_j - pos_i) , h_ij); },
+                        [&](int b)
+                        {
+            // no slip against the moving boundary, it has no density of its own
+            force += boundary_psi[b] * ((boundary_velocities[b] - velocities[i]) / (densities[i] + 1e-6f)) * laplacianViscosityKernel(glm::length(boundary_positions[b] - pos_i), SMOOTHING_RADIUS); });
 
         return MU * force;
     }
 
+    /**
+     * Akinci boundary volume: rest density over the kernel sum of the boundary samples around b
+     * - the rest density is the one of the spawn lattice (MASS / SPAWN_GAP^3), what the kernel sums of the fluid give,
+     *   DENSITY_0 is only the pressure target and would make the boundary far heavier than the fluid
+     */
+    float calculateBoundaryPsi(int b)
+    {
+        const glm::vec3 &pos_b = boundary_positions[b];
+        float sum = poly6Kernel(0.0f, SMOOTHING_RADIUS);
+        forEachNeighbor(pos_b, alive + b, USE_PREDICTED, [](int) {}, [&](int k)
+                        { sum += poly6Kernel(glm::length(pos_b - boundary_positions[k]), SMOOTHING_RADIUS); });
+        float rest_density = MASS / (SPAWN_GAP * SPAWN_GAP * SPAWN_GAP);
+        return rest_density / sum;
+    }
+
+    // force of the fluid on boundary particle b, the negated boundary terms of every fluid neighbor
+    glm::vec3 calculateBoundaryForce(int b)
+    {
+        glm::vec3 force(0.0f);
+        const glm::vec3 &pos_b = boundary_positions[b];
+        float psi = boundary_psi[b];
+        forEachNeighbor(pos_b, alive + b, USE_PREDICTED, [&](int i)
+                        {
+            glm::vec3 pos_i = USE_PREDICTED ? predicted_positions[i] : positions[i];
+            glm::vec3 r_vec = pos_i - pos_b;
+            float rho_i = densities[i] + 1e-6f;
+            float p_i = (PRESSURE_MULT * (densities[i] - DENSITY_0));
+            glm::vec3 pressure = psi * p_i * spikyKernelGradient(r_vec, SMOOTHING_RADIUS);
+            glm::vec3 viscosity = MU * psi * ((boundary_velocities[b] - velocities[i]) / rho_i) * laplacianViscosityKernel(glm::length(r_vec), SMOOTHING_RADIUS);
+            force -= level_mass[levels[i]] * (pressure + viscosity) / rho_i; },
+                        [](int) {});
+        return force;
+    }
+
     glm::vec3 random_direction()
     {
         return glm::normalize(glm::vec3(rand() / (float)RAND_MAX - 0.5f,
@@ -846,14 +1136,32 @@ private:
     void forEachWithinRadius(int i, bool use_predicted, Func callback)
     {
         glm::vec3 pos_i = use_predicted ? predicted_positions[i] : positions[i];
+        forEachNeighbor(pos_i, i, use_predicted, callback, [](int) {});
+    }
+
+    /**
+     * Enumerate fluid and boundary particles within the smoothing radius of pos from one walk over the 3x3x3 cells
+     * - SMOOTHING_RADIUS is the largest radius of any level, the cells stay that size and the callers cut each pair
+     *   at its own radius through the kernels, which are zero past it
+     * - self - lookup index skipped, fluid index or alive + boundary index
+     * - fluidCallback(j) - fluid neighbor j
+     * - boundaryCallback(b) - boundary neighbor b
+     */
+    template <typename FluidFunc, typename BoundaryFunc>
+    void forEachNeighbor(const glm::vec3 &pos, int self, bool use_predicted, FluidFunc fluidCallback, BoundaryFunc boundaryCallback)
+    {
+        glm::vec3 pos_i = pos;
         glm::ivec3 cell = positionToGrid(pos_i);
         float sqr_radius = SMOOTHING_RADIUS * SMOOTHING_RADIUS;
+        int fluidCount = alive;
 
         // iterate all surrounding neighbor (3x3x3)
         for (int j = 0; j < offsetCells.size(); j += 3)
         {
             int key = hashGridCell(glm::ivec3(cell.x + (offsetCells[j]), cell.y + (offsetCells[j + 1]), cell.z + (offsetCells[j + 2])));
             int start_idx = hash_firstIdx[key];
+            if (start_idx < 0)
+                continue;
 
             // iterate all particles in bucket
             for (int inCell_idx = start_idx; inCell_idx < positions_hased.size(); inCell_idx++)
@@ -865,15 +1173,21 @@ private:
                 int neighbor_idx = positions_hased[inCell_idx].idx;
 
                 // skip self
-                if (i == neighbor_idx)
+                if (self == neighbor_idx)
                     continue;
-                glm::vec3 v_dist = (pos_i - (use_predicted ? predicted_positions[neighbor_idx] : positions[neighbor_idx]));
+                bool boundary = neighbor_idx >= fluidCount;
+                const glm::vec3 &pos_j = boundary ? boundary_positions[neighbor_idx - fluidCount]
+                                                  : (use_predicted ? predicted_positions[neighbor_idx] : positions[neighbor_idx]);
+                glm::vec3 v_dist = pos_i - pos_j;
                 float sqrDist = glm::dot(v_dist, v_dist);
 
                 // re-check if really within radius
                 if (sqrDist <= sqr_radius)
                 {
-                    callback(neighbor_idx); // Call user-supplied callback
+                    if (boundary)
+                        boundaryCallback(neighbor_idx - fluidCount);
+                    else
+                        fluidCallback(neighbor_idx); // Call user-supplied callback
                 }
             }
         }
@@ -901,8 +1215,8 @@ private:
 
                 int neighbor_idx = positions_hased[inCell_idx].idx;
 
-                // skip self
-                if (i == neighbor_idx)
+                // skip self and boundary particles
+                if (i == neighbor_idx || neighbor_idx >= alive)
                     continue;
                 glm::vec3 v_dist = (pos_i - (use_predicted ? predicted_positions[neighbor_idx] : positions[neighbor_idx]));
                 float sqrDist = glm::dot(v_dist, v_dist);
@@ -918,12 +1232,18 @@ private:
 
     void updateSpatialLookup(std::vector<glm::vec3> &postitions_arr)
     {
+        // boundary particles follow the fluid, both solvers read the same lookup
+        int fluidCount = alive;
+        int total = fluidCount + (int)boundary_positions.size();
+        positions_hased.resize(total);
+
 // generate all hashed key for particles
 #pragma omp parallel for
-        for (int i = 0; i < postitions_arr.size(); i++)
+        for (int i = 0; i < total; i++)
         {
             // turn current position into corresponding grid then hash
-            glm::ivec3 cell_pos = positionToGrid(postitions_arr[i]);
+            glm::vec3 pos = i < fluidCount ? postitions_arr[i] : boundary_positions[i - fluidCount];
+            glm::ivec3 cell_pos = positionToGrid(pos);
             int hashkey = hashGridCell(cell_pos);
 
             positions_hased[i] = SpatialCell(hashkey, i);
@@ -941,7 +1261,7 @@ private:
 
         // determine first occurence of key
 #pragma omp parallel for
-        for (int i = 0; i < postitions_arr.size(); i++)
+        for (int i = 0; i < total; i++)
         {
             int key = positions_hased[i].key;
             int keyPrev = i == 0 ? -1 : positions_hased[i - 1].key;
@@ -952,6 +1272,213 @@ private:
         }
     }
 
+    /**
+     * A particle is simulated when its cell or one of the 26 around it is active, so settled regions wake up
+     * from their border as soon as a neighbor cell moves
+     * - a cell is active until it stayed calm for SLEEP_STEPS, or when it held no particle in the previous step
+     */
+    void updateActiveParticles()
+    {
+        int total = (int)positions_hased.size();
+        particle_active.assign(total, 1);
+        particle_restless.assign(total, 0);
+        if (cell_calm.size() != hash_firstIdx.size())
+        {
+            cell_calm.assign(hash_firstIdx.size(), 0);
+            cell_seen.assign(hash_firstIdx.size(), -2);
+        }
+        if (!SLEEPING)
+        {
+            activeParticles = alive;
+            activeFraction = 1.0f;
+            return;
+        }
+
+        int active = 0;
+#pragma omp parallel for reduction(+ : active)
+        for (int i = 0; i < alive; i++)
+        {
+            glm::vec3 pos = USE_PREDICTED ? predicted_positions[i] : positions[i];
+            glm::ivec3 cell = positionToGrid(pos);
+            bool awake = false;
+            for (int j = 0; j < offsetCells.size() && !awake; j += 3)
+            {
+                int key = hashGridCell(glm::ivec3(cell.x + (offsetCells[j]), cell.y + (offsetCells[j + 1]), cell.z + (offsetCells[j + 2])));
+                awake = cell_seen[key] != sleep_step - 1 || cell_calm[key] < SLEEP_STEPS;
+            }
+            particle_active[i] = awake;
+            active += awake;
+        }
+        activeParticles = active;
+        activeFraction = alive > 0 ? (float)active / (float)alive : 1.0f;
+    }
+
+    // count calm steps per cell from the lookup runs, a moving boundary particle keeps its cell active
+    void updateCellActivity()
+    {
+        int total = (int)positions_hased.size();
+#pragma omp parallel for
+        for (int i = 0; i < total; i++)
+        {
+            int key = positions_hased[i].key;
+            int keyPrev = i == 0 ? -1 : positions_hased[i - 1].key;
+            if (key == keyPrev)
+                continue;
+            bool restless = false;
+            for (int k = i; k < total && positions_hased[k].key == key && !restless; k++)
+            {
+                int idx = positions_hased[k].idx;
+                if (idx < alive)
+                    restless = particle_restless[idx];
+                else
+                {
+                    const glm::vec3 &v = boundary_velocities[idx - alive];
+                    restless = glm::dot(v, v) > SLEEP_VELOCITY * SLEEP_VELOCITY;
+                }
+            }
+            int calm = cell_seen[key] == sleep_step - 1 ? cell_calm[key] : 0;
+            cell_calm[key] = restless ? 0 : std::min(calm + 1, SLEEP_STEPS);
+            cell_seen[key] = sleep_step;
+        }
+        sleep_step++;
+    }
+
+    void updateLevelTables()
+    {
+        for (int l = 0; l < MAX_LEVELS; l++)
+        {
+            level_mass[l] = MASS * std::ldexp(1.0f, -l);
+            level_radius[l] = SMOOTHING_RADIUS * std::cbrt(std::ldexp(1.0f, -l));
+        }
+    }
+
+    // distance between particles of level l in a fluid at rest
+    float levelSpacing(int l)
+    {
+        float rest_density = MASS / (SPAWN_GAP * SPAWN_GAP * SPAWN_GAP);
+        return std::cbrt(level_mass[l] / rest_density);
+    }
+
+    /**
+     * Split particles at the free surface or near the camera, merge pairs of the same level in the interior
+     * - surface and interior come from surface_offset of this step, the gap between SPLIT_SURFACE and MERGE_SURFACE
+     *   (and the doubled camera distance) keeps a particle from flipping every step
+     * - merges first: a candidate takes its nearest free candidate of the same level from the lookup of this step,
+     *   the pair becomes one particle at the center of mass with the summed momentum, then the dead slots are
+     *   swap removed from the back so no slot still to be visited is moved
+     * - a split keeps the parent as one child and appends the other, half a child spacing apart on a random axis
+     * - the cells of every new particle restart their calm count so a settled region simulates it
+     */
+    void adaptResolution()
+    {
+        lastSplits = 0;
+        lastMerges = 0;
+        int maxLevel = std::clamp(MAX_LEVEL, 0, MAX_LEVELS - 1);
+        if (ADAPTIVE)
+        {
+            float splitDistSq = SPLIT_CAMERA_DISTANCE * SPLIT_CAMERA_DISTANCE;
+            float mergeDistSq = 4.0f * splitDistSq;
+            int count = alive;
+            particle_merge.assign(count, 0);
+            particle_dead.assign(count, 0);
+
+#pragma omp parallel for
+            for (int i = 0; i < count; i++)
+            {
+                glm::vec3 toCamera = positions[i] - camera_position;
+                particle_merge[i] = levels[i] > 0 && densities[i] > 0.0f && surface_offset[i] < MERGE_SURFACE &&
+                                    glm::dot(toCamera, toCamera) > mergeDistSq;
+            }
+
+            // pairing is serial, a particle joins at most one pair
+            for (int i = 0; i < count; i++)
+            {
+                if (!particle_merge[i])
+                    continue;
+                int level = levels[i];
+                float limitSq = levelSpacing(level - 1) * levelSpacing(level - 1);
+                int partner = -1;
+                float bestSq = limitSq;
+                glm::vec3 pos_i = positions[i];
+                forEachNeighbor(pos_i, i, false, [&](int j)
+                                {
+                    if (!particle_merge[j] || levels[j] != level)
+                        return;
+                    glm::vec3 d = positions[j] - pos_i;
+                    float dSq = glm::dot(d, d);
+                    if (dSq < bestSq)
+                    {
+                        bestSq = dSq;
+                        partner = j;
+                    } },
+                                [](int) {});
+                if (partner < 0)
+                    continue;
+
+                // equal masses, the center of mass and the momentum are plain averages
+                particle_merge[i] = particle_merge[partner] = 0;
+                positions[i] = 0.5f * (positions[i] + positions[partner]);
+                predicted_positions[i] = positions[i];
+                velocities[i] = 0.5f * (velocities[i] + velocities[partner]);
+                accelerations[i] = 0.5f * (accelerations[i] + accelerations[partner]);
+                densities[i] = 0.5f * (densities[i] + densities[partner]);
+                surface_offset[i] = 0.5f * (surface_offset[i] + surface_offset[partner]);
+                levels[i] = level - 1;
+                particle_dead[partner] = 1;
+                restartCell(positions[i]);
+                lastMerges++;
+            }
+            for (int i = count - 1; i >= 0 && lastMerges > 0; i--)
+            {
+                if (particle_dead[i])
+                    removeParticle(i);
+            }
+
+            // children are appended past count, they are not split again in this step
+            count = alive;
+            for (int i = 0; i < count; i++)
+            {
+                int level = levels[i];
+                if (level >= maxLevel || densities[i] <= 0.0f)
+                    continue;
+                glm::vec3 toCamera = positions[i] - camera_position;
+                bool atSurface = surface_offset[i] > SPLIT_SURFACE;
+                if (!atSurface && glm::dot(toCamera, toCamera) > splitDistSq)
+                    continue;
+
+                glm::vec3 offset = 0.5f * levelSpacing(level + 1) * random_direction();
+                glm::vec3 position = positions[i], velocity = velocities[i], acceleration = accelerations[i];
+                float density = densities[i], surface = surface_offset[i];
+                int child = spawnParticle(position + offset, velocity); // may grow the pool
+                accelerations[child] = acceleration;
+                densities[child] = density;
+                surface_offset[child] = surface;
+                colors[child] = colors[i];
+                levels[child] = level + 1;
+                positions[i] = position - offset;
+                predicted_positions[i] = positions[i];
+                levels[i] = level + 1;
+                restartCell(positions[i]);
+                restartCell(positions[child]);
+                lastSplits++;
+            }
+        }
+
+        int fine = 0;
+#pragma omp parallel for reduction(+ : fine)
+        for (int i = 0; i < alive; i++)
+        {
+            fine += 1 << std::max(maxLevel - (int)levels[i], 0);
+        }
+        fineEquivalent = fine;
+    }
+
+    void restartCell(glm::vec3 pos)
+    {
+        if (!cell_calm.empty())
+            cell_calm[hashGridCell(positionToGrid(pos))] = 0;
+    }
+
     glm::ivec3 positionToGrid(glm::vec3 &pos)
     {
         return glm::floor(pos / SMOOTHING_RADIUS);
@@ -1017,7 +1544,7 @@ private:
     void setColorsByVelocity()
     {
 #pragma omp parallel for
-        for (int i = 0; i < velocities.size(); i++)
+        for (int i = 0; i < alive; i++)
         {
             float velSqr = abs(glm::dot(velocities[i], velocities[i]));
             float minVel = 1;
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <Eigen/Dense>
+
+// rotation part of the shape matching transform (Muller et al. 2005)
+class ShapeMatching
+{
+public:
+    // rotation R of the polar decomposition A_pq = R * S, without reflection
+    static Eigen::Matrix3d polarRotation(const Eigen::Matrix3d &apq)
+    {
+        Eigen::JacobiSVD<Eigen::Matrix3d> svd(apq, Eigen::ComputeFullU | Eigen::ComputeFullV);
+        Eigen::Matrix3d R = svd.matrixU() * svd.matrixV().transpose();
+
+        // Ensure the rotation matrix is proper (no reflection/inversion)
+        if (R.determinant() < 0)
+        {
+            Eigen::Matrix3d U_mod = svd.matrixU();
+            U_mod.col(2) *= -1;
+            R = U_mod * svd.matrixV().transpose();
+        }
+        return R;
+    }
+
+    // optimal rotation from rest offsets q to current offsets (x - x_cm)
+    static glm::mat3 rotation(const glm::vec3 *x, const glm::vec3 *q, size_t n, glm::vec3 x_cm)
+    {
+        glm::mat3 A_pq(0.0f);
+        for (size_t i = 0; i < n; ++i)
+        {
+            A_pq += glm::outerProduct(x[i] - x_cm, q[i]);
+        }
+
+        Eigen::Matrix3d apq;
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                apq(i, j) = A_pq[j][i]; // glm is column-major
+            }
+        }
+
+        Eigen::Matrix3d R_eigen = polarRotation(apq);
+
+        glm::mat3 R;
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                R[j][i] = (float)R_eigen(i, j);
+            }
+        }
+        return R;
+    }
+};
@@ -0,0 +1,318 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <cmath>
+#include <omp.h>
+
+#include <objectloader.h>
+
+/**
+ * Vertex vs vertex contact for soft bodies, both between bodies and inside one body
+ * - every vertex is a sphere of RADIUS, a spatial hash with cell size 2 * RADIUS is rebuilt every step
+ * - the hash table is filled by counting sort (count per bucket, prefix sum, scatter), then every bucket is put
+ *   in vertex order so contacts are summed in the same order on every run, whatever the thread timing
+ * - same body pairs that are close in the rest shape or share a constraint are excluded once, up front
+ * - every vertex gathers its own correction from its neighbors, so the narrow phase has no write conflicts
+ */
+class SoftBodyCollision
+{
+public:
+    //=======[adjustable parameters]========
+    float RADIUS = 0.01f;
+    float RESTITUTION = 0.0f;
+    float FRICTION = 0.2f;        // fraction of the tangential relative velocity removed by a contact
+    float EXCLUSION_SCALE = 1.5f; // same body pairs closer than EXCLUSION_SCALE * 2 * RADIUS at rest never collide
+    bool SELF_COLLISION = true;
+    bool BODY_COLLISION = true;
+    //======================================
+
+    // stats of last resolve
+    int lastContacts = 0;
+
+    // body pairs (first < second) that touched in the last resolve, the contact graph for islands
+    std::vector<std::pair<int, int>> bodyContacts;
+
+    bool enabled() const
+    {
+        return SELF_COLLISION || BODY_COLLISION;
+    }
+
+    // exclusions have to be rebuilt when vertices are added or the radius changes
+    bool exclusionsValid(size_t n) const
+    {
+        return exclusionStart.size() == n + 1 && exclusionRange == 2.0f * RADIUS * EXCLUSION_SCALE;
+    }
+
+    /**
+     * Build the per vertex exclusion lists (CSR, sorted)
+     * - rest - rest positions of all vertices (bodies placed where they were spawned)
+     * - vertexBody - owning body of every vertex
+     * - links - vertex pairs that are always excluded (constraints)
+     */
+    void setExclusions(const glm::vec3 *rest, const int *vertexBody, size_t n, const std::vector<std::pair<unsigned int, unsigned int>> &links)
+    {
+        exclusionRange = 2.0f * RADIUS * EXCLUSION_SCALE;
+        buildHash(rest, n, exclusionRange);
+
+        float range_sq = exclusionRange * exclusionRange;
+        std::vector<std::vector<uint64_t>> found(omp_get_max_threads());
+#pragma omp parallel for
+        for (long long i = 0; i < (long long)n; i++)
+        {
+            std::vector<uint64_t> &local = found[omp_get_thread_num()];
+            forEachCandidate(rest[i], [&](unsigned int j, const glm::vec3 &xj)
+                             {
+                                 if (j <= (unsigned int)i || vertexBody[j] != vertexBody[i])
+                                     return;
+                                 glm::vec3 d = rest[i] - xj;
+                                 if (glm::dot(d, d) < range_sq)
+                                 {
+                                     local.push_back(pairKey((unsigned int)i, j));
+                                     local.push_back(pairKey(j, (unsigned int)i));
+                                 } });
+        }
+
+        std::vector<uint64_t> keys;
+        for (auto &local : found)
+        {
+            keys.insert(keys.end(), local.begin(), local.end());
+        }
+        for (auto &link : links)
+        {
+            keys.push_back(pairKey(link.first, link.second));
+            keys.push_back(pairKey(link.second, link.first));
+        }
+        ObjectLoader::parallelSort(keys, [](uint64_t l, uint64_t r)
+                                   { return l < r; });
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        exclusionStart.assign(n + 1, 0);
+        exclusionList.resize(keys.size());
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            exclusionStart[(keys[k] >> 32) + 1]++;
+            exclusionList[k] = (unsigned int)(keys[k] & 0xffffffffu);
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            exclusionStart[i + 1] += exclusionStart[i];
+        }
+    }
+
+    /**
+     * Push overlapping vertices apart and remove their approaching velocity
+     * positions/velocities are the whole pool, vertexBody tells which pairs are self contacts
+     * bodyAsleep (optional, per body) - sleeping vertices stay in the hash for the awake ones but gather nothing
+     */
+    void resolve(glm::vec3 *x, glm::vec3 *v, const int *vertexBody, size_t n, const uint8_t *bodyAsleep = nullptr)
+    {
+        lastContacts = 0;
+        bodyContacts.clear();
+        if (!enabled() || n == 0)
+            return;
+        threadBodyContacts.resize(omp_get_max_threads());
+        for (auto &local : threadBodyContacts)
+        {
+            local.clear();
+        }
+
+        float contact = 2.0f * RADIUS;
+        buildHash(x, n, contact);
+        deltaX.resize(n);
+        deltaV.resize(n);
+
+        float contact_sq = contact * contact;
+        int contacts = 0;
+#pragma omp parallel for reduction(+ : contacts)
+        for (long long i = 0; i < (long long)n; i++)
+        {
+            glm::vec3 xi = x[i], vi = v[i];
+            int body = vertexBody[i];
+            glm::vec3 dx(0.0f), dv(0.0f);
+            if (bodyAsleep && bodyAsleep[body])
+            {
+                deltaX[i] = dx;
+                deltaV[i] = dv;
+                continue;
+            }
+            std::vector<uint64_t> &touched = threadBodyContacts[omp_get_thread_num()];
+            forEachCandidate(xi, [&](unsigned int j, const glm::vec3 &xj)
+                             {
+                                 // distance first, most candidates are out of reach
+                                 glm::vec3 d = xi - xj;
+                                 float dist_sq = glm::dot(d, d);
+                                 if (dist_sq >= contact_sq || dist_sq < 1e-12f)
+                                     return;
+                                 bool same = vertexBody[j] == body;
+                                 if (same ? !SELF_COLLISION : !BODY_COLLISION)
+                                     return;
+                                 if (same && isExcluded((unsigned int)i, j))
+                                     return;
+                                 if (!same)
+                                 {
+                                     uint64_t key = pairKey((unsigned int)std::min(body, vertexBody[j]), (unsigned int)std::max(body, vertexBody[j]));
+                                     if (touched.empty() || touched.back() != key)
+                                         touched.push_back(key);
+                                 }
+
+                                 float dist = std::sqrt(dist_sq);
+                                 glm::vec3 normal = d / dist;
+                                 dx += normal * (0.5f * (contact - dist)); // each side takes half the overlap
+
+                                 glm::vec3 rel = vi - v[j];
+                                 float approach = glm::dot(rel, normal);
+                                 if (approach < 0.0f)
+                                 {
+                                     glm::vec3 tangent = rel - approach * normal;
+                                     dv -= normal * (0.5f * (1.0f + RESTITUTION) * approach) + tangent * (0.5f * FRICTION);
+                                 }
+                                 contacts++; });
+            deltaX[i] = dx;
+            deltaV[i] = dv;
+        }
+
+#pragma omp parallel for
+        for (long long i = 0; i < (long long)n; i++)
+        {
+            x[i] += deltaX[i];
+            v[i] += deltaV[i];
+        }
+        lastContacts = contacts / 2; // every pair is seen from both sides
+
+        std::vector<uint64_t> keys;
+        for (auto &local : threadBodyContacts)
+        {
+            keys.insert(keys.end(), local.begin(), local.end());
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        for (uint64_t key : keys)
+        {
+            bodyContacts.emplace_back((int)(key >> 32), (int)(key & 0xffffffffu));
+        }
+    }
+
+private:
+    // hash table of the last build: vertices of bucket b are sortedIds[bucketStart[b] .. bucketStart[b + 1])
+    // sortedPositions mirrors sortedIds so a query walks contiguous memory
+    std::vector<unsigned int> bucketStart;
+    std::vector<unsigned int> bucketFill;
+    std::vector<unsigned int> sortedIds;
+    std::vector<glm::vec3> sortedPositions;
+    std::vector<unsigned int> vertexBucket;
+    unsigned int bucketMask = 0;
+    float invCellSize = 1.0f;
+
+    std::vector<unsigned int> exclusionStart; // excluded partners of vertex i: exclusionList[exclusionStart[i] .. exclusionStart[i + 1])
+    std::vector<unsigned int> exclusionList;
+    float exclusionRange = -1.0f;
+
+    std::vector<glm::vec3> deltaX, deltaV;
+    std::vector<std::vector<uint64_t>> threadBodyContacts;
+
+    static uint64_t pairKey(unsigned int a, unsigned int b)
+    {
+        return ((uint64_t)a << 32) | b;
+    }
+
+    unsigned int hashCell(glm::ivec3 cell) const
+    {
+        // same primes as the SPH lookup
+        return (((unsigned int)cell.x * 73856093u) ^ ((unsigned int)cell.y * 19349663u) ^ ((unsigned int)cell.z * 83492791u)) & bucketMask;
+    }
+
+    glm::ivec3 positionToCell(const glm::vec3 &p) const
+    {
+        return glm::ivec3(glm::floor(p * invCellSize));
+    }
+
+    void buildHash(const glm::vec3 *x, size_t n, float cellSize)
+    {
+        size_t buckets = 1024;
+        while (buckets < n * 2)
+            buckets *= 2;
+        bucketMask = (unsigned int)(buckets - 1);
+        invCellSize = 1.0f / cellSize;
+
+        vertexBucket.resize(n);
+        sortedIds.resize(n);
+        sortedPositions.resize(n);
+        bucketStart.assign(buckets + 1, 0);
+
+        // count
+#pragma omp parallel for
+        for (long long i = 0; i < (long long)n; i++)
+        {
+            unsigned int b = hashCell(positionToCell(x[i]));
+            vertexBucket[i] = b;
+#pragma omp atomic
+            bucketStart[b + 1]++;
+        }
+        // prefix sum
+        for (size_t b = 0; b < buckets; b++)
+        {
+            bucketStart[b + 1] += bucketStart[b];
+        }
+        // scatter
+        bucketFill.assign(bucketStart.begin(), bucketStart.end() - 1);
+#pragma omp parallel for
+        for (long long i = 0; i < (long long)n; i++)
+        {
+            unsigned int slot;
+#pragma omp atomic capture
+            slot = bucketFill[vertexBucket[i]]++;
+            sortedIds[slot] = (unsigned int)i;
+        }
+        // the scatter fills a bucket in thread arrival order, buckets hold a handful of vertices so sorting is cheap
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (long long b = 0; b < (long long)buckets; b++)
+        {
+            unsigned int begin = bucketStart[b], end = bucketStart[b + 1];
+            if (end - begin > 1)
+                std::sort(sortedIds.begin() + begin, sortedIds.begin() + end);
+            for (unsigned int s = begin; s < end; s++)
+            {
+                sortedPositions[s] = x[sortedIds[s]];
+            }
+        }
+    }
+
+    // every vertex in the 3x3x3 cells around p, buckets shared by two cells are visited once
+    template <typename Func>
+    void forEachCandidate(const glm::vec3 &p, Func callback) const
+    {
+        glm::ivec3 cell = positionToCell(p);
+        unsigned int visited[27];
+        int visitedCount = 0;
+        for (int dz = -1; dz <= 1; dz++)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    unsigned int b = hashCell(cell + glm::ivec3(dx, dy, dz));
+                    if (bucketStart[b] == bucketStart[b + 1])
+                        continue;
+                    if (std::find(visited, visited + visitedCount, b) != visited + visitedCount)
+                        continue;
+                    visited[visitedCount++] = b;
+                    for (unsigned int s = bucketStart[b]; s < bucketStart[b + 1]; s++)
+                    {
+                        callback(sortedIds[s], sortedPositions[s]);
+                    }
+                }
+            }
+        }
+    }
+
+    bool isExcluded(unsigned int i, unsigned int j) const
+    {
+        const unsigned int *begin = exclusionList.data() + exclusionStart[i];
+        const unsigned int *end = exclusionList.data() + exclusionStart[i + 1];
+        return std::binary_search(begin, end, j);
+    }
+};
@@ -0,0 +1,662 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <omp.h>
+
+#include <objectloader.h>
+#include <Physics/BVH.h>
+#include <Physics/Geometry.h>
+
+/**
+ * Triangle level contact between soft bodies
+ * - every surface (body with faces) keeps a triangle BVH that is built once and refit every step
+ * - a top level BVH over the surface bounds picks the body pairs that can touch
+ * - narrow phase per pair: vertices of each side against triangles of the other, edges of the first against edges of the second
+ * - contacts are collected in parallel, sorted by their vertices and applied in one serial pass
+ *   (few contacts, vertices shared between contacts), the sort keeps the result independent of thread timing
+ * - contacts inside one body are left to the vertex spheres of SoftBodyCollision
+ * - with start of step positions, triangle boxes are swept (start + end) and pairs that are not close at the end
+ *   get a continuous test, so fast vertices can not tunnel through a surface within one step
+ */
+class SoftBodyTriangleCollision
+{
+public:
+    //=======[adjustable parameters]========
+    bool ENABLED = true;
+    bool CCD = true; // continuous vertex-triangle and edge-edge tests over the step
+    int ITERATIONS = 2; // narrow phase passes per step, a pass stops early when it finds no contact
+    float THICKNESS = 0.01f; // surfaces closer than this are pushed apart
+    float RESTITUTION = 0.0f;
+    float FRICTION = 0.2f;
+    float REBUILD_THRESHOLD = 1.5f; // see BVH::REBUILD_THRESHOLD
+    //======================================
+
+    // stats of last resolve, contacts are summed over the passes
+    int lastBodyPairs = 0;
+    int lastVertexTriangleContacts = 0;
+    int lastEdgeEdgeContacts = 0;
+    int lastCCDContacts = 0; // contacts only found by the continuous test, included in the two above
+    double lastRefitMs = 0.0;   // all surface trees
+    double lastRebuildMs = 0.0; // all surface trees, 0 when nothing was rebuilt
+    int totalRefits = 0;
+    int totalRebuilds = 0;
+
+    // body pairs (first < second) that touched in the last resolve, the contact graph for islands
+    std::vector<std::pair<int, int>> bodyContacts;
+
+    /**
+     * Register the faces of a body
+     * - mesh - faces, edges and the edge -> face CSR are taken from it
+     * - vertexOffset - first vertex of the body in the pool
+     * - body - index of the body, reported in bodyContacts
+     */
+    void addSurface(const SoftBodyMesh &mesh, size_t vertexOffset, int body)
+    {
+        Surface surface;
+        surface.body = body;
+        surface.vertexOffset = (unsigned int)vertexOffset;
+        surface.vertexCount = (unsigned int)mesh.vertices.size();
+        size_t triCount = mesh.faces.size() / 9;
+        surface.triangles.resize(triCount * 3);
+        for (size_t c = 0; c < triCount * 3; c++)
+        {
+            surface.triangles[c] = mesh.faces[c * 3] + surface.vertexOffset;
+        }
+        surface.edges.resize(mesh.edges.size());
+        for (size_t e = 0; e < mesh.edges.size(); e++)
+        {
+            surface.edges[e] = mesh.edges[e] + surface.vertexOffset;
+        }
+
+        // every edge is tested through the first triangle that has it, without the CSR all three edges are tested
+        size_t edgeCount = mesh.edges.size() / 2;
+        if (mesh.edgeFaceStart.size() == edgeCount + 1)
+        {
+            surface.ownedEdges.assign(triCount, 0);
+            for (size_t e = 0; e < edgeCount; e++)
+            {
+                if (mesh.edgeFaceStart[e] == mesh.edgeFaceStart[e + 1])
+                    continue;
+                unsigned int t = mesh.edgeFaces[mesh.edgeFaceStart[e]];
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int a = mesh.faces[t * 9 + k * 3], b = mesh.faces[t * 9 + ((k + 1) % 3) * 3];
+                    if (std::min(a, b) == mesh.edges[e * 2] && std::max(a, b) == mesh.edges[e * 2 + 1])
+                        surface.ownedEdges[t] |= (uint8_t)(1 << k);
+                }
+            }
+        }
+        else
+        {
+            surface.ownedEdges.assign(triCount, 7);
+        }
+        surface.triangleBoxes.resize(triCount);
+        surfaces.push_back(std::move(surface));
+    }
+
+    size_t surfaceCount() const
+    {
+        return surfaces.size();
+    }
+
+    bool needsStartPositions() const
+    {
+        return ENABLED && CCD && surfaces.size() >= 2;
+    }
+
+    // positions were written from outside the step (checkpoint, playback), every tree is refit next resolve, asleep or not
+    void invalidateTrees()
+    {
+        for (Surface &surface : surfaces)
+        {
+            surface.stale = true;
+        }
+    }
+
+    /**
+     * Push apart surfaces of different bodies
+     * - x/v - whole pool, end of step
+     * - x0 - whole pool at the start of the step, nullptr disables the continuous test
+     * - bodyAsleep (optional, per body) - sleeping surfaces are not refit, two sleeping surfaces are never tested
+     */
+    void resolve(glm::vec3 *x, glm::vec3 *v, const glm::vec3 *x0 = nullptr, const uint8_t *bodyAsleep = nullptr)
+    {
+        lastBodyPairs = lastVertexTriangleContacts = lastEdgeEdgeContacts = lastCCDContacts = 0;
+        lastRefitMs = lastRebuildMs = 0.0;
+        bodyContacts.clear();
+        if (!ENABLED || surfaces.size() < 2)
+            return;
+        if (!CCD)
+            x0 = nullptr;
+
+        // a correction can push a vertex through another triangle, so the narrow phase runs again on the corrected positions
+        for (int iteration = 0; iteration < std::max(ITERATIONS, 1); iteration++)
+        {
+            refitTrees(x, x0, bodyAsleep);
+            findPairs(bodyAsleep);
+            lastBodyPairs = std::max(lastBodyPairs, (int)pairs.size());
+
+            contacts.clear();
+            for (auto &pair : pairs)
+            {
+                size_t before = contacts.size();
+                collideVertices(surfaces[pair.first], surfaces[pair.second], x, x0);
+                collideVertices(surfaces[pair.second], surfaces[pair.first], x, x0);
+                collideEdges(surfaces[pair.first], surfaces[pair.second], x, x0);
+                if (contacts.size() > before)
+                {
+                    int a = surfaces[pair.first].body, b = surfaces[pair.second].body;
+                    std::pair<int, int> touched(std::min(a, b), std::max(a, b));
+                    if (std::find(bodyContacts.begin(), bodyContacts.end(), touched) == bodyContacts.end())
+                        bodyContacts.push_back(touched);
+                }
+            }
+            for (const Contact &contact : contacts)
+            {
+                applyContact(contact, x, v);
+            }
+            if (contacts.empty())
+                break;
+        }
+    }
+
+private:
+    struct Surface
+    {
+        unsigned int vertexOffset = 0, vertexCount = 0;
+        int body = -1;
+        std::vector<unsigned int> triangles; // 3 pool vertex indices per triangle
+        std::vector<unsigned int> edges;     // 2 pool vertex indices per edge
+        std::vector<uint8_t> ownedEdges;     // bit k: edge (k, k + 1) of the triangle is tested through it
+        std::vector<AABB> triangleBoxes;     // scratch of the refit
+        BVH tree;
+        bool stale = false;                  // refit even while the body sleeps
+    };
+
+    /**
+     * a - vertex or edge points of one side, b - triangle or edge points of the other
+     * contact point of a side = sum of weight * position, normal points from b to a
+     */
+    struct Contact
+    {
+        unsigned int a[2], b[3];
+        float wa[2], wb[3];
+        int countA, countB;
+        glm::vec3 normal;
+    };
+
+    std::vector<Surface> surfaces;
+    BVH topLevel;
+    std::vector<AABB> surfaceBoxes;
+    std::vector<std::pair<int, int>> pairs;
+    std::vector<Contact> contacts;
+    std::vector<std::vector<Contact>> threadContacts;
+
+    // triangle boxes cover start and end of the step when x0 is given (swept AABB)
+    void refitTrees(const glm::vec3 *x, const glm::vec3 *x0, const uint8_t *bodyAsleep)
+    {
+        for (Surface &surface : surfaces)
+        {
+            // a sleeping body has not moved since its last refit, unless its positions were overwritten
+            if (bodyAsleep && bodyAsleep[surface.body] && !surface.tree.empty() && !surface.stale)
+                continue;
+            surface.stale = false;
+            const unsigned int *tri = surface.triangles.data();
+            AABB *boxes = surface.triangleBoxes.data();
+            long long triCount = (long long)surface.triangleBoxes.size();
+            float margin = THICKNESS;
+#pragma omp parallel for if (triCount > 4096)
+            for (long long t = 0; t < triCount; t++)
+            {
+                AABB box;
+                box.grow(x[tri[t * 3]]);
+                box.grow(x[tri[t * 3 + 1]]);
+                box.grow(x[tri[t * 3 + 2]]);
+                if (x0)
+                {
+                    box.grow(x0[tri[t * 3]]);
+                    box.grow(x0[tri[t * 3 + 1]]);
+                    box.grow(x0[tri[t * 3 + 2]]);
+                }
+                box.inflate(margin);
+                boxes[t] = box;
+            }
+
+            surface.tree.REBUILD_THRESHOLD = REBUILD_THRESHOLD;
+            int refits = surface.tree.refitCount;
+            if (surface.tree.update(surface.triangleBoxes))
+            {
+                lastRebuildMs += surface.tree.lastRebuildMs;
+                totalRebuilds++;
+            }
+            if (surface.tree.refitCount > refits)
+            {
+                lastRefitMs += surface.tree.lastRefitMs;
+                totalRefits++;
+            }
+        }
+    }
+
+    // body pairs whose surface bounds overlap and that are not both asleep, first < second
+    void findPairs(const uint8_t *bodyAsleep)
+    {
+        surfaceBoxes.resize(surfaces.size());
+        for (size_t s = 0; s < surfaces.size(); s++)
+        {
+            surfaceBoxes[s] = surfaces[s].tree.empty() ? AABB() : surfaces[s].tree.bounds();
+        }
+        topLevel.update(surfaceBoxes);
+
+        pairs.clear();
+        for (size_t s = 0; s < surfaces.size(); s++)
+        {
+            if (surfaces[s].tree.empty())
+                continue;
+            topLevel.query(surfaceBoxes[s], [&](unsigned int other)
+                           {
+                               if (other <= s || surfaces[other].tree.empty())
+                                   return;
+                               if (bodyAsleep && bodyAsleep[surfaces[s].body] && bodyAsleep[surfaces[other].body])
+                                   return;
+                               pairs.emplace_back((int)s, (int)other); });
+        }
+    }
+
+    // x0 == nullptr runs the proximity test only
+    void collideVertices(const Surface &points, const Surface &mesh, const glm::vec3 *x, const glm::vec3 *x0)
+    {
+        const AABB &bounds = mesh.tree.bounds();
+        float thickness = THICKNESS;
+        beginCollect();
+#pragma omp parallel
+        {
+            std::vector<Contact> &local = threadContacts[omp_get_thread_num()];
+            int ccdHits = 0;
+#pragma omp for schedule(dynamic, 256)
+            for (long long k = 0; k < (long long)points.vertexCount; k++)
+            {
+                unsigned int i = points.vertexOffset + (unsigned int)k;
+                glm::vec3 p = x[i];
+                AABB box;
+                box.grow(p);
+                if (x0)
+                    box.grow(x0[i]);
+                box.inflate(thickness);
+                if (!box.overlaps(bounds))
+                    continue;
+                mesh.tree.query(box, [&](unsigned int t)
+                                {
+                                    const unsigned int *tri = &mesh.triangles[t * 3];
+                                    Contact contact;
+                                    contact.a[0] = i;
+                                    contact.wa[0] = 1.0f;
+                                    contact.countA = 1;
+                                    contact.countB = 3;
+                                    for (int corner = 0; corner < 3; corner++)
+                                    {
+                                        contact.b[corner] = tri[corner];
+                                    }
+
+                                    glm::vec3 bary;
+                                    glm::vec3 c = Geometry::closestPointOnTriangle(p, x[tri[0]], x[tri[1]], x[tri[2]], bary);
+                                    glm::vec3 d = p - c;
+                                    float dist_sq = glm::dot(d, d);
+                                    if (dist_sq < thickness * thickness)
+                                    {
+                                        glm::vec3 normal = glm::cross(x[tri[1]] - x[tri[0]], x[tri[2]] - x[tri[0]]);
+                                        float dist = std::sqrt(dist_sq);
+                                        if (dist > 1e-6f)
+                                            normal = d / dist;
+                                        else if (glm::dot(normal, normal) > 1e-20f)
+                                            normal = glm::normalize(normal);
+                                        else
+                                            return;
+                                        for (int corner = 0; corner < 3; corner++)
+                                            contact.wb[corner] = bary[corner];
+                                        contact.normal = normal;
+                                        if (x0)
+                                            keepStartSide(contact, x0);
+                                        local.push_back(contact);
+                                        return;
+                                    }
+                                    if (x0 && sweptVertexTriangle(contact, x0, x, thickness))
+                                    {
+                                        local.push_back(contact);
+                                        ccdHits++;
+                                    } });
+            }
+#pragma omp atomic
+            lastCCDContacts += ccdHits;
+        }
+        endCollect(lastVertexTriangleContacts);
+    }
+
+    // edges of a against the edges of the triangles of b, end point contacts are left to collideVertices
+    void collideEdges(const Surface &a, const Surface &b, const glm::vec3 *x, const glm::vec3 *x0)
+    {
+        const AABB &bounds = b.tree.bounds();
+        float thickness = THICKNESS;
+        beginCollect();
+#pragma omp parallel
+        {
+            std::vector<Contact> &local = threadContacts[omp_get_thread_num()];
+            int ccdHits = 0;
+#pragma omp for schedule(dynamic, 256)
+            for (long long e = 0; e < (long long)(a.edges.size() / 2); e++)
+            {
+                unsigned int p0 = a.edges[e * 2], p1 = a.edges[e * 2 + 1];
+                AABB box;
+                box.grow(x[p0]);
+                box.grow(x[p1]);
+                if (x0)
+                {
+                    box.grow(x0[p0]);
+                    box.grow(x0[p1]);
+                }
+                box.inflate(thickness);
+                if (!box.overlaps(bounds))
+                    continue;
+                b.tree.query(box, [&](unsigned int t)
+                             {
+                                 const unsigned int *tri = &b.triangles[t * 3];
+                                 for (int k = 0; k < 3; k++)
+                                 {
+                                     if (!(b.ownedEdges[t] & (1 << k)))
+                                         continue;
+                                     unsigned int q0 = tri[k], q1 = tri[(k + 1) % 3];
+
+                                     Contact contact;
+                                     contact.a[0] = p0;
+                                     contact.a[1] = p1;
+                                     contact.countA = 2;
+                                     contact.b[0] = q0;
+                                     contact.b[1] = q1;
+                                     contact.countB = 2;
+
+                                     float s, u;
+                                     glm::vec3 c0, c1;
+                                     Geometry::closestPointsOnSegments(x[p0], x[p1], x[q0], x[q1], s, u, c0, c1);
+                                     glm::vec3 d = c0 - c1;
+                                     float dist_sq = glm::dot(d, d);
+                                     if (interior(s) && interior(u) && dist_sq < thickness * thickness && dist_sq >= 1e-12f)
+                                     {
+                                         setSegmentWeights(contact, s, u);
+                                         contact.normal = d / std::sqrt(dist_sq);
+                                         if (x0)
+                                             keepStartSide(contact, x0);
+                                         local.push_back(contact);
+                                     }
+                                     else if (x0 && box.overlaps(sweptBox(x0, x, q0, q1, thickness)) && sweptEdgeEdge(contact, x0, x, thickness))
+                                     {
+                                         local.push_back(contact);
+                                         ccdHits++;
+                                     }
+                                 } });
+            }
+#pragma omp atomic
+            lastCCDContacts += ccdHits;
+        }
+        endCollect(lastEdgeEdgeContacts);
+    }
+
+    /**
+     * Vertex a[0] moving through triangle b[0..2] between x0 and x
+     * - the first time of coplanarity where the vertex lies on the triangle is the time of impact
+     * - the normal points to the side the vertex started on, so applyContact pushes a tunnelled vertex back
+     */
+    static bool sweptVertexTriangle(Contact &contact, const glm::vec3 *x0, const glm::vec3 *x, float thickness)
+    {
+        unsigned int i = contact.a[0], t0 = contact.b[0], t1 = contact.b[1], t2 = contact.b[2];
+        float times[3];
+        int count = coplanarTimes(x0[t1] - x0[t0], (x[t1] - x[t0]) - (x0[t1] - x0[t0]),
+                                  x0[t2] - x0[t0], (x[t2] - x[t0]) - (x0[t2] - x0[t0]),
+                                  x0[i] - x0[t0], (x[i] - x[t0]) - (x0[i] - x0[t0]), times);
+        for (int k = 0; k < count; k++)
+        {
+            float t = times[k];
+            glm::vec3 p = glm::mix(x0[i], x[i], t);
+            glm::vec3 a = glm::mix(x0[t0], x[t0], t), b = glm::mix(x0[t1], x[t1], t), c = glm::mix(x0[t2], x[t2], t);
+            glm::vec3 bary;
+            glm::vec3 closest = Geometry::closestPointOnTriangle(p, a, b, c, bary);
+            if (glm::dot(p - closest, p - closest) >= thickness * thickness)
+                continue;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float len = glm::length(normal);
+            if (len < 1e-12f)
+                continue;
+            normal /= len;
+            glm::vec3 start = x0[i] - (bary.x * x0[t0] + bary.y * x0[t1] + bary.z * x0[t2]);
+            if (glm::dot(normal, start) < 0.0f)
+                normal = -normal;
+            contact.wb[0] = bary.x;
+            contact.wb[1] = bary.y;
+            contact.wb[2] = bary.z;
+            contact.normal = normal;
+            return true;
+        }
+        return false;
+    }
+
+    // edge a[0]a[1] crossing edge b[0]b[1] between x0 and x, same idea as sweptVertexTriangle
+    static bool sweptEdgeEdge(Contact &contact, const glm::vec3 *x0, const glm::vec3 *x, float thickness)
+    {
+        unsigned int p0 = contact.a[0], p1 = contact.a[1], q0 = contact.b[0], q1 = contact.b[1];
+        float times[3];
+        int count = coplanarTimes(x0[p1] - x0[p0], (x[p1] - x[p0]) - (x0[p1] - x0[p0]),
+                                  x0[q1] - x0[q0], (x[q1] - x[q0]) - (x0[q1] - x0[q0]),
+                                  x0[q0] - x0[p0], (x[q0] - x[p0]) - (x0[q0] - x0[p0]), times);
+        for (int k = 0; k < count; k++)
+        {
+            float t = times[k];
+            glm::vec3 a0 = glm::mix(x0[p0], x[p0], t), a1 = glm::mix(x0[p1], x[p1], t);
+            glm::vec3 b0 = glm::mix(x0[q0], x[q0], t), b1 = glm::mix(x0[q1], x[q1], t);
+            float s, u;
+            glm::vec3 c0, c1;
+            Geometry::closestPointsOnSegments(a0, a1, b0, b1, s, u, c0, c1);
+            if (!interior(s) || !interior(u) || glm::dot(c0 - c1, c0 - c1) >= thickness * thickness)
+                continue;
+            glm::vec3 normal = glm::cross(a1 - a0, b1 - b0);
+            float len = glm::length(normal);
+            if (len < 1e-12f)
+                continue;
+            normal /= len;
+            glm::vec3 start = glm::mix(x0[p0], x0[p1], s) - glm::mix(x0[q0], x0[q1], u);
+            if (glm::dot(normal, start) < 0.0f)
+                normal = -normal;
+            setSegmentWeights(contact, s, u);
+            contact.normal = normal;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Times in [0, 1] where (x1 + t v1) x (x2 + t v2) . (x3 + t v3) = 0, ascending, returns how many
+     * - the cubic is split at the roots of its derivative into monotone pieces, each piece with a sign change is bisected
+     */
+    static int coplanarTimes(const glm::vec3 &x1, const glm::vec3 &v1, const glm::vec3 &x2, const glm::vec3 &v2,
+                             const glm::vec3 &x3, const glm::vec3 &v3, float times[3])
+    {
+        glm::vec3 c0 = glm::cross(x1, x2);
+        glm::vec3 c1 = glm::cross(x1, v2) + glm::cross(v1, x2);
+        glm::vec3 c2 = glm::cross(v1, v2);
+        double k0 = glm::dot(c0, x3);
+        double k1 = glm::dot(c0, v3) + glm::dot(c1, x3);
+        double k2 = glm::dot(c1, v3) + glm::dot(c2, x3);
+        double k3 = glm::dot(c2, v3);
+        auto f = [&](double t)
+        { return ((k3 * t + k2) * t + k1) * t + k0; };
+
+        // breakpoints: 0, extrema of the cubic inside (0, 1), 1
+        double breaks[4] = {0.0, 0.0, 0.0, 1.0};
+        int breakCount = 1;
+        double qa = 3.0 * k3, qb = 2.0 * k2, qc = k1;
+        if (std::abs(qa) > 1e-30)
+        {
+            double disc = qb * qb - 4.0 * qa * qc;
+            if (disc > 0.0)
+            {
+                double root = std::sqrt(disc);
+                double e0 = (-qb - root) / (2.0 * qa), e1 = (-qb + root) / (2.0 * qa);
+                if (e0 > e1)
+                    std::swap(e0, e1);
+                if (e0 > 0.0 && e0 < 1.0)
+                    breaks[breakCount++] = e0;
+                if (e1 > 0.0 && e1 < 1.0)
+                    breaks[breakCount++] = e1;
+            }
+        }
+        else if (std::abs(qb) > 1e-30)
+        {
+            double e = -qc / qb;
+            if (e > 0.0 && e < 1.0)
+                breaks[breakCount++] = e;
+        }
+        breaks[breakCount++] = 1.0;
+
+        int count = 0;
+        for (int b = 0; b + 1 < breakCount; b++)
+        {
+            double lo = breaks[b], hi = breaks[b + 1];
+            double flo = f(lo), fhi = f(hi);
+            if (flo == 0.0)
+            {
+                if (count == 0 || times[count - 1] != (float)lo)
+                    times[count++] = (float)lo;
+                continue;
+            }
+            if ((flo < 0.0) == (fhi < 0.0) && fhi != 0.0)
+                continue;
+            for (int iter = 0; iter < 24; iter++) // 2^-24, float resolution of t
+            {
+                double mid = 0.5 * (lo + hi);
+                double fmid = f(mid);
+                if ((fmid < 0.0) == (flo < 0.0) && fmid != 0.0)
+                {
+                    lo = mid;
+                    flo = fmid;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            if (count < 3)
+                times[count++] = (float)hi;
+        }
+        return count;
+    }
+
+    // the query only culls by triangle, an edge pair is culled again before the cubic
+    static AABB sweptBox(const glm::vec3 *x0, const glm::vec3 *x, unsigned int a, unsigned int b, float margin)
+    {
+        AABB box;
+        box.grow(x0[a]);
+        box.grow(x0[b]);
+        box.grow(x[a]);
+        box.grow(x[b]);
+        box.inflate(margin);
+        return box;
+    }
+
+    // a pair that is close at the end of the step may already have crossed, push it back to where it came from
+    static void keepStartSide(Contact &contact, const glm::vec3 *x0)
+    {
+        glm::vec3 start(0.0f);
+        for (int k = 0; k < contact.countA; k++)
+            start += contact.wa[k] * x0[contact.a[k]];
+        for (int k = 0; k < contact.countB; k++)
+            start -= contact.wb[k] * x0[contact.b[k]];
+        if (glm::dot(contact.normal, start) < 0.0f)
+            contact.normal = -contact.normal;
+    }
+
+    static bool interior(float s)
+    {
+        return s > 1e-3f && s < 1.0f - 1e-3f;
+    }
+
+    static void setSegmentWeights(Contact &contact, float s, float u)
+    {
+        contact.wa[0] = 1.0f - s;
+        contact.wa[1] = s;
+        contact.wb[0] = 1.0f - u;
+        contact.wb[1] = u;
+    }
+
+    void beginCollect()
+    {
+        threadContacts.resize(omp_get_max_threads());
+        for (auto &local : threadContacts)
+        {
+            local.clear();
+        }
+    }
+
+    // thread lists arrive in schedule order, every contact of a pass has a distinct vertex tuple to sort by
+    void endCollect(int &counter)
+    {
+        size_t first = contacts.size();
+        for (auto &local : threadContacts)
+        {
+            counter += (int)local.size();
+            contacts.insert(contacts.end(), local.begin(), local.end());
+        }
+        std::sort(contacts.begin() + first, contacts.end(), [](const Contact &l, const Contact &r)
+                  {
+                      if (!std::equal(l.a, l.a + l.countA, r.a))
+                          return std::lexicographical_compare(l.a, l.a + l.countA, r.a, r.a + r.countA);
+                      return std::lexicographical_compare(l.b, l.b + l.countB, r.b, r.b + r.countB); });
+    }
+
+    /**
+     * Equal mass vertices, the correction of each vertex is scaled by its weight in the contact point
+     * - position: close the overlap along the normal
+     * - velocity: remove the approaching normal velocity (plus restitution) and a fraction of the tangential one
+     */
+    void applyContact(const Contact &contact, glm::vec3 *x, glm::vec3 *v) const
+    {
+        glm::vec3 xa(0.0f), xb(0.0f), va(0.0f), vb(0.0f);
+        float weight_sq = 0.0f;
+        for (int k = 0; k < contact.countA; k++)
+        {
+            xa += contact.wa[k] * x[contact.a[k]];
+            va += contact.wa[k] * v[contact.a[k]];
+            weight_sq += contact.wa[k] * contact.wa[k];
+        }
+        for (int k = 0; k < contact.countB; k++)
+        {
+            xb += contact.wb[k] * x[contact.b[k]];
+            vb += contact.wb[k] * v[contact.b[k]];
+            weight_sq += contact.wb[k] * contact.wb[k];
+        }
+        if (weight_sq <= 0.0f)
+            return;
+
+        // earlier contacts may already have separated this one
+        float depth = THICKNESS - glm::dot(xa - xb, contact.normal);
+        if (depth > 0.0f)
+        {
+            glm::vec3 correction = contact.normal * (depth / weight_sq);
+            for (int k = 0; k < contact.countA; k++)
+                x[contact.a[k]] += contact.wa[k] * correction;
+            for (int k = 0; k < contact.countB; k++)
+                x[contact.b[k]] -= contact.wb[k] * correction;
+        }
+
+        glm::vec3 rel = va - vb;
+        float approach = glm::dot(rel, contact.normal);
+        if (approach >= 0.0f)
+            return;
+        glm::vec3 tangent = rel - approach * contact.normal;
+        glm::vec3 impulse = (-(1.0f + RESTITUTION) * approach * contact.normal - FRICTION * tangent) / weight_sq;
+        for (int k = 0; k < contact.countA; k++)
+            v[contact.a[k]] += contact.wa[k] * impulse;
+        for (int k = 0; k < contact.countB; k++)
+            v[contact.b[k]] -= contact.wb[k] * impulse;
+    }
+};
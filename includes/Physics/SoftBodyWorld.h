@@ -0,0 +1,649 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#include <omp.h>
+
+#include <objectloader.h>
+#include <Physics/ShapeMatching.h>
+#include <Physics/EmbeddedLattice.h>
+#include <Physics/ImplicitSpringSolver.h>
+#include <Physics/ProjectiveDynamicsSolver.h>
+#include <Physics/SoftBodyCollision.h>
+#include <Physics/SoftBodyTriangleCollision.h>
+#include <Physics/SDFCollider.h>
+
+enum SoftBodyIntegrator
+{
+    EXPLICIT_SPRING,    // symplectic euler on springs, needs small steps (1/720)
+    IMPLICIT_EULER,     // backward euler + CG on springs, stable at 1/60
+    PROJECTIVE_DYNAMICS // prefactored local/global solver for fixed topology bodies
+};
+
+/**
+ * World that owns the simulation state of every soft body in the scene.
+ * - positions/velocities of all bodies live in one contiguous pool
+ * - each body only keeps its range into the pool
+ * - bodies are stepped in parallel, largest first, with dynamic scheduling
+ * - vertex contacts (self and body vs body) are resolved over the whole pool after the step,
+ *   then triangle contacts between bodies that have faces
+ * - bodies that touch form islands, an island whose bodies stayed calm for SLEEP_STEPS steps falls asleep;
+ *   sleeping bodies skip their solver and collision work and wake on contact or user impulse
+ */
+class SoftBodyWorld
+{
+public:
+    // slice of the shared pools that belongs to one body
+    struct BodyRange
+    {
+        size_t vertexOffset;     // first vertex in positions/velocities
+        size_t vertexCount;
+        size_t constraintOffset; // first constraint in constraints
+        size_t constraintCount;
+        size_t colorOffset; // first batch offset in constraintColors (colorCount + 1 entries)
+        size_t colorCount;
+        size_t bendOffset; // first bend pair in bendConstraints
+        size_t bendCount;
+        size_t dihedralOffset; // first dihedral in dihedrals
+        size_t dihedralCount;
+        size_t dihedralColorOffset; // first batch offset in dihedralColors (dihedralColorCount + 1 entries)
+        size_t dihedralColorCount;
+        glm::vec3 x_cm_zero; // rest center of mass
+        int embedding = -1;  // index in embeddings when the body is a cage driving a render mesh
+        SoftBodyIntegrator integrator = EXPLICIT_SPRING;
+        int implicitSolver = -1; // index in implicitSolvers
+        int pdSolver = -1;       // index in pdSolvers
+        bool asleep = false;
+        int calmSteps = 0; // consecutive steps with kinetic energy under SLEEP_ENERGY
+    };
+
+    //======[Shared pools]===========
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
+    std::vector<glm::vec3> x_offset_zero; // rest offset from center of mass
+    std::vector<glm::vec3> startPositions; // positions at the start of the last step, for continuous collision
+    std::vector<Constraint> constraints;  // vertex indices are local to its body
+    std::vector<unsigned int> constraintColors; // per body batch offsets, local to its constraint range
+    std::vector<Constraint> bendConstraints;
+    std::vector<DihedralConstraint> dihedrals;  // vertex indices are local to its body
+    std::vector<unsigned int> dihedralColors; // per body batch offsets, local to its dihedral range
+    std::vector<BodyRange> bodies;
+    std::vector<int> vertexBody; // owning body of every pool vertex
+    std::vector<uint8_t> bodyAsleep; // mirror of BodyRange::asleep handed to the collision passes
+    std::vector<int> schedule; // body indices sorted by descending vertex count
+    std::vector<LatticeEmbedding> embeddings;
+    std::vector<std::unique_ptr<ImplicitSpringSolver>> implicitSolvers;
+    std::vector<std::unique_ptr<ProjectiveDynamicsSolver>> pdSolvers;
+    SoftBodyCollision collision; // contact parameters live in here (RADIUS, FRICTION, ...)
+    SoftBodyTriangleCollision triangleCollision; // THICKNESS, BVH rebuild threshold and refit/rebuild stats
+    const ColliderSet *colliders = nullptr; // static geometry shared with the fluid, not owned
+
+    //=======[adjustable parameters]========
+    float GRAVITY = 0.0f;
+    float SPRING_CONSTANT = 1.0f;
+    float SPRING_DAMPING = 0.9f;
+    float SHAPE_STIFFNESS = 0.00005f;
+    float BEND_STIFFNESS = 0.02f; // dihedral angle springs, 0 disables bending
+    float BEND_DAMPING = 0.01f;
+    float BEND_STABILITY = 0.02f; // cap of stiffness * dt^2 per stencil, a vertex adds up the caps of all its stencils
+    float RESTITUTION = 1.0f; // for bounding box and static colliders
+    int PARALLEL_BATCH_MIN_CONSTRAINTS = 8192; // smaller bodies are not worth a parallel region per color
+
+    glm::vec3 BOX_MIN = glm::vec3(-2.0f, -2.0f, -2.0f);
+    glm::vec3 BOX_MAX = glm::vec3(2.0f, 2.0f, 2.0f);
+
+    bool SLEEPING = true;
+    float SLEEP_ENERGY = 1e-6f; // kinetic energy per vertex (unit mass) under which a body counts as calm
+    int SLEEP_STEPS = 120;      // calm steps of every body of an island before it sleeps
+    //======================================
+
+    // stats of last step
+    int lastIslandCount = 0;
+
+public:
+    /**
+     * Copy a loaded mesh into the pools, return its body index
+     * - mesh - source mesh (rest shape is taken from its current vertices)
+     * - offset - translation applied to the spawned body
+     */
+    size_t addBody(const SoftBodyMesh &mesh, glm::vec3 offset = glm::vec3(0.0f))
+    {
+        BodyRange body;
+        body.vertexOffset = positions.size();
+        body.vertexCount = mesh.vertices.size();
+        body.constraintOffset = constraints.size();
+        body.constraintCount = mesh.structuralPairs.size();
+        body.bendOffset = bendConstraints.size();
+        body.bendCount = mesh.bendPairs.size();
+        body.dihedralOffset = dihedrals.size();
+        body.dihedralCount = mesh.dihedrals.size();
+        body.x_cm_zero = mesh.x_cm_zero + offset;
+
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            positions.push_back(mesh.vertices[i] + offset);
+            velocities.push_back(i < mesh.velocities.size() ? mesh.velocities[i] : glm::vec3(0.0f));
+            x_offset_zero.push_back(mesh.x_offset_zero[i]);
+            vertexBody.push_back((int)bodies.size());
+        }
+        constraints.insert(constraints.end(), mesh.structuralPairs.begin(), mesh.structuralPairs.end());
+        bendConstraints.insert(bendConstraints.end(), mesh.bendPairs.begin(), mesh.bendPairs.end());
+        dihedrals.insert(dihedrals.end(), mesh.dihedrals.begin(), mesh.dihedrals.end());
+
+        body.colorOffset = constraintColors.size();
+        body.colorCount = appendColors(mesh.structuralColors, mesh.structuralPairs.size(), constraintColors);
+        body.dihedralColorOffset = dihedralColors.size();
+        body.dihedralColorCount = appendColors(mesh.dihedralColors, mesh.dihedrals.size(), dihedralColors);
+
+        if (!mesh.faces.empty())
+        {
+            triangleCollision.addSurface(mesh, body.vertexOffset, (int)bodies.size());
+        }
+
+        bodies.push_back(body);
+        bodyAsleep.push_back(0);
+        rebuildSchedule();
+        return bodies.size() - 1;
+    }
+
+    /**
+     * Simulate a dense mesh through a coarse voxel cage instead of its own vertices
+     * - resolution - cage cells along the longest side of the mesh
+     * syncMesh() rebuilds the render vertices from the cage
+     */
+    size_t addEmbeddedBody(const SoftBodyMesh &mesh, int resolution, glm::vec3 offset = glm::vec3(0.0f))
+    {
+        SoftBodyMesh cage;
+        LatticeEmbedding embedding;
+        if (!EmbeddedLattice::buildCage(mesh, resolution, cage, embedding))
+        {
+            return addBody(mesh, offset);
+        }
+
+        size_t body_idx = addBody(cage, offset);
+        bodies[body_idx].embedding = (int)embeddings.size();
+        embeddings.push_back(std::move(embedding));
+        return body_idx;
+    }
+
+    /**
+     * Choose how a body integrates its constraints
+     * - timestep - expected step size, lets PROJECTIVE_DYNAMICS factor its system right away
+     */
+    void setIntegrator(size_t body_idx, SoftBodyIntegrator integrator, float timestep = 0.0f)
+    {
+        BodyRange &body = bodies[body_idx];
+        body.integrator = integrator;
+        if (integrator == IMPLICIT_EULER && body.implicitSolver < 0)
+        {
+            body.implicitSolver = (int)implicitSolvers.size();
+            implicitSolvers.push_back(std::make_unique<ImplicitSpringSolver>());
+        }
+        if (integrator == PROJECTIVE_DYNAMICS)
+        {
+            if (body.pdSolver < 0)
+            {
+                body.pdSolver = (int)pdSolvers.size();
+                pdSolvers.push_back(std::make_unique<ProjectiveDynamicsSolver>());
+            }
+            if (timestep > 0.0f)
+            {
+                pdSolvers[body.pdSolver]->prefactor(body.vertexCount, &constraints[body.constraintOffset], body.constraintCount,
+                                                    bendConstraints.data() + body.bendOffset, body.bendCount, timestep);
+            }
+        }
+    }
+
+    // CG iterations spent by all implicit bodies in the last step
+    int lastCGIterations() const
+    {
+        int total = 0;
+        for (auto &body : bodies)
+        {
+            if (body.integrator == IMPLICIT_EULER)
+                total += implicitSolvers[body.implicitSolver]->lastIterations;
+        }
+        return total;
+    }
+
+    // update simulation step of all bodies
+    void step(float deltaTime)
+    {
+        bool sweep = triangleCollision.needsStartPositions();
+        if (sweep)
+        {
+            startPositions.resize(positions.size());
+            std::copy(positions.begin(), positions.end(), startPositions.begin());
+        }
+
+        // with fewer awake bodies than threads a region per body would leave cores idle (a nested region
+        // only gets a team of one), so the bodies go one after the other and each takes the whole team
+        if (awakeBodies() < omp_get_max_threads())
+        {
+            for (int s = 0; s < (int)schedule.size(); s++)
+            {
+                if (!bodies[schedule[s]].asleep)
+                    stepBody(bodies[schedule[s]], deltaTime, true);
+            }
+        }
+        else
+        {
+            // one body per task, biggest bodies are handed out first so that the
+            // small ones fill the gaps at the end of the step
+#pragma omp parallel for schedule(dynamic, 1)
+            for (int s = 0; s < (int)schedule.size(); s++)
+            {
+                if (!bodies[schedule[s]].asleep)
+                    stepBody(bodies[schedule[s]], deltaTime, false);
+            }
+        }
+
+        resolveContacts(sweep ? startPositions.data() : nullptr);
+        updateSleep();
+    }
+
+    // add the same velocity to every vertex (user impulse), wakes every body
+    void addVelocity(glm::vec3 dv)
+    {
+        if (dv == glm::vec3(0.0f))
+            return;
+        for (size_t b = 0; b < bodies.size(); b++)
+        {
+            wake(b);
+        }
+
+#pragma omp parallel for
+        for (int i = 0; i < (int)velocities.size(); i++)
+        {
+            velocities[i] += dv;
+        }
+    }
+
+    // write simulated state of one body back into its mesh (for rendering)
+    void syncMesh(size_t body_idx, SoftBodyMesh &mesh) const
+    {
+        const BodyRange &body = bodies[body_idx];
+        if (body.embedding >= 0)
+        {
+            const LatticeEmbedding &embedding = embeddings[body.embedding];
+            mesh.vertices.resize(embedding.renderVertexCount);
+            mesh.velocities.resize(embedding.renderVertexCount);
+            EmbeddedLattice::reconstruct(embedding, &positions[body.vertexOffset], mesh.vertices.data());
+            EmbeddedLattice::reconstruct(embedding, &velocities[body.vertexOffset], mesh.velocities.data());
+            return;
+        }
+        mesh.vertices.assign(positions.begin() + body.vertexOffset, positions.begin() + body.vertexOffset + body.vertexCount);
+        mesh.velocities.assign(velocities.begin() + body.vertexOffset, velocities.begin() + body.vertexOffset + body.vertexCount);
+    }
+
+    size_t totalVertices() const
+    {
+        return positions.size();
+    }
+
+    void wake(size_t body_idx)
+    {
+        bodies[body_idx].asleep = false;
+        bodies[body_idx].calmSteps = 0;
+        bodyAsleep[body_idx] = 0;
+    }
+
+    bool isAsleep(size_t body_idx) const
+    {
+        return bodies[body_idx].asleep;
+    }
+
+    int asleepBodies() const
+    {
+        int count = 0;
+        for (auto &body : bodies)
+        {
+            count += body.asleep ? 1 : 0;
+        }
+        return count;
+    }
+
+    int awakeBodies() const
+    {
+        return (int)bodies.size() - asleepBodies();
+    }
+
+private:
+    std::vector<int> islandParent; // union find scratch of updateSleep
+    std::vector<uint8_t> islandCalm;
+
+    // copy batch offsets of a body into a pool, uncolored meshes run as one serial batch
+    static size_t appendColors(const std::vector<unsigned int> &colors, size_t count, std::vector<unsigned int> &pool)
+    {
+        if (colors.size() >= 2 && colors.back() == count)
+        {
+            pool.insert(pool.end(), colors.begin(), colors.end());
+            return colors.size() - 1;
+        }
+        pool.push_back(0);
+        pool.push_back((unsigned int)count);
+        return 1;
+    }
+
+    void resolveContacts(const glm::vec3 *start)
+    {
+        if (collision.enabled())
+        {
+            if (!collision.exclusionsValid(positions.size()))
+            {
+                rebuildContactExclusions();
+            }
+            collision.resolve(positions.data(), velocities.data(), vertexBody.data(), positions.size(), bodyAsleep.data());
+        }
+        triangleCollision.resolve(positions.data(), velocities.data(), start, bodyAsleep.data());
+    }
+
+    /**
+     * Islands over the contact graph of this step (union find), then sleep or wake whole islands
+     * - an awake body counts its calm steps from its mean kinetic energy
+     * - an island sleeps when all its awake bodies have been calm for SLEEP_STEPS, velocities are zeroed
+     * - an island with any restless body wakes all its sleeping bodies (wake on contact)
+     */
+    void updateSleep()
+    {
+        size_t count = bodies.size();
+        if (!SLEEPING)
+        {
+            for (size_t b = 0; b < count; b++)
+            {
+                if (bodies[b].asleep)
+                    wake(b);
+            }
+            lastIslandCount = (int)count;
+            return;
+        }
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int b = 0; b < (int)count; b++)
+        {
+            BodyRange &body = bodies[b];
+            if (body.asleep || body.vertexCount == 0)
+                continue;
+            float energy = 0.0f;
+            for (size_t i = body.vertexOffset; i < body.vertexOffset + body.vertexCount; i++)
+            {
+                energy += 0.5f * glm::dot(velocities[i], velocities[i]);
+            }
+            body.calmSteps = energy / (float)body.vertexCount < SLEEP_ENERGY ? body.calmSteps + 1 : 0;
+        }
+
+        islandParent.resize(count);
+        for (size_t b = 0; b < count; b++)
+        {
+            islandParent[b] = (int)b;
+        }
+        for (auto &pair : collision.bodyContacts)
+        {
+            unionIslands(pair.first, pair.second);
+        }
+        for (auto &pair : triangleCollision.bodyContacts)
+        {
+            unionIslands(pair.first, pair.second);
+        }
+
+        // per island root: 1 = every body calm long enough, 0 = something is still moving
+        islandCalm.assign(count, 1);
+        lastIslandCount = 0;
+        for (size_t b = 0; b < count; b++)
+        {
+            int root = findIsland((int)b);
+            if (root == (int)b)
+                lastIslandCount++;
+            if (!bodies[b].asleep && bodies[b].calmSteps < SLEEP_STEPS)
+                islandCalm[root] = 0;
+        }
+        for (size_t b = 0; b < count; b++)
+        {
+            BodyRange &body = bodies[b];
+            bool calm = islandCalm[findIsland((int)b)] != 0;
+            if (!calm && body.asleep)
+            {
+                wake(b);
+            }
+            else if (calm && !body.asleep)
+            {
+                body.asleep = true;
+                bodyAsleep[b] = 1;
+                std::fill(velocities.begin() + body.vertexOffset, velocities.begin() + body.vertexOffset + body.vertexCount, glm::vec3(0.0f));
+            }
+        }
+    }
+
+    int findIsland(int b)
+    {
+        while (islandParent[b] != b)
+        {
+            islandParent[b] = islandParent[islandParent[b]];
+            b = islandParent[b];
+        }
+        return b;
+    }
+
+    void unionIslands(int a, int b)
+    {
+        a = findIsland(a);
+        b = findIsland(b);
+        if (a != b)
+            islandParent[std::max(a, b)] = std::min(a, b);
+    }
+
+    // rest shape of every body where it was spawned, constraints are never treated as contacts
+    void rebuildContactExclusions()
+    {
+        std::vector<glm::vec3> rest(positions.size());
+        std::vector<std::pair<unsigned int, unsigned int>> links;
+        for (auto &body : bodies)
+        {
+            for (size_t i = 0; i < body.vertexCount; i++)
+            {
+                rest[body.vertexOffset + i] = x_offset_zero[body.vertexOffset + i] + body.x_cm_zero;
+            }
+            for (size_t k = 0; k < body.constraintCount; k++)
+            {
+                const Constraint &c = constraints[body.constraintOffset + k];
+                links.emplace_back((unsigned int)(body.vertexOffset + c.pair.first), (unsigned int)(body.vertexOffset + c.pair.second));
+            }
+            for (size_t k = 0; k < body.bendCount; k++)
+            {
+                const Constraint &c = bendConstraints[body.bendOffset + k];
+                links.emplace_back((unsigned int)(body.vertexOffset + c.pair.first), (unsigned int)(body.vertexOffset + c.pair.second));
+            }
+        }
+        collision.setExclusions(rest.data(), vertexBody.data(), positions.size(), links);
+    }
+
+    void rebuildSchedule()
+    {
+        schedule.resize(bodies.size());
+        for (size_t i = 0; i < bodies.size(); i++)
+        {
+            schedule[i] = (int)i;
+        }
+        // work of a body is proportional to its vertex count
+        std::stable_sort(schedule.begin(), schedule.end(), [&](int a, int b)
+                         { return bodies[a].vertexCount > bodies[b].vertexCount; });
+    }
+
+    /**
+     * integrate one body with its integrator, then resolve the bounding box and static colliders
+     * only touches the pool range of the given body so bodies can run concurrently
+     * - ownsTeam - called outside a parallel region, the body may split its own work across threads
+     */
+    void stepBody(const BodyRange &body, float frameTime, bool ownsTeam)
+    {
+        if (body.vertexCount == 0)
+            return;
+
+        glm::vec3 *x = &positions[body.vertexOffset];
+        glm::vec3 *v = &velocities[body.vertexOffset];
+        const glm::vec3 *q = &x_offset_zero[body.vertexOffset];
+        const Constraint *c = constraints.data() + body.constraintOffset;
+        size_t n = body.vertexCount;
+
+        if (body.integrator == PROJECTIVE_DYNAMICS)
+        {
+            pdSolvers[body.pdSolver]->solve(x, v, q, n, c, body.constraintCount,
+                                            bendConstraints.data() + body.bendOffset, body.bendCount,
+                                            frameTime, glm::vec3(0.0f, -GRAVITY, 0.0f), ownsTeam);
+        }
+        else
+        {
+            integrateSprings(body, x, v, q, c, frameTime, ownsTeam);
+        }
+
+        ColliderSet::resolveBox(x, v, n, BOX_MIN, BOX_MAX, 0.0f, RESTITUTION);
+        if (colliders)
+            colliders->resolve(x, v, n, collision.RADIUS, RESTITUTION);
+    }
+
+    // gravity + shape matching + structural springs + bending, then move vertices
+    void integrateSprings(const BodyRange &body, glm::vec3 *x, glm::vec3 *v, const glm::vec3 *q, const Constraint *c, float frameTime, bool ownsTeam)
+    {
+        size_t n = body.vertexCount;
+        glm::vec3 x_cm(0.0f);
+        for (size_t i = 0; i < n; ++i)
+        {
+            v[i].y -= GRAVITY * frameTime;
+            x_cm += x[i];
+        }
+        x_cm /= (float)n;
+
+        glm::mat3 R = ShapeMatching::rotation(x, q, n, x_cm);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            glm::vec3 goal_pos = (R * q[i]) + x_cm;
+            v[i] += (goal_pos - x[i]) * (SHAPE_STIFFNESS / frameTime);
+        }
+
+        // the body has the cores to itself, large ones spend them on their color batches
+        bool parallel_batches = ownsTeam && omp_get_max_threads() > 1;
+        if (body.integrator == IMPLICIT_EULER)
+        {
+            implicitSolvers[body.implicitSolver]->solve(x, v, n, c, body.constraintCount, frameTime, SPRING_CONSTANT, SPRING_DAMPING);
+        }
+        else
+        {
+            applySpringImpulses(x, v, c, &constraintColors[body.colorOffset], body.colorCount, frameTime,
+                                parallel_batches && body.colorCount > 1 && body.constraintCount >= (size_t)PARALLEL_BATCH_MIN_CONSTRAINTS);
+        }
+        if (BEND_STIFFNESS > 0.0f && body.dihedralCount > 0)
+        {
+            applyBendImpulses(x, v, dihedrals.data() + body.dihedralOffset, &dihedralColors[body.dihedralColorOffset], body.dihedralColorCount, frameTime,
+                              parallel_batches && body.dihedralColorCount > 1 && body.dihedralCount >= (size_t)PARALLEL_BATCH_MIN_CONSTRAINTS);
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[i] += v[i] * frameTime;
+        }
+    }
+
+    /**
+     * explicit structural springs (force * dt added to velocities)
+     * constraints of one color batch share no vertex, so a batch can be split across threads,
+     * one region for all batches, the barrier at the end of each batch orders them
+     */
+    void applySpringImpulses(const glm::vec3 *x, glm::vec3 *v, const Constraint *c, const unsigned int *colors, size_t colorCount,
+                             float frameTime, bool parallel)
+    {
+#pragma omp parallel if (parallel)
+        for (size_t color = 0; color < colorCount; color++)
+        {
+#pragma omp for
+            for (int k = (int)colors[color]; k < (int)colors[color + 1]; ++k)
+            {
+                const Constraint &constraint = c[k];
+                glm::vec3 i = x[constraint.pair.first];
+                glm::vec3 j = x[constraint.pair.second];
+                glm::vec3 vi = v[constraint.pair.first];
+                glm::vec3 vj = v[constraint.pair.second];
+
+                float current_dist = glm::length(i - j);
+                if (current_dist < 1e-6f)
+                    continue;
+
+                glm::vec3 dir = (j - i) / current_dist;
+
+                float spring_force = SPRING_CONSTANT * (current_dist - constraint.distance);
+                float damping_force = SPRING_DAMPING * glm::dot(dir, vj - vi);
+
+                glm::vec3 force = dir * (spring_force + damping_force) * frameTime;
+
+                v[constraint.pair.first] += force;
+                v[constraint.pair.second] -= force;
+            }
+        }
+    }
+
+    /**
+     * explicit dihedral bending (Bridson et al. 2003), force * dt added to velocities
+     * - u0..u3 are the bending modes of the stencil, -u_i is the gradient of the angle w.r.t. vertex i
+     * - elastic part pulls the angle back to its rest value, scaled by |e|^2 / (|n0| + |n1|)
+     * - damping acts on the rate of change of the angle only, rigid motion is not damped
+     * - coefficients are clamped per stencil so sliver triangles stay stable
+     * - stencils of one color batch share no vertex, batches run like the spring ones (one region, a barrier per batch)
+     */
+    void applyBendImpulses(const glm::vec3 *x, glm::vec3 *v, const DihedralConstraint *d, const unsigned int *colors, size_t colorCount,
+                           float frameTime, bool parallel)
+    {
+        const float pi = 3.14159265358979f;
+#pragma omp parallel if (parallel)
+        for (size_t color = 0; color < colorCount; color++)
+        {
+#pragma omp for
+            for (int k = (int)colors[color]; k < (int)colors[color + 1]; ++k)
+            {
+                const DihedralConstraint &bend = d[k];
+                const unsigned int ids[4] = {bend.wing[0], bend.wing[1], bend.edge[0], bend.edge[1]};
+                glm::vec3 e0 = x[bend.edge[0]], e1 = x[bend.edge[1]];
+                glm::vec3 w0 = x[bend.wing[0]], w1 = x[bend.wing[1]];
+
+                glm::vec3 n0 = glm::cross(w0 - e0, w0 - e1);
+                glm::vec3 n1 = glm::cross(w1 - e1, w1 - e0);
+                glm::vec3 e = e1 - e0;
+                float n0_sq = glm::dot(n0, n0), n1_sq = glm::dot(n1, n1), len = glm::length(e);
+                if (n0_sq < 1e-12f || n1_sq < 1e-12f || len < 1e-6f)
+                    continue;
+
+                glm::vec3 u[4];
+                u[0] = n0 * (len / n0_sq);
+                u[1] = n1 * (len / n1_sq);
+                u[2] = n0 * (glm::dot(w0 - e1, e) / (len * n0_sq)) + n1 * (glm::dot(w1 - e1, e) / (len * n1_sq));
+                u[3] = -n0 * (glm::dot(w0 - e0, e) / (len * n0_sq)) - n1 * (glm::dot(w1 - e0, e) / (len * n1_sq));
+
+                float angle = std::atan2(glm::dot(glm::cross(n0, n1), e) / len, glm::dot(n0, n1));
+                float delta = angle - bend.restAngle;
+                if (delta > pi)
+                    delta -= 2.0f * pi;
+                else if (delta < -pi)
+                    delta += 2.0f * pi;
+
+                float rate = 0.0f; // -d(angle)/dt
+                for (int j = 0; j < 4; j++)
+                {
+                    rate += glm::dot(u[j], v[ids[j]]);
+                }
+
+                // slivers have huge modes, cap both coefficients at what one explicit step can carry
+                float modes = glm::dot(u[0], u[0]) + glm::dot(u[1], u[1]) + glm::dot(u[2], u[2]) + glm::dot(u[3], u[3]);
+                float stiffness = std::min(BEND_STIFFNESS * len * len / (std::sqrt(n0_sq) + std::sqrt(n1_sq)), BEND_STABILITY / (modes * frameTime * frameTime));
+                float damping_coef = std::min(BEND_DAMPING * len, 0.5f / (modes * frameTime));
+                float elastic = stiffness * delta;
+                float damping = damping_coef * rate;
+                for (int j = 0; j < 4; j++)
+                {
+                    v[ids[j]] += u[j] * ((elastic - damping) * frameTime);
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,621 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <iostream>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <mappedfile.h>
+#include <Physics/SPHSolver.h>
+#include <Physics/SoftBodyWorld.h>
+
+/**
+ * Versioned binary checkpoint (.ckpt) of a running simulation, to resume a settled fluid instead of warming it up again
+ * - parameters sit in the header, every per-particle array is one 64 byte aligned section
+ * - SPH: the alive part of the particle pool, cell sleep state, emitters and sinks
+ * - soft bodies: the dynamic state of the pools (positions, velocities, sleep); the topology comes from the scene setup,
+ *   so a checkpoint only restores into a world holding the same bodies
+ * - open() maps the file and turns the section offsets into typed pointers into the mapping,
+ *   restore() is then one memcpy per array, nothing is parsed
+ */
+class SimulationCheckpoint
+{
+public:
+    // bump whenever a section or a parameter block changes
+    static constexpr uint32_t VERSION = 1;
+
+    enum SectionId : uint32_t
+    {
+        SPH_POSITIONS,
+        SPH_PREDICTED_POSITIONS,
+        SPH_VELOCITIES,
+        SPH_ACCELERATIONS,
+        SPH_DENSITIES,
+        SPH_COLORS,
+        SPH_LEVELS,
+        SPH_SURFACE_OFFSET,
+        SPH_CELL_CALM,
+        SPH_CELL_SEEN,
+        SPH_EMITTERS,
+        SPH_SINKS,
+        SOFT_POSITIONS,
+        SOFT_VELOCITIES,
+        SOFT_BODIES,
+        SECTION_COUNT
+    };
+
+    // per soft body, checked against the world on restore
+    struct BodyState
+    {
+        uint64_t vertexOffset;
+        uint64_t vertexCount;
+        int32_t calmSteps;
+        uint32_t asleep;
+    };
+
+    SimulationCheckpoint() {}
+    explicit SimulationCheckpoint(const std::string &path)
+    {
+        open(path);
+    }
+
+    // map and validate the file, false on a missing, truncated, foreign or inconsistent file
+    bool open(const std::string &path)
+    {
+        if (!file.open(path) || file.size() < sizeof(Header))
+            return fail();
+        std::memcpy(&header, file.data(), sizeof(Header));
+        if (std::memcmp(header.magic, MAGIC, 4) != 0 || header.version != VERSION || header.sectionCount != SECTION_COUNT)
+            return fail();
+        for (uint32_t s = 0; s < SECTION_COUNT; s++)
+        {
+            const Section &sec = header.sections[s];
+            if (sec.elementSize != ELEMENT_SIZE[s] || sec.offset % ALIGNMENT != 0 || sec.offset > file.size() ||
+                sec.count > (file.size() - sec.offset) / sec.elementSize)
+                return fail();
+        }
+        if (!consistent())
+            return fail();
+        return true;
+    }
+
+    bool isOpen() const
+    {
+        return file.isOpen();
+    }
+
+    bool hasFluid() const
+    {
+        return header.hasFluid != 0;
+    }
+
+    bool hasSoftBodies() const
+    {
+        return header.hasSoftBodies != 0;
+    }
+
+    // typed view of a section inside the mapping, valid while the checkpoint is open
+    template <typename T>
+    const T *section(SectionId id) const
+    {
+        return reinterpret_cast<const T *>(file.data() + header.sections[id].offset);
+    }
+
+    size_t count(SectionId id) const
+    {
+        return (size_t)header.sections[id].count;
+    }
+
+    /**
+     * Copy the checkpoint into the solvers, either may be nullptr to skip it
+     * - the fluid pool grows to the stored particle count, the spatial lookup is rebuilt by the next solver_step
+     * - the soft body world has to hold the same bodies (same vertex ranges) as the saved one, or nothing is touched
+     */
+    bool restore(SPHSolver *solver, SoftBodyWorld *world) const
+    {
+        if (!isOpen())
+            return false;
+        if (world != nullptr && hasSoftBodies())
+        {
+            const BodyState *states = section<BodyState>(SOFT_BODIES);
+            if (count(SOFT_BODIES) != world->bodies.size() || count(SOFT_POSITIONS) != world->positions.size())
+                return false;
+            for (size_t b = 0; b < world->bodies.size(); b++)
+            {
+                if (states[b].vertexOffset != world->bodies[b].vertexOffset || states[b].vertexCount != world->bodies[b].vertexCount)
+                    return false;
+            }
+        }
+
+        if (solver != nullptr && hasFluid())
+        {
+            readParams(header.fluid, *solver);
+            int alive = (int)count(SPH_POSITIONS);
+            solver->reserveParticles(alive);
+            solver->alive = alive;
+            copySection(SPH_POSITIONS, solver->positions.data());
+            copySection(SPH_PREDICTED_POSITIONS, solver->predicted_positions.data());
+            copySection(SPH_VELOCITIES, solver->velocities.data());
+            copySection(SPH_ACCELERATIONS, solver->accelerations.data());
+            copySection(SPH_DENSITIES, solver->densities.data());
+            copySection(SPH_COLORS, solver->colors.data());
+            copySection(SPH_LEVELS, solver->levels.data());
+            copySection(SPH_SURFACE_OFFSET, solver->surface_offset.data());
+            // settled cells stay asleep after the restart
+            solver->cell_calm.resize(count(SPH_CELL_CALM));
+            solver->cell_seen.resize(count(SPH_CELL_SEEN));
+            copySection(SPH_CELL_CALM, solver->cell_calm.data());
+            copySection(SPH_CELL_SEEN, solver->cell_seen.data());
+            solver->sleep_step = header.fluid.sleepStep;
+            solver->emitters.assign(section<SPHSolver::Emitter>(SPH_EMITTERS), section<SPHSolver::Emitter>(SPH_EMITTERS) + count(SPH_EMITTERS));
+            solver->sinks.assign(section<SPHSolver::Sink>(SPH_SINKS), section<SPHSolver::Sink>(SPH_SINKS) + count(SPH_SINKS));
+            solver->resizeContainer();
+        }
+
+        if (world != nullptr && hasSoftBodies())
+        {
+            readParams(header.softBody, *world);
+            copySection(SOFT_POSITIONS, world->positions.data());
+            copySection(SOFT_VELOCITIES, world->velocities.data());
+            const BodyState *states = section<BodyState>(SOFT_BODIES);
+            for (size_t b = 0; b < world->bodies.size(); b++)
+            {
+                world->bodies[b].asleep = states[b].asleep != 0;
+                world->bodies[b].calmSteps = states[b].calmSteps;
+                world->bodyAsleep[b] = states[b].asleep != 0 ? 1 : 0;
+            }
+            world->triangleCollision.invalidateTrees(); // a body asleep before and after kept the tree of its old positions
+        }
+        return true;
+    }
+
+    // open + restore in one call
+    static bool load(const std::string &path, SPHSolver *solver, SoftBodyWorld *world)
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        SimulationCheckpoint checkpoint(path);
+        if (!checkpoint.restore(solver, world))
+        {
+            std::cerr << "Error: Could not restore checkpoint " << path << std::endl;
+            return false;
+        }
+        std::cout << "Loaded " << path << ": " << checkpoint.count(SPH_POSITIONS) << " particles, "
+                  << checkpoint.count(SOFT_POSITIONS) << " soft body vertices in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms\n";
+        return true;
+    }
+
+    /**
+     * Lay the whole file out in image: header, then every section at its aligned offset
+     * - the image keeps its capacity between calls, a periodic snapshot does not allocate
+     */
+    static void capture(const SPHSolver *solver, const SoftBodyWorld *world, std::vector<char> &image)
+    {
+        Header header = {};
+        std::memcpy(header.magic, MAGIC, 4);
+        header.version = VERSION;
+        header.sectionCount = SECTION_COUNT;
+        header.hasFluid = solver != nullptr ? 1 : 0;
+        header.hasSoftBodies = world != nullptr ? 1 : 0;
+
+        const void *payload[SECTION_COUNT] = {};
+        uint64_t offset = align(sizeof(Header));
+        auto place = [&](SectionId id, const void *data, size_t count)
+        {
+            header.sections[id] = {offset, (uint64_t)count, ELEMENT_SIZE[id], 0};
+            payload[id] = data;
+            offset = align(offset + count * ELEMENT_SIZE[id]);
+        };
+        for (uint32_t s = 0; s < SECTION_COUNT; s++)
+        {
+            place((SectionId)s, nullptr, 0);
+        }
+
+        std::vector<BodyState> states;
+        if (solver != nullptr)
+        {
+            writeParams(*solver, header.fluid);
+            size_t alive = (size_t)solver->alive;
+            place(SPH_POSITIONS, solver->positions.data(), alive);
+            place(SPH_PREDICTED_POSITIONS, solver->predicted_positions.data(), alive);
+            place(SPH_VELOCITIES, solver->velocities.data(), alive);
+            place(SPH_ACCELERATIONS, solver->accelerations.data(), alive);
+            place(SPH_DENSITIES, solver->densities.data(), alive);
+            place(SPH_COLORS, solver->colors.data(), alive);
+            place(SPH_LEVELS, solver->levels.data(), alive);
+            place(SPH_SURFACE_OFFSET, solver->surface_offset.data(), alive);
+            place(SPH_CELL_CALM, solver->cell_calm.data(), solver->cell_calm.size());
+            place(SPH_CELL_SEEN, solver->cell_seen.data(), solver->cell_seen.size());
+            place(SPH_EMITTERS, solver->emitters.data(), solver->emitters.size());
+            place(SPH_SINKS, solver->sinks.data(), solver->sinks.size());
+        }
+        if (world != nullptr)
+        {
+            writeParams(*world, header.softBody);
+            states.resize(world->bodies.size());
+            for (size_t b = 0; b < world->bodies.size(); b++)
+            {
+                const SoftBodyWorld::BodyRange &body = world->bodies[b];
+                states[b] = {(uint64_t)body.vertexOffset, (uint64_t)body.vertexCount, body.calmSteps, body.asleep ? 1u : 0u};
+            }
+            place(SOFT_POSITIONS, world->positions.data(), world->positions.size());
+            place(SOFT_VELOCITIES, world->velocities.data(), world->velocities.size());
+            place(SOFT_BODIES, states.data(), states.size());
+        }
+
+        image.resize((size_t)offset);
+        std::memcpy(image.data(), &header, sizeof(Header));
+        uint64_t written = sizeof(Header);
+        for (uint32_t s = 0; s < SECTION_COUNT; s++)
+        {
+            const Section &sec = header.sections[s];
+            if (sec.count == 0)
+                continue;
+            std::memset(image.data() + written, 0, (size_t)(sec.offset - written)); // padding
+            std::memcpy(image.data() + sec.offset, payload[s], (size_t)(sec.count * sec.elementSize));
+            written = sec.offset + sec.count * sec.elementSize;
+        }
+        std::memset(image.data() + written, 0, (size_t)(offset - written));
+    }
+
+    // written to a temporary file first so a crash never leaves a half written checkpoint behind
+    static bool writeImage(const std::string &path, const std::vector<char> &image)
+    {
+        std::string tmpPath = path + ".tmp";
+        FILE *out = std::fopen(tmpPath.c_str(), "wb");
+        if (out == nullptr)
+            return false;
+        bool ok = std::fwrite(image.data(), 1, image.size(), out) == image.size();
+        ok = std::fclose(out) == 0 && ok;
+        if (!ok)
+            return false;
+        std::remove(path.c_str());
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+    // synchronous save, CheckpointWriter does the same off the simulation thread
+    static bool save(const std::string &path, const SPHSolver *solver, const SoftBodyWorld *world)
+    {
+        std::vector<char> image;
+        capture(solver, world, image);
+        return writeImage(path, image);
+    }
+
+private:
+    struct Section
+    {
+        uint64_t offset; // from start of file, ALIGNMENT aligned
+        uint64_t count;  // elements
+        uint32_t elementSize;
+        uint32_t reserved;
+    };
+
+    // SPHSolver adjustable parameters, fixed width so the block does not depend on the compiler
+    struct FluidParams
+    {
+        int32_t nParticles;
+        float mu, mass, pressureMult, smoothingRadius, density0, restitution, gravity;
+        float spawnPos[3], boxMin[3], boxMax[3];
+        float spawnGap;
+        uint32_t usePredicted, sleeping;
+        float sleepVelocity, sleepDensityChange;
+        int32_t sleepSteps;
+        uint32_t adaptive;
+        int32_t maxLevel;
+        float splitSurface, mergeSurface, splitCameraDistance;
+        int32_t sleepStep;
+    };
+
+    // SoftBodyWorld adjustable parameters
+    struct SoftBodyParams
+    {
+        float gravity, springConstant, springDamping, shapeStiffness;
+        float bendStiffness, bendDamping, bendStability, restitution;
+        int32_t parallelBatchMinConstraints;
+        float boxMin[3], boxMax[3];
+        uint32_t sleeping;
+        float sleepEnergy;
+        int32_t sleepSteps;
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t sectionCount;
+        uint32_t hasFluid;
+        uint32_t hasSoftBodies;
+        uint32_t reserved;
+        FluidParams fluid;
+        SoftBodyParams softBody;
+        Section sections[SECTION_COUNT];
+    };
+
+    static constexpr char MAGIC[4] = {'S', 'C', 'K', '\0'};
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr uint32_t ELEMENT_SIZE[SECTION_COUNT] = {
+        sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec3), sizeof(float), sizeof(glm::vec4),
+        sizeof(uint8_t), sizeof(float), sizeof(int), sizeof(int), sizeof(SPHSolver::Emitter), sizeof(SPHSolver::Sink),
+        sizeof(glm::vec3), sizeof(glm::vec3), sizeof(BodyState)};
+
+    // sections are raw memory images of the vectors
+    static_assert(std::is_trivially_copyable<SPHSolver::Emitter>::value && std::is_trivially_copyable<SPHSolver::Sink>::value,
+                  "emitters and sinks are stored as memory images");
+    static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::vec4) == 16, "unexpected glm layout");
+
+    MappedFile file;
+    Header header = {};
+
+    bool fail()
+    {
+        file.close();
+        header = {};
+        return false;
+    }
+
+    /**
+     * Sections that restore() copies side by side have to agree, each one alone fitting the file is not enough
+     * - every per-particle SPH array holds the alive count, cell_calm and cell_seen cover the same cells
+     * - levels index level_mass[], a level (or the split limit) past MAX_LEVELS would read outside it
+     * - soft body velocities match the positions, the bodies tile the position pool in order
+     */
+    bool consistent() const
+    {
+        size_t alive = count(SPH_POSITIONS);
+        for (SectionId id : {SPH_PREDICTED_POSITIONS, SPH_VELOCITIES, SPH_ACCELERATIONS, SPH_DENSITIES, SPH_COLORS,
+                             SPH_LEVELS, SPH_SURFACE_OFFSET})
+        {
+            if (count(id) != alive)
+                return false;
+        }
+        if (count(SPH_CELL_SEEN) != count(SPH_CELL_CALM))
+            return false;
+        if (hasFluid() && (header.fluid.maxLevel < 0 || header.fluid.maxLevel >= SPHSolver::MAX_LEVELS))
+            return false;
+        const uint8_t *levels = section<uint8_t>(SPH_LEVELS);
+        for (size_t i = 0; i < alive; i++)
+        {
+            if (levels[i] >= SPHSolver::MAX_LEVELS)
+                return false;
+        }
+
+        if (count(SOFT_VELOCITIES) != count(SOFT_POSITIONS))
+            return false;
+        const BodyState *states = section<BodyState>(SOFT_BODIES);
+        uint64_t next = 0;
+        for (size_t b = 0; b < count(SOFT_BODIES); b++)
+        {
+            if (states[b].vertexOffset != next || states[b].vertexCount > count(SOFT_POSITIONS) - next)
+                return false;
+            next += states[b].vertexCount;
+        }
+        return next == count(SOFT_POSITIONS);
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    void copySection(SectionId id, void *out) const
+    {
+        const Section &sec = header.sections[id];
+        if (sec.count > 0)
+            std::memcpy(out, file.data() + sec.offset, (size_t)(sec.count * sec.elementSize));
+    }
+
+    static void storeVec3(glm::vec3 v, float *out)
+    {
+        out[0] = v.x;
+        out[1] = v.y;
+        out[2] = v.z;
+    }
+
+    static void writeParams(const SPHSolver &solver, FluidParams &p)
+    {
+        p.nParticles = solver.N_PARTICLES;
+        p.mu = solver.MU;
+        p.mass = solver.MASS;
+        p.pressureMult = solver.PRESSURE_MULT;
+        p.smoothingRadius = solver.SMOOTHING_RADIUS;
+        p.density0 = solver.DENSITY_0;
+        p.restitution = solver.RESTITUTION;
+        p.gravity = solver.GRAVITY;
+        storeVec3(solver.SPAWN_POS, p.spawnPos);
+        storeVec3(solver.BOX_MIN, p.boxMin);
+        storeVec3(solver.BOX_MAX, p.boxMax);
+        p.spawnGap = solver.SPAWN_GAP;
+        p.usePredicted = solver.USE_PREDICTED;
+        p.sleeping = solver.SLEEPING;
+        p.sleepVelocity = solver.SLEEP_VELOCITY;
+        p.sleepDensityChange = solver.SLEEP_DENSITY_CHANGE;
+        p.sleepSteps = solver.SLEEP_STEPS;
+        p.adaptive = solver.ADAPTIVE;
+        p.maxLevel = solver.MAX_LEVEL;
+        p.splitSurface = solver.SPLIT_SURFACE;
+        p.mergeSurface = solver.MERGE_SURFACE;
+        p.splitCameraDistance = solver.SPLIT_CAMERA_DISTANCE;
+        p.sleepStep = solver.sleep_step;
+    }
+
+    static void readParams(const FluidParams &p, SPHSolver &solver)
+    {
+        solver.N_PARTICLES = p.nParticles;
+        solver.MU = p.mu;
+        solver.MASS = p.mass;
+        solver.PRESSURE_MULT = p.pressureMult;
+        solver.SMOOTHING_RADIUS = p.smoothingRadius;
+        solver.DENSITY_0 = p.density0;
+        solver.RESTITUTION = p.restitution;
+        solver.GRAVITY = p.gravity;
+        solver.SPAWN_POS = glm::vec3(p.spawnPos[0], p.spawnPos[1], p.spawnPos[2]);
+        solver.BOX_MIN = glm::vec3(p.boxMin[0], p.boxMin[1], p.boxMin[2]);
+        solver.BOX_MAX = glm::vec3(p.boxMax[0], p.boxMax[1], p.boxMax[2]);
+        solver.SPAWN_GAP = p.spawnGap;
+        solver.USE_PREDICTED = p.usePredicted != 0;
+        solver.SLEEPING = p.sleeping != 0;
+        solver.SLEEP_VELOCITY = p.sleepVelocity;
+        solver.SLEEP_DENSITY_CHANGE = p.sleepDensityChange;
+        solver.SLEEP_STEPS = p.sleepSteps;
+        solver.ADAPTIVE = p.adaptive != 0;
+        solver.MAX_LEVEL = p.maxLevel;
+        solver.SPLIT_SURFACE = p.splitSurface;
+        solver.MERGE_SURFACE = p.mergeSurface;
+        solver.SPLIT_CAMERA_DISTANCE = p.splitCameraDistance;
+    }
+
+    static void writeParams(const SoftBodyWorld &world, SoftBodyParams &p)
+    {
+        p.gravity = world.GRAVITY;
+        p.springConstant = world.SPRING_CONSTANT;
+        p.springDamping = world.SPRING_DAMPING;
+        p.shapeStiffness = world.SHAPE_STIFFNESS;
+        p.bendStiffness = world.BEND_STIFFNESS;
+        p.bendDamping = world.BEND_DAMPING;
+        p.bendStability = world.BEND_STABILITY;
+        p.restitution = world.RESTITUTION;
+        p.parallelBatchMinConstraints = world.PARALLEL_BATCH_MIN_CONSTRAINTS;
+        storeVec3(world.BOX_MIN, p.boxMin);
+        storeVec3(world.BOX_MAX, p.boxMax);
+        p.sleeping = world.SLEEPING;
+        p.sleepEnergy = world.SLEEP_ENERGY;
+        p.sleepSteps = world.SLEEP_STEPS;
+    }
+
+    static void readParams(const SoftBodyParams &p, SoftBodyWorld &world)
+    {
+        world.GRAVITY = p.gravity;
+        world.SPRING_CONSTANT = p.springConstant;
+        world.SPRING_DAMPING = p.springDamping;
+        world.SHAPE_STIFFNESS = p.shapeStiffness;
+        world.BEND_STIFFNESS = p.bendStiffness;
+        world.BEND_DAMPING = p.bendDamping;
+        world.BEND_STABILITY = p.bendStability;
+        world.RESTITUTION = p.restitution;
+        world.PARALLEL_BATCH_MIN_CONSTRAINTS = p.parallelBatchMinConstraints;
+        world.BOX_MIN = glm::vec3(p.boxMin[0], p.boxMin[1], p.boxMin[2]);
+        world.BOX_MAX = glm::vec3(p.boxMax[0], p.boxMax[1], p.boxMax[2]);
+        world.SLEEPING = p.sleeping != 0;
+        world.SLEEP_ENERGY = p.sleepEnergy;
+        world.SLEEP_STEPS = p.sleepSteps;
+    }
+};
+
+/**
+ * Writes checkpoints from a background thread
+ * - save() only snapshots the state into a staging image (one memcpy per array) on the calling thread
+ * - the worker writes the image while the simulation keeps stepping; a snapshot still waiting
+ *   when the next one comes in is replaced, the newest state wins
+ * - three images rotate (staging, pending, writing), after the first save nothing is allocated
+ */
+class CheckpointWriter
+{
+public:
+    // stats, readable from any thread
+    std::atomic<int> written{0};
+    std::atomic<int> dropped{0}; // replaced before the worker got to them
+    std::atomic<int> failed{0};
+    std::atomic<float> lastWriteMs{0.0f};
+
+    CheckpointWriter() {}
+    ~CheckpointWriter()
+    {
+        if (worker.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeWorker.notify_one();
+            worker.join(); // a queued checkpoint is still written
+        }
+    }
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    // snapshot now, write to path in the background
+    void save(const std::string &path, const SPHSolver *solver, const SoftBodyWorld *world)
+    {
+        SimulationCheckpoint::capture(solver, world, staging);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (hasPending)
+                dropped++;
+            std::swap(staging, pending);
+            pendingPath = path;
+            hasPending = true;
+        }
+        if (!worker.joinable())
+            worker = std::thread(&CheckpointWriter::run, this);
+        wakeWorker.notify_one();
+    }
+
+    bool busy()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hasPending || writing;
+    }
+
+    // block until every requested checkpoint is on disk
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]
+                  { return !hasPending && !writing; });
+    }
+
+private:
+    std::vector<char> staging; // simulation thread only
+    std::vector<char> pending; // guarded by mutex
+    std::vector<char> current; // worker only
+    std::string pendingPath;
+    bool hasPending = false;
+    bool writing = false;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable wakeWorker;
+    std::condition_variable idle;
+    std::thread worker;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wakeWorker.wait(lock, [this]
+                            { return hasPending || stopping; });
+            if (!hasPending)
+                return;
+            std::swap(pending, current);
+            std::string path = pendingPath;
+            hasPending = false;
+            writing = true;
+            lock.unlock();
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+            bool ok = SimulationCheckpoint::writeImage(path, current);
+            lastWriteMs = (float)std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+            if (ok)
+                written++;
+            else
+                failed++;
+
+            lock.lock();
+            writing = false;
+            idle.notify_all();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <iostream>
+
+#include <objectloader.h>
+
+// post-load passes that only change the order of data, never the shape
+class MeshOptimizer
+{
+public:
+    /**
+     * Renumber a loaded mesh for memory locality
+     * - vertices in reverse Cuthill-McKee order of the spring graph
+     * - triangles sorted by their lowest vertex, normals/uvs renumbered by first use
+     * - constraints split into independent color batches, sorted by vertex inside a batch
+     * - measure - time a spring sweep before and after and print the speedup
+     */
+    static void optimizeForLocality(SoftBodyMesh &mesh, bool measure = false)
+    {
+        size_t n = mesh.vertices.size();
+        if (n == 0)
+            return;
+
+        double before = measure ? benchmarkSpringPass(mesh) : 0.0;
+
+        std::vector<unsigned int> order = reverseCuthillMcKee(n, mesh.structuralPairs);
+        std::vector<unsigned int> newIndex(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            newIndex[order[i]] = (unsigned int)i;
+        }
+
+        permute(mesh.vertices, order);
+        permute(mesh.velocities, order);
+        permute(mesh.x_offset_zero, order);
+
+        // faces hold v/vn/vt triples, 3 per triangle corner
+        for (size_t f = 0; f < mesh.faces.size(); f += 3)
+        {
+            mesh.faces[f] = newIndex[mesh.faces[f]];
+        }
+        sortTriangles(mesh.faces);
+        renumberByFirstUse(mesh.faces, 1, mesh.normals);
+        renumberByFirstUse(mesh.faces, 2, mesh.texCoords);
+        ObjectLoader::buildRenderIndices(mesh);
+        ObjectLoader::buildTopology(mesh);
+
+        remapConstraints(mesh.structuralPairs, newIndex);
+        remapConstraints(mesh.bendPairs, newIndex);
+        remapDihedrals(mesh.dihedrals, newIndex);
+        mesh.structuralColors = colorConstraints(mesh.structuralPairs, n);
+        mesh.dihedralColors = colorDihedrals(mesh.dihedrals, n);
+
+        if (measure)
+        {
+            double after = benchmarkSpringPass(mesh);
+            std::cout << "Locality pass: spring sweep " << before << " ms -> " << after << " ms ("
+                      << (after > 0.0 ? before / after : 0.0) << "x), "
+                      << mesh.structuralColors.size() - 1 << " constraint colors, "
+                      << (mesh.dihedralColors.empty() ? 0 : mesh.dihedralColors.size() - 1) << " bending colors\n";
+        }
+    }
+
+    /**
+     * Greedy graph coloring of constraints, no two constraints of a batch share a vertex
+     * constraints are reordered by (color, first, second)
+     * returns batch offsets in constraints (size = colors + 1)
+     */
+    static std::vector<unsigned int> colorConstraints(std::vector<Constraint> &constraints, size_t vertexCount)
+    {
+        return colorBatches<2>(
+            constraints, vertexCount,
+            [](const Constraint &c, int k)
+            { return k == 0 ? c.pair.first : c.pair.second; },
+            [](const Constraint &l, const Constraint &r)
+            { return l.pair < r.pair; });
+    }
+
+    // same as colorConstraints for the 4 vertex bending stencils, reordered by (color, edge)
+    static std::vector<unsigned int> colorDihedrals(std::vector<DihedralConstraint> &dihedrals, size_t vertexCount)
+    {
+        return colorBatches<4>(
+            dihedrals, vertexCount,
+            [](const DihedralConstraint &d, int k)
+            { return k < 2 ? d.edge[k] : d.wing[k - 2]; },
+            [](const DihedralConstraint &l, const DihedralConstraint &r)
+            { return std::min(l.edge[0], l.edge[1]) < std::min(r.edge[0], r.edge[1]); });
+    }
+
+    // average time (ms) of one explicit spring sweep over the mesh, used to measure the pass
+    static double benchmarkSpringPass(const SoftBodyMesh &mesh, int iterations = 200)
+    {
+        std::vector<glm::vec3> x(mesh.vertices);
+        std::vector<glm::vec3> v(mesh.vertices.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            x[i] *= 1.01f; // small stretch so every spring does work
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int it = 0; it < iterations; it++)
+        {
+            for (auto &c : mesh.structuralPairs)
+            {
+                glm::vec3 d = x[c.pair.second] - x[c.pair.first];
+                float len = glm::length(d);
+                glm::vec3 f = d * ((len - c.distance) / (len + 1e-6f)) * 1e-4f;
+                v[c.pair.first] += f;
+                v[c.pair.second] -= f;
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        volatile float sink = v.empty() ? 0.0f : v[0].x; // keep the loop alive
+        (void)sink;
+        return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+    }
+
+private:
+    /**
+     * Greedy coloring of constraints touching ARITY vertices each
+     * - vertexOf(item, k) - k-th vertex of an item
+     * - less - order of items inside a batch
+     */
+    template <int ARITY, typename T, typename VertexOf, typename Less>
+    static std::vector<unsigned int> colorBatches(std::vector<T> &items, size_t vertexCount, VertexOf vertexOf, Less less)
+    {
+        std::vector<int> color(items.size());
+        std::vector<std::vector<char>> used; // used[c][v] - vertex v already has an item of color c
+        int colorCount = 0;
+        for (size_t k = 0; k < items.size(); k++)
+        {
+            int c = 0;
+            while (c < colorCount)
+            {
+                bool free = true;
+                for (int j = 0; j < ARITY; j++)
+                {
+                    free = free && !used[c][vertexOf(items[k], j)];
+                }
+                if (free)
+                    break;
+                c++;
+            }
+            if (c == colorCount)
+            {
+                used.emplace_back(vertexCount, 0);
+                colorCount++;
+            }
+            for (int j = 0; j < ARITY; j++)
+            {
+                used[c][vertexOf(items[k], j)] = 1;
+            }
+            color[k] = c;
+        }
+
+        std::vector<size_t> idx(items.size());
+        std::iota(idx.begin(), idx.end(), 0);
+        std::stable_sort(idx.begin(), idx.end(), [&](size_t l, size_t r)
+                         {
+                             if (color[l] != color[r])
+                                 return color[l] < color[r];
+                             return less(items[l], items[r]); });
+
+        std::vector<T> sorted(items.size());
+        std::vector<unsigned int> offsets(colorCount + 1, 0);
+        for (size_t k = 0; k < idx.size(); k++)
+        {
+            sorted[k] = items[idx[k]];
+            offsets[color[idx[k]] + 1]++;
+        }
+        for (int c = 0; c < colorCount; c++)
+        {
+            offsets[c + 1] += offsets[c];
+        }
+        items.swap(sorted);
+        return offsets;
+    }
+
+    // BFS from a low degree vertex, neighbors by ascending degree, then reversed
+    static std::vector<unsigned int> reverseCuthillMcKee(size_t n, const std::vector<Constraint> &edges)
+    {
+        std::vector<unsigned int> start(n + 1, 0), adj(edges.size() * 2);
+        for (auto &e : edges)
+        {
+            start[e.pair.first + 1]++;
+            start[e.pair.second + 1]++;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            start[i + 1] += start[i];
+        }
+        std::vector<unsigned int> fill(start.begin(), start.end() - 1);
+        for (auto &e : edges)
+        {
+            adj[fill[e.pair.first]++] = e.pair.second;
+            adj[fill[e.pair.second]++] = e.pair.first;
+        }
+        auto degree = [&](unsigned int v)
+        { return start[v + 1] - start[v]; };
+
+        std::vector<unsigned int> byDegree(n);
+        std::iota(byDegree.begin(), byDegree.end(), 0u);
+        std::stable_sort(byDegree.begin(), byDegree.end(), [&](unsigned int a, unsigned int b)
+                         { return degree(a) < degree(b); });
+
+        std::vector<unsigned int> order;
+        order.reserve(n);
+        std::vector<char> visited(n, 0);
+        std::vector<unsigned int> neighbors;
+        for (unsigned int seed : byDegree) // one BFS per connected component
+        {
+            if (visited[seed])
+                continue;
+            visited[seed] = 1;
+            size_t head = order.size();
+            order.push_back(seed);
+            while (head < order.size())
+            {
+                unsigned int v = order[head++];
+                neighbors.assign(adj.begin() + start[v], adj.begin() + start[v + 1]);
+                std::sort(neighbors.begin(), neighbors.end(), [&](unsigned int a, unsigned int b)
+                          { return degree(a) < degree(b); });
+                for (unsigned int u : neighbors)
+                {
+                    if (!visited[u])
+                    {
+                        visited[u] = 1;
+                        order.push_back(u);
+                    }
+                }
+            }
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+    template <typename T>
+    static void permute(std::vector<T> &data, const std::vector<unsigned int> &order)
+    {
+        if (data.size() != order.size())
+            return;
+        std::vector<T> result(data.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            result[i] = data[order[i]];
+        }
+        data.swap(result);
+    }
+
+    // sort triangles (9 indices each) by their lowest vertex index
+    static void sortTriangles(std::vector<unsigned int> &faces)
+    {
+        size_t triCount = faces.size() / 9;
+        std::vector<size_t> idx(triCount);
+        std::iota(idx.begin(), idx.end(), 0);
+        auto lowest = [&](size_t t)
+        { return std::min(faces[t * 9], std::min(faces[t * 9 + 3], faces[t * 9 + 6])); };
+        std::stable_sort(idx.begin(), idx.end(), [&](size_t a, size_t b)
+                         { return lowest(a) < lowest(b); });
+
+        std::vector<unsigned int> sorted(faces.size());
+        for (size_t t = 0; t < triCount; t++)
+        {
+            std::copy(faces.begin() + idx[t] * 9, faces.begin() + idx[t] * 9 + 9, sorted.begin() + t * 9);
+        }
+        faces.swap(sorted);
+    }
+
+    // renumber an attribute (normals / uvs) so it is stored in the order the faces use it
+    template <typename T>
+    static void renumberByFirstUse(std::vector<unsigned int> &faces, size_t slot, std::vector<T> &attribute)
+    {
+        if (attribute.empty())
+            return;
+        std::vector<unsigned int> newIndex(attribute.size(), ~0u);
+        std::vector<T> result;
+        result.reserve(attribute.size());
+        for (size_t f = slot; f < faces.size(); f += 3)
+        {
+            unsigned int &idx = faces[f];
+            if (idx >= attribute.size())
+                continue;
+            if (newIndex[idx] == ~0u)
+            {
+                newIndex[idx] = (unsigned int)result.size();
+                result.push_back(attribute[idx]);
+            }
+            idx = newIndex[idx];
+        }
+        // keep attributes no face refers to at the end
+        for (size_t i = 0; i < attribute.size(); i++)
+        {
+            if (newIndex[i] == ~0u)
+                result.push_back(attribute[i]);
+        }
+        attribute.swap(result);
+    }
+
+    static void remapConstraints(std::vector<Constraint> &constraints, const std::vector<unsigned int> &newIndex)
+    {
+        for (auto &c : constraints)
+        {
+            unsigned int a = newIndex[c.pair.first], b = newIndex[c.pair.second];
+            c.pair = {std::min(a, b), std::max(a, b)};
+        }
+        std::sort(constraints.begin(), constraints.end(), [](const Constraint &l, const Constraint &r)
+                  { return l.pair < r.pair; });
+    }
+
+    static void remapDihedrals(std::vector<DihedralConstraint> &dihedrals, const std::vector<unsigned int> &newIndex)
+    {
+        for (auto &d : dihedrals)
+        {
+            for (int k = 0; k < 2; k++)
+            {
+                d.edge[k] = newIndex[d.edge[k]];
+                d.wing[k] = newIndex[d.wing[k]];
+            }
+        }
+    }
+};
+
+#endif
@@ -3,12 +3,17 @@
 
 #include <glm/glm.hpp>
 #include <vector>
-#include <set>
-#include <map>
 #include <utility>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <omp.h>
+
+#include <mappedfile.h>
 
 struct Constraint
 {
@@ -16,6 +21,14 @@ struct Constraint
     float distance;
 };
 
+// bending across the edge shared by two triangles, (edge[0], edge[1], wing[0]) and (edge[1], edge[0], wing[1]) keep the mesh winding
+struct DihedralConstraint
+{
+    unsigned int edge[2];
+    unsigned int wing[2]; // vertex opposite to the edge in each triangle
+    float restAngle;      // signed angle between the triangle normals at load time, 0 = flat
+};
+
 struct SoftBodyMesh
 {
     std::vector<glm::vec3> vertices;
@@ -24,8 +37,21 @@ struct SoftBodyMesh
     std::vector<glm::vec2> texCoords;
     std::vector<glm::vec3> velocities;
     std::vector<unsigned int> faces;
+    std::vector<unsigned int> renderCorners; // unique v/vn/vt triples, 3 per render vertex
+    std::vector<unsigned int> renderIndices; // 3 per triangle, index into renderCorners
+    // topology in CSR form, shared by the solver stages
+    std::vector<unsigned int> edges;           // unique triangle edges (a < b), 2 per edge, sorted
+    std::vector<unsigned int> vertexEdgeStart; // edges of vertex i: vertexEdges[vertexEdgeStart[i] .. vertexEdgeStart[i + 1])
+    std::vector<unsigned int> vertexEdges;
+    std::vector<unsigned int> edgeFaceStart; // triangles of edge e: edgeFaces[edgeFaceStart[e] .. edgeFaceStart[e + 1])
+    std::vector<unsigned int> edgeFaces;
+    std::vector<unsigned int> vertexFaceStart; // triangles of vertex i: vertexFaces[vertexFaceStart[i] .. vertexFaceStart[i + 1])
+    std::vector<unsigned int> vertexFaces;
     std::vector<Constraint> structuralPairs;
-    std::vector<Constraint> bendPairs;
+    std::vector<unsigned int> structuralColors; // batch offsets in structuralPairs, constraints of a batch share no vertex
+    std::vector<Constraint> bendPairs; // wing to wing distance across every interior edge
+    std::vector<DihedralConstraint> dihedrals;
+    std::vector<unsigned int> dihedralColors; // batch offsets in dihedrals, dihedrals of a batch share no vertex
     glm::vec3 x_cm_zero;
     std::vector<glm::vec3> x_offset_zero;
 };
@@ -35,136 +61,31 @@ class ObjectLoader
 public:
     static bool loadOBJ(const std::string &filepath, SoftBodyMesh &outMesh)
     {
-        std::ifstream file(filepath);
-        if (!file.is_open())
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        MappedFile file(filepath);
+        if (!file.isOpen())
         {
             std::cerr << "Error: Could not open file " << filepath << std::endl;
             return false;
         }
-        std::vector<glm::vec3> temp_positions;
-        std::vector<glm::vec3> temp_normals;
-        std::set<std::pair<unsigned int, unsigned int>> uniqueStructuralPairs;
-        std::set<std::pair<unsigned int, unsigned int>> uniqueBendPairs;
-        // std::vector<Vec2> temp_texcoords; // Uncomment if you have texture coordinates
-
-        // A map to ensure we only create unique vertices.
-        // The key is a string like "v_idx/vt_idx/vn_idx".
-        // The value is the index in our final `outMesh.vertices` vector.
-        // std::map<std::string, uint32_t> uniqueVertices;
-
-        std::string line;
-        while (std::getline(file, line))
-        {
-            std::stringstream ss(line);
-            std::string prefix;
-            ss >> prefix;
-
-            if (prefix == "v")
-            { // Vertex position
-                glm::vec3 pos;
-                ss >> pos.x >> pos.y >> pos.z;
-                outMesh.vertices.push_back(pos);
-                // outMesh.vertices_zero.push_back(pos);
-            }
-            else if (prefix == "vn")
-            { // Vertex normal
-                glm::vec3 normal;
-                ss >> normal.x >> normal.y >> normal.z;
-                outMesh.normals.push_back(normal);
-            }
-            else if (prefix == "vt")
-            { // Vertex texture coordinate
-                glm::vec2 tex;
-                ss >> tex.x >> tex.y;
-                outMesh.texCoords.push_back(tex);
-            }
-            else if (prefix == "f")
-            {
-                // Face
-                std::string faceVertexStr;
-                //!! support only triangulated v/vn format
-                unsigned int v[3];
-
-                for (size_t i = 0; i < 3; i++)
-                {
-                    ss >> faceVertexStr;
-                    std::cout << faceVertexStr << " | ";
-                    size_t slashPos = faceVertexStr.find("/");
-                    size_t slashPos2 = faceVertexStr.find("/", slashPos + 1);
-                    if (slashPos != std::string::npos)
-                    {
-                        int vertexIndex = std::stoi(faceVertexStr.substr(0, slashPos)) - 1;
-                        int texIndex = std::stoi(faceVertexStr.substr(slashPos + 1, slashPos2)) - 1;
-                        int normalIndex = std::stoi(faceVertexStr.substr(slashPos2 + 1)) - 1;
-                        std::cout << texIndex << "\n";
-                        outMesh.faces.push_back(vertexIndex);
-                        outMesh.faces.push_back(normalIndex);
-                        outMesh.faces.push_back(texIndex);
-
-                        v[i] = vertexIndex;
-                    }
-
-                    // Handle other face formats (e.g., v/vt/vn, v/vt, v) if needed
-                }
-                // --- Generate Structural Springs ---
-                uniqueStructuralPairs.insert(make_canonical_spring(v[0], v[1]));
-                uniqueStructuralPairs.insert(make_canonical_spring(v[1], v[2]));
-                uniqueStructuralPairs.insert(make_canonical_spring(v[2], v[0]));
-            }
-        }
-
-        for (auto &pair : uniqueStructuralPairs)
-        {
-            outMesh.structuralPairs.push_back(
-                {{pair.first, pair.second},
-                 glm::distance(outMesh.vertices[pair.first], outMesh.vertices[pair.second])});
-        }
-        // outMesh.structuralPairs.assign(uniqueStructuralPairs.begin(), uniqueStructuralPairs.end());
-
-        // --- Generate Bend Springs ---
-        // Map from an edge to a list of triangles (by index) that share it
-        std::map<std::pair<unsigned int, unsigned int>, std::vector<size_t>> edgeToFaceMap;
-        for (size_t i = 0; i < outMesh.faces.size(); i += 3)
-        {
-            unsigned int v1 = outMesh.faces[i];
-            unsigned int v2 = outMesh.faces[i + 1];
-            unsigned int v3 = outMesh.faces[i + 2];
-
-            size_t triangleIndex = i / 3;
-            edgeToFaceMap[make_canonical_spring(v1, v2)].push_back(triangleIndex);
-            edgeToFaceMap[make_canonical_spring(v2, v3)].push_back(triangleIndex);
-            edgeToFaceMap[make_canonical_spring(v3, v1)].push_back(triangleIndex);
-        }
+        parseOBJ(file.data(), file.size(), outMesh);
+        file.close();
 
-        for (const auto &pair : edgeToFaceMap)
+        // --- Generate Structural Springs ---
+        // one spring per unique triangle edge, the edge list comes sorted from the topology pass
+        buildTopology(outMesh);
+        size_t edgeCount = outMesh.edges.size() / 2;
+        outMesh.structuralPairs.resize(edgeCount);
+#pragma omp parallel for
+        for (long long e = 0; e < (long long)edgeCount; e++)
         {
-            // Find edges shared by exactly two triangles
-            if (pair.second.size() == 2)
-            {
-                const std::pair<unsigned int, unsigned int> &edge = pair.first;
-
-                // Get the two triangles sharing this edge
-                const unsigned int *tri1 = &outMesh.faces[pair.second[0] * 3];
-                const unsigned int *tri2 = &outMesh.faces[pair.second[1] * 3];
-
-                // Find the third vertex in each triangle (the ones not on the shared edge)
-                unsigned int v3 = find_third_vertex(tri1, edge.first, edge.second);
-                unsigned int v4 = find_third_vertex(tri2, edge.first, edge.second);
-
-                // Add the bend spring
-                if (v3 == v4)
-                    continue;
-                uniqueBendPairs.insert(make_canonical_spring(v3, v4));
-            }
+            unsigned int a = outMesh.edges[e * 2], b = outMesh.edges[e * 2 + 1];
+            outMesh.structuralPairs[e] = {{a, b}, glm::distance(outMesh.vertices[a], outMesh.vertices[b])};
         }
 
-        // for (auto &pair : uniqueBendPairs)
-        // {
-        //     outMesh.bendPairs.push_back(
-        //         {{pair.first, pair.second},
-        //          glm::distance(outMesh.vertices[pair.first], outMesh.vertices[pair.second])});
-        // }
-        // outMesh.bendPairs.assign(uniqueBendPairs.begin(), uniqueBendPairs.end());
+        // --- Generate Bend Constraints ---
+        buildBending(outMesh);
 
         outMesh.velocities = std::vector<glm::vec3>(outMesh.vertices.size(), glm::vec3(0.0f));
 
@@ -193,24 +114,534 @@ public:
             p -= outMesh.x_cm_zero;
         }
 
-        file.close();
+        buildRenderIndices(outMesh);
+
+        std::cout << "Loaded " << filepath << ": " << outMesh.vertices.size() << " vertices, "
+                  << outMesh.faces.size() / 9 << " triangles in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms\n";
         return true;
     }
 
+    /**
+     * Build edge list and CSR adjacency from the triangles
+     * - every triangle edge becomes a packed 64-bit key (min << 32 | max) tagged with its triangle
+     * - keys are sorted in parallel, runs of equal keys are one edge and list its triangles in order
+     * - vertex -> edge and vertex -> triangle lists are filled by counting sort
+     * - must be rebuilt whenever vertices or faces are renumbered
+     */
+    static void buildTopology(SoftBodyMesh &mesh)
+    {
+        size_t triCount = mesh.faces.size() / 9;
+        size_t n = mesh.vertices.size();
+        std::vector<EdgeRef> refs(triCount * 3);
+#pragma omp parallel for
+        for (long long t = 0; t < (long long)triCount; t++)
+        {
+            const unsigned int *tri = &mesh.faces[t * 9];
+            for (int k = 0; k < 3; k++)
+            {
+                refs[t * 3 + k] = {edgeKey(tri[k * 3], tri[((k + 1) % 3) * 3]), (unsigned int)t};
+            }
+        }
+        parallelSort(refs, [](const EdgeRef &l, const EdgeRef &r)
+                     { return l.key < r.key || (l.key == r.key && l.face < r.face); });
+
+        // a new edge starts wherever the key changes
+        std::vector<unsigned int> edgeId(refs.size());
+#pragma omp parallel for
+        for (long long i = 0; i < (long long)refs.size(); i++)
+        {
+            edgeId[i] = (i == 0 || refs[i].key != refs[i - 1].key) ? 1 : 0;
+        }
+        unsigned int edgeCount = 0;
+        for (auto &id : edgeId)
+        {
+            edgeCount += id;
+            id = edgeCount - 1;
+        }
+
+        mesh.edges.resize((size_t)edgeCount * 2);
+        mesh.edgeFaceStart.resize((size_t)edgeCount + 1);
+        mesh.edgeFaces.resize(refs.size());
+        mesh.edgeFaceStart[edgeCount] = (unsigned int)refs.size();
+#pragma omp parallel for
+        for (long long i = 0; i < (long long)refs.size(); i++)
+        {
+            mesh.edgeFaces[i] = refs[i].face;
+            if (i == 0 || refs[i].key != refs[i - 1].key)
+            {
+                unsigned int e = edgeId[i];
+                mesh.edges[e * 2] = (unsigned int)(refs[i].key >> 32);
+                mesh.edges[e * 2 + 1] = (unsigned int)(refs[i].key & 0xffffffffu);
+                mesh.edgeFaceStart[e] = (unsigned int)i;
+            }
+        }
+
+        // edges are sorted by (a, b), so walking them in order keeps each vertex list sorted
+        mesh.vertexEdgeStart.assign(n + 1, 0);
+        for (size_t e = 0; e < edgeCount; e++)
+        {
+            mesh.vertexEdgeStart[mesh.edges[e * 2] + 1]++;
+            mesh.vertexEdgeStart[mesh.edges[e * 2 + 1] + 1]++;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            mesh.vertexEdgeStart[i + 1] += mesh.vertexEdgeStart[i];
+        }
+        mesh.vertexEdges.resize((size_t)edgeCount * 2);
+        std::vector<unsigned int> fill(mesh.vertexEdgeStart.begin(), mesh.vertexEdgeStart.end() - 1);
+        for (unsigned int e = 0; e < edgeCount; e++)
+        {
+            mesh.vertexEdges[fill[mesh.edges[e * 2]]++] = e;
+            mesh.vertexEdges[fill[mesh.edges[e * 2 + 1]]++] = e;
+        }
+
+        mesh.vertexFaceStart.assign(n + 1, 0);
+        for (size_t t = 0; t < triCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                mesh.vertexFaceStart[mesh.faces[t * 9 + k * 3] + 1]++;
+            }
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            mesh.vertexFaceStart[i + 1] += mesh.vertexFaceStart[i];
+        }
+        mesh.vertexFaces.resize(triCount * 3);
+        fill.assign(mesh.vertexFaceStart.begin(), mesh.vertexFaceStart.end() - 1);
+        for (size_t t = 0; t < triCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                mesh.vertexFaces[fill[mesh.faces[t * 9 + k * 3]]++] = (unsigned int)t;
+            }
+        }
+    }
+
+    /**
+     * Bending constraints for every edge shared by exactly two triangles (from the edge -> face CSR)
+     * - dihedrals - edge + both wings with the rest dihedral angle
+     * - bendPairs - wing to wing distance springs (used by Projective Dynamics)
+     * boundary and non-manifold edges get no bending
+     */
+    static void buildBending(SoftBodyMesh &mesh)
+    {
+        size_t edgeCount = mesh.edgeFaceStart.empty() ? 0 : mesh.edgeFaceStart.size() - 1;
+        std::vector<DihedralConstraint> dihedrals(edgeCount);
+        std::vector<char> valid(edgeCount, 0);
+#pragma omp parallel for
+        for (long long e = 0; e < (long long)edgeCount; e++)
+        {
+            if (mesh.edgeFaceStart[e + 1] - mesh.edgeFaceStart[e] != 2)
+                continue;
+            const unsigned int *tri0 = &mesh.faces[(size_t)mesh.edgeFaces[mesh.edgeFaceStart[e]] * 9];
+            const unsigned int *tri1 = &mesh.faces[(size_t)mesh.edgeFaces[mesh.edgeFaceStart[e] + 1] * 9];
+            unsigned int a = mesh.edges[e * 2], b = mesh.edges[e * 2 + 1];
+
+            DihedralConstraint d;
+            // order the edge the way the first triangle walks it
+            bool forward = false;
+            for (int k = 0; k < 3; k++)
+            {
+                forward = forward || (tri0[k * 3] == a && tri0[((k + 1) % 3) * 3] == b);
+            }
+            d.edge[0] = forward ? a : b;
+            d.edge[1] = forward ? b : a;
+            d.wing[0] = find_third_vertex(tri0, a, b);
+            d.wing[1] = find_third_vertex(tri1, a, b);
+            if (d.wing[0] == d.wing[1])
+                continue;
+            d.restAngle = dihedralAngle(mesh.vertices[d.edge[0]], mesh.vertices[d.edge[1]],
+                                        mesh.vertices[d.wing[0]], mesh.vertices[d.wing[1]]);
+            dihedrals[e] = d;
+            valid[e] = 1;
+        }
+
+        mesh.dihedrals.clear();
+        mesh.dihedralColors.clear();
+        std::vector<uint64_t> wingKeys;
+        for (size_t e = 0; e < edgeCount; e++)
+        {
+            if (!valid[e])
+                continue;
+            mesh.dihedrals.push_back(dihedrals[e]);
+            wingKeys.push_back(edgeKey(dihedrals[e].wing[0], dihedrals[e].wing[1]));
+        }
+
+        std::sort(wingKeys.begin(), wingKeys.end());
+        wingKeys.erase(std::unique(wingKeys.begin(), wingKeys.end()), wingKeys.end());
+        mesh.bendPairs.resize(wingKeys.size());
+#pragma omp parallel for
+        for (long long k = 0; k < (long long)wingKeys.size(); k++)
+        {
+            unsigned int a = (unsigned int)(wingKeys[k] >> 32), b = (unsigned int)(wingKeys[k] & 0xffffffffu);
+            mesh.bendPairs[k] = {{a, b}, glm::distance(mesh.vertices[a], mesh.vertices[b])};
+        }
+    }
+
+    /**
+     * Uniformly scale a loaded mesh about the origin, rest shape and constraint lengths included
+     * (dihedral rest angles do not change with scale)
+     */
+    static void scaleMesh(SoftBodyMesh &mesh, float scale)
+    {
+        for (glm::vec3 &v : mesh.vertices)
+            v *= scale;
+        for (glm::vec3 &v : mesh.velocities)
+            v *= scale;
+        for (glm::vec3 &q : mesh.x_offset_zero)
+            q *= scale;
+        mesh.x_cm_zero *= scale;
+        for (Constraint &c : mesh.structuralPairs)
+            c.distance *= scale;
+        for (Constraint &c : mesh.bendPairs)
+            c.distance *= scale;
+    }
+
+    /**
+     * Signed dihedral angle across edge e0 -> e1, w0 / w1 are the wings
+     * 0 for a flat pair, the sign tells on which side of the edge the pair is folded
+     */
+    static float dihedralAngle(const glm::vec3 &e0, const glm::vec3 &e1, const glm::vec3 &w0, const glm::vec3 &w1)
+    {
+        glm::vec3 n0 = glm::cross(w0 - e0, w0 - e1);
+        glm::vec3 n1 = glm::cross(w1 - e1, w1 - e0);
+        float l0 = glm::length(n0), l1 = glm::length(n1), le = glm::length(e1 - e0);
+        if (l0 < 1e-12f || l1 < 1e-12f || le < 1e-12f)
+            return 0.0f;
+        n0 /= l0;
+        n1 /= l1;
+        return std::atan2(glm::dot(glm::cross(n0, n1), (e1 - e0) / le), glm::dot(n0, n1));
+    }
+
+    /**
+     * Sort with OpenMP: every thread sorts a slice, slices are then merged pairwise
+     * small inputs fall back to std::sort
+     */
+    template <typename T, typename Less>
+    static void parallelSort(std::vector<T> &data, Less less)
+    {
+        int slices = omp_get_max_threads();
+        if (slices < 2 || data.size() < (size_t)slices * 4096)
+        {
+            std::sort(data.begin(), data.end(), less);
+            return;
+        }
+        std::vector<size_t> bounds(slices + 1);
+        for (int s = 0; s <= slices; s++)
+        {
+            bounds[s] = data.size() * s / slices;
+        }
+#pragma omp parallel for
+        for (int s = 0; s < slices; s++)
+        {
+            std::sort(data.begin() + bounds[s], data.begin() + bounds[s + 1], less);
+        }
+        for (int width = 1; width < slices; width *= 2)
+        {
+#pragma omp parallel for
+            for (int s = 0; s < slices; s += width * 2)
+            {
+                size_t mid = bounds[std::min(s + width, slices)];
+                size_t end = bounds[std::min(s + width * 2, slices)];
+                std::inplace_merge(data.begin() + bounds[s], data.begin() + mid, data.begin() + end, less);
+            }
+        }
+    }
+
+    /**
+     * De-duplicate face corners into render vertices
+     * - corners with the same v/vn/vt triple share one render vertex
+     * - render vertices are sorted by position index so per frame streaming reads vertices in order
+     * - must be rebuilt whenever faces are renumbered
+     */
+    static void buildRenderIndices(SoftBodyMesh &mesh)
+    {
+        const unsigned int *f = mesh.faces.data();
+        size_t cornerCount = mesh.faces.size() / 3;
+        std::vector<unsigned int> order(cornerCount);
+        for (size_t c = 0; c < cornerCount; c++)
+        {
+            order[c] = (unsigned int)c;
+        }
+        std::sort(order.begin(), order.end(), [f](unsigned int l, unsigned int r)
+                  { return std::lexicographical_compare(f + l * 3, f + l * 3 + 3, f + r * 3, f + r * 3 + 3) ||
+                           (std::equal(f + l * 3, f + l * 3 + 3, f + r * 3) && l < r); });
+
+        mesh.renderCorners.clear();
+        mesh.renderIndices.assign(cornerCount, 0);
+        for (size_t k = 0; k < cornerCount; k++)
+        {
+            unsigned int c = order[k];
+            if (k == 0 || !std::equal(f + c * 3, f + c * 3 + 3, f + order[k - 1] * 3))
+            {
+                mesh.renderCorners.insert(mesh.renderCorners.end(), f + c * 3, f + c * 3 + 3);
+            }
+            mesh.renderIndices[c] = (unsigned int)(mesh.renderCorners.size() / 3 - 1);
+        }
+    }
+
+    /**
+     * Parse OBJ text straight from memory, no per-line allocation
+     * - large files are split at line boundaries and parsed in parallel, then merged
+     * - faces may be v, v/vt, v//vn or v/vt/vn, polygons are fan triangulated
+     * - missing normals/uvs point to a default entry appended at the end
+     */
+    static void parseOBJ(const char *data, size_t size, SoftBodyMesh &outMesh)
+    {
+        const size_t PARALLEL_MIN_BYTES = 1 << 20;
+        int chunk_count = size >= PARALLEL_MIN_BYTES ? std::max(1, omp_get_max_threads()) : 1;
+
+        // chunk boundaries snapped to the start of a line
+        std::vector<const char *> bounds(chunk_count + 1);
+        bounds[0] = data;
+        bounds[chunk_count] = data + size;
+        for (int c = 1; c < chunk_count; c++)
+        {
+            const char *p = data + (size * c) / chunk_count;
+            p = std::max(p, bounds[c - 1]);
+            const char *nl = static_cast<const char *>(memchr(p, '\n', (data + size) - p));
+            bounds[c] = nl ? nl + 1 : data + size;
+        }
+
+        std::vector<OBJChunk> chunks(chunk_count);
+#pragma omp parallel for schedule(static, 1)
+        for (int c = 0; c < chunk_count; c++)
+        {
+            parseChunk(bounds[c], bounds[c + 1], chunks[c]);
+        }
+
+        // prefix counts so chunk local data lands at its global position
+        std::vector<size_t> posStart(chunk_count + 1, 0), nrmStart(chunk_count + 1, 0), texStart(chunk_count + 1, 0), cornerStart(chunk_count + 1, 0);
+        for (int c = 0; c < chunk_count; c++)
+        {
+            posStart[c + 1] = posStart[c] + chunks[c].positions.size();
+            nrmStart[c + 1] = nrmStart[c] + chunks[c].normals.size();
+            texStart[c + 1] = texStart[c] + chunks[c].texCoords.size();
+            cornerStart[c + 1] = cornerStart[c] + chunks[c].corners.size();
+        }
+
+        size_t vertex_base = outMesh.vertices.size();
+        size_t normal_base = outMesh.normals.size();
+        size_t tex_base = outMesh.texCoords.size();
+        size_t face_base = outMesh.faces.size();
+        outMesh.vertices.resize(vertex_base + posStart[chunk_count]);
+        outMesh.normals.resize(normal_base + nrmStart[chunk_count]);
+        outMesh.texCoords.resize(tex_base + texStart[chunk_count]);
+        outMesh.faces.resize(face_base + cornerStart[chunk_count]);
+
+        // missing attributes get one shared default entry
+        bool missing_normal = false, missing_tex = false;
+        for (auto &chunk : chunks)
+        {
+            missing_normal |= chunk.missingNormal;
+            missing_tex |= chunk.missingTex;
+        }
+        unsigned int default_normal = (unsigned int)outMesh.normals.size();
+        unsigned int default_tex = (unsigned int)outMesh.texCoords.size();
+
+#pragma omp parallel for schedule(static, 1)
+        for (int c = 0; c < chunk_count; c++)
+        {
+            OBJChunk &chunk = chunks[c];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), outMesh.vertices.begin() + vertex_base + posStart[c]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), outMesh.normals.begin() + normal_base + nrmStart[c]);
+            std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), outMesh.texCoords.begin() + tex_base + texStart[c]);
+
+            // negative (relative) indices were stored chunk local
+            for (size_t slot : chunk.relative)
+            {
+                size_t prefix = (slot % 3 == 0) ? posStart[c] : (slot % 3 == 1) ? nrmStart[c]
+                                                                                 : texStart[c];
+                chunk.corners[slot] += (long long)prefix;
+            }
+
+            unsigned int *out = outMesh.faces.data() + face_base + cornerStart[c];
+            for (size_t k = 0; k < chunk.corners.size(); k += 3)
+            {
+                long long v = chunk.corners[k], vn = chunk.corners[k + 1], vt = chunk.corners[k + 2];
+                out[k] = (unsigned int)(vertex_base + std::max(0LL, v));
+                out[k + 1] = vn < 0 ? default_normal : (unsigned int)(normal_base + vn);
+                out[k + 2] = vt < 0 ? default_tex : (unsigned int)(tex_base + vt);
+            }
+        }
+
+        if (missing_normal)
+            outMesh.normals.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+        if (missing_tex)
+            outMesh.texCoords.push_back(glm::vec2(0.0f));
+    }
+
 private:
+    // parse result of one slice of the file
+    struct OBJChunk
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<glm::vec2> texCoords;
+        std::vector<long long> corners; // v, vn, vt per triangle corner, 0-based, -1 = missing
+        std::vector<size_t> relative;   // slots in corners that still need the chunk prefix
+        bool missingNormal = false;
+        bool missingTex = false;
+    };
+
+    static void parseChunk(const char *p, const char *end, OBJChunk &chunk)
+    {
+        std::vector<long long> polygon; // corners of the current face line, reused
+        while (p < end)
+        {
+            const char *line_end = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (line_end == nullptr)
+                line_end = end;
+            p = skipSpaces(p, line_end);
+
+            if (line_end - p >= 2 && p[0] == 'v' && isBlank(p[1]))
+            {
+                glm::vec3 pos(0.0f);
+                p = parseFloat(p + 2, line_end, pos.x);
+                p = parseFloat(p, line_end, pos.y);
+                parseFloat(p, line_end, pos.z);
+                chunk.positions.push_back(pos);
+            }
+            else if (line_end - p >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2]))
+            {
+                glm::vec3 normal(0.0f);
+                p = parseFloat(p + 3, line_end, normal.x);
+                p = parseFloat(p, line_end, normal.y);
+                parseFloat(p, line_end, normal.z);
+                chunk.normals.push_back(normal);
+            }
+            else if (line_end - p >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2]))
+            {
+                glm::vec2 tex(0.0f);
+                p = parseFloat(p + 3, line_end, tex.x);
+                parseFloat(p, line_end, tex.y);
+                chunk.texCoords.push_back(tex);
+            }
+            else if (line_end - p >= 2 && p[0] == 'f' && isBlank(p[1]))
+            {
+                polygon.clear();
+                p += 2;
+                while (true)
+                {
+                    p = skipSpaces(p, line_end);
+                    if (p >= line_end || *p == '\r' || *p == '#')
+                        break;
+                    long long v = 0, vt = 0, vn = 0; // 0 = absent, OBJ indices start at 1
+                    const char *token = p;
+                    p = parseIndex(p, line_end, v);
+                    if (p < line_end && *p == '/')
+                    {
+                        p++;
+                        if (p < line_end && *p != '/')
+                            p = parseIndex(p, line_end, vt);
+                        if (p < line_end && *p == '/')
+                            p = parseIndex(p + 1, line_end, vn);
+                    }
+                    if (p == token)
+                        break; // not a number, give up on this line
+
+                    // OBJ order is v/vt/vn, mesh order is v/vn/vt
+                    polygon.push_back(v);
+                    polygon.push_back(vn);
+                    polygon.push_back(vt);
+                }
+
+                // fan triangulation
+                for (size_t k = 2; k * 3 < polygon.size(); k++)
+                {
+                    size_t tri[3] = {0, (k - 1) * 3, k * 3};
+                    for (size_t t = 0; t < 3; t++)
+                    {
+                        addCorner(chunk, polygon[tri[t]], polygon[tri[t] + 1], polygon[tri[t] + 2]);
+                    }
+                }
+            }
+            p = line_end + 1;
+        }
+    }
+
+    // store one corner, resolving 1-based and negative OBJ indices
+    static void addCorner(OBJChunk &chunk, long long v, long long vn, long long vt)
+    {
+        long long raw[3] = {v, vn, vt};
+        size_t counts[3] = {chunk.positions.size(), chunk.normals.size(), chunk.texCoords.size()};
+        for (int k = 0; k < 3; k++)
+        {
+            long long idx = -1;
+            if (raw[k] > 0)
+            {
+                idx = raw[k] - 1;
+            }
+            else if (raw[k] < 0)
+            {
+                idx = (long long)counts[k] + raw[k]; // relative to what this chunk has seen so far
+                chunk.relative.push_back(chunk.corners.size());
+            }
+            else if (k == 1)
+            {
+                chunk.missingNormal = true;
+            }
+            else if (k == 2)
+            {
+                chunk.missingTex = true;
+            }
+            chunk.corners.push_back(idx);
+        }
+    }
+
+    static bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    static const char *skipSpaces(const char *p, const char *end)
+    {
+        while (p < end && isBlank(*p))
+            p++;
+        return p;
+    }
+
+    static const char *parseFloat(const char *p, const char *end, float &out)
+    {
+        p = skipSpaces(p, end);
+        if (p < end && *p == '+')
+            p++;
+        auto result = std::from_chars(p, end, out);
+        return result.ec == std::errc() ? result.ptr : p;
+    }
+
+    static const char *parseIndex(const char *p, const char *end, long long &out)
+    {
+        auto result = std::from_chars(p, end, out);
+        return result.ec == std::errc() ? result.ptr : p;
+    }
+
     // Helper function to create a canonical (sorted) pair for edges/springs
+    struct EdgeRef
+    {
+        uint64_t key;
+        unsigned int face;
+    };
+
+    static uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        return ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+    }
+
     static std::pair<unsigned int, unsigned int> make_canonical_spring(unsigned int v1, unsigned int v2)
     {
         return {std::min(v1, v2), std::max(v1, v2)};
     }
-    // Function to find the third vertex in a triangle given two
+    // Function to find the third vertex in a triangle given two (triangle = 3 v/vn/vt corners)
     static unsigned int find_third_vertex(const unsigned int *triangle, unsigned int v1, unsigned int v2)
     {
         if (triangle[0] != v1 && triangle[0] != v2)
             return triangle[0];
-        if (triangle[1] != v1 && triangle[1] != v2)
-            return triangle[1];
-        return triangle[2];
+        if (triangle[3] != v1 && triangle[3] != v2)
+            return triangle[3];
+        return triangle[6];
     }
 };
 
@@ -0,0 +1,260 @@
+#ifndef RANGECODER_H
+#define RANGECODER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Adaptive binary range coder (LZMA style)
+ * - 11 bit probabilities adapted with a shift of 5, 32 bit range, carries propagate through one cached byte
+ * - BitTree codes a BITS wide symbol MSB first with one probability per tree node
+ * - direct bits bypass the model, for the nearly uniform low bits of a value
+ */
+class RangeEncoder
+{
+public:
+    static constexpr int PROB_BITS = 11;
+    static constexpr uint16_t PROB_INIT = 1 << (PROB_BITS - 1);
+    static constexpr int MOVE_BITS = 5;
+
+    // appends to out
+    explicit RangeEncoder(std::vector<uint8_t> &out) : out(out) {}
+
+    void encodeBit(uint16_t &prob, int bit)
+    {
+        uint32_t bound = (range >> PROB_BITS) * prob;
+        if (bit == 0)
+        {
+            range = bound;
+            prob += ((1 << PROB_BITS) - prob) >> MOVE_BITS;
+        }
+        else
+        {
+            low += bound;
+            range -= bound;
+            prob -= prob >> MOVE_BITS;
+        }
+        normalize();
+    }
+
+    // bits low bits of value, MSB first, probability 1/2 each
+    void encodeDirect(uint32_t value, int bits)
+    {
+        for (int b = bits - 1; b >= 0; b--)
+        {
+            range >>= 1;
+            if ((value >> b) & 1)
+                low += range;
+            normalize();
+        }
+    }
+
+    // flush the pending bytes, the encoder is done afterwards
+    void finish()
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            shiftLow();
+        }
+    }
+
+private:
+    std::vector<uint8_t> &out;
+    uint64_t low = 0;
+    uint32_t range = 0xFFFFFFFFu;
+    uint8_t cache = 0;
+    uint64_t cacheSize = 1;
+
+    void normalize()
+    {
+        while (range < (1u << 24))
+        {
+            range <<= 8;
+            shiftLow();
+        }
+    }
+
+    void shiftLow()
+    {
+        if ((uint32_t)low < 0xFF000000u || (low >> 32) != 0)
+        {
+            uint8_t carry = (uint8_t)(low >> 32);
+            uint8_t temp = cache;
+            do
+            {
+                out.push_back((uint8_t)(temp + carry));
+                temp = 0xFF;
+            } while (--cacheSize != 0);
+            cache = (uint8_t)(low >> 24);
+        }
+        cacheSize++;
+        low = (low & 0x00FFFFFFu) << 8;
+    }
+};
+
+class RangeDecoder
+{
+public:
+    // reads past the end return zeros, a truncated stream decodes to garbage but never out of bounds
+    RangeDecoder(const uint8_t *data, size_t size) : data(data), end(data + size)
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            code = (code << 8) | next();
+        }
+    }
+
+    int decodeBit(uint16_t &prob)
+    {
+        uint32_t bound = (range >> RangeEncoder::PROB_BITS) * prob;
+        int bit;
+        if (code < bound)
+        {
+            range = bound;
+            prob += ((1 << RangeEncoder::PROB_BITS) - prob) >> RangeEncoder::MOVE_BITS;
+            bit = 0;
+        }
+        else
+        {
+            code -= bound;
+            range -= bound;
+            prob -= prob >> RangeEncoder::MOVE_BITS;
+            bit = 1;
+        }
+        normalize();
+        return bit;
+    }
+
+    uint32_t decodeDirect(int bits)
+    {
+        uint32_t value = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            range >>= 1;
+            uint32_t bit = code >= range ? 1 : 0;
+            code -= range & (0u - bit);
+            value = (value << 1) | bit;
+            normalize();
+        }
+        return value;
+    }
+
+private:
+    const uint8_t *data;
+    const uint8_t *end;
+    uint32_t range = 0xFFFFFFFFu;
+    uint32_t code = 0;
+
+    uint8_t next()
+    {
+        return data < end ? *data++ : 0;
+    }
+
+    void normalize()
+    {
+        while (range < (1u << 24))
+        {
+            range <<= 8;
+            code = (code << 8) | next();
+        }
+    }
+};
+
+// BITS wide symbol, one adaptive probability per inner node of the binary tree
+template <int BITS>
+struct BitTree
+{
+    uint16_t probs[1 << BITS];
+
+    BitTree()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (uint16_t &p : probs)
+        {
+            p = RangeEncoder::PROB_INIT;
+        }
+    }
+
+    void encode(RangeEncoder &rc, uint32_t symbol)
+    {
+        uint32_t node = 1;
+        for (int b = BITS - 1; b >= 0; b--)
+        {
+            int bit = (symbol >> b) & 1;
+            rc.encodeBit(probs[node], bit);
+            node = (node << 1) | bit;
+        }
+    }
+
+    uint32_t decode(RangeDecoder &rc)
+    {
+        uint32_t node = 1;
+        for (int b = 0; b < BITS; b++)
+        {
+            node = (node << 1) | rc.decodeBit(probs[node]);
+        }
+        return node - (1u << BITS);
+    }
+};
+
+/**
+ * Adaptive coder of small unsigned integers (below 2^31), Elias-gamma like:
+ * - the bit length goes through a BitTree, so the model learns the magnitude distribution
+ * - the bit under the leading one is modeled per length, the rest are direct bits
+ */
+struct AdaptiveIntegerCoder
+{
+    BitTree<5> lengths;
+    uint16_t secondBit[32];
+
+    AdaptiveIntegerCoder()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        lengths.reset();
+        for (uint16_t &p : secondBit)
+        {
+            p = RangeEncoder::PROB_INIT;
+        }
+    }
+
+    void encode(RangeEncoder &rc, uint32_t value)
+    {
+        int length = bitLength(value);
+        lengths.encode(rc, (uint32_t)length);
+        if (length < 2)
+            return;
+        rc.encodeBit(secondBit[length], (value >> (length - 2)) & 1);
+        rc.encodeDirect(value, length - 2);
+    }
+
+    uint32_t decode(RangeDecoder &rc)
+    {
+        int length = (int)lengths.decode(rc);
+        if (length < 2)
+            return (uint32_t)length;
+        uint32_t value = 2u | (uint32_t)rc.decodeBit(secondBit[length]);
+        return (value << (length - 2)) | rc.decodeDirect(length - 2);
+    }
+
+    static int bitLength(uint32_t value)
+    {
+        int length = 0;
+        while (value != 0)
+        {
+            value >>= 1;
+            length++;
+        }
+        return length;
+    }
+};
+
+#endif
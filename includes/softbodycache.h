@@ -0,0 +1,281 @@
+#ifndef SOFTBODYCACHE_H
+#define SOFTBODYCACHE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <chrono>
+#include <iostream>
+#include <type_traits>
+
+#include <objectloader.h>
+#include <meshoptimizer.h>
+#include <mappedfile.h>
+
+/**
+ * Binary cache (.sbm) of a fully preprocessed soft body mesh
+ * - holds the mesh after loading + locality pass: geometry, render indices, CSR topology, constraints, bending, colors, rest offsets
+ * - keyed on a hash of the source OBJ bytes, a stale or foreign cache is rebuilt automatically
+ * - loading maps the file and copies each section straight into the mesh, no parsing
+ */
+class SoftBodyMeshCache
+{
+public:
+    // bump whenever the preprocessing changes what ends up in the mesh
+    static constexpr uint32_t VERSION = 4;
+
+    /**
+     * Load objPath through its .sbm cache
+     * - cache hit: sections are copied from the mapping
+     * - cache miss: loadOBJ + optimizeForLocality, then the cache is written next to the OBJ
+     */
+    static bool load(const std::string &objPath, SoftBodyMesh &outMesh)
+    {
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        uint64_t hash;
+        {
+            MappedFile source(objPath);
+            if (!source.isOpen())
+            {
+                std::cerr << "Error: Could not open file " << objPath << std::endl;
+                return false;
+            }
+            hash = hashBytes(source.data(), source.size());
+        }
+
+        std::string path = cachePath(objPath);
+        if (read(path, hash, outMesh))
+        {
+            std::cout << "Loaded " << path << ": " << outMesh.vertices.size() << " vertices, "
+                      << outMesh.faces.size() / 9 << " triangles in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count() << " ms\n";
+            return true;
+        }
+
+        outMesh = SoftBodyMesh();
+        if (!ObjectLoader::loadOBJ(objPath, outMesh))
+            return false;
+        MeshOptimizer::optimizeForLocality(outMesh, true);
+
+        if (!write(path, hash, outMesh))
+        {
+            std::cerr << "Warning: Could not write mesh cache " << path << std::endl;
+        }
+        return true;
+    }
+
+    // "dir/name.obj" -> "dir/name.sbm"
+    static std::string cachePath(const std::string &objPath)
+    {
+        size_t dot = objPath.find_last_of('.');
+        size_t slash = objPath.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            return objPath + ".sbm";
+        return objPath.substr(0, dot) + ".sbm";
+    }
+
+    // 64-bit FNV-1a over 8 byte words, enough to detect an edited source file
+    static uint64_t hashBytes(const char *data, size_t size)
+    {
+        uint64_t h = 14695981039346656037ull ^ (uint64_t)size;
+        const uint64_t prime = 1099511628211ull;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            h = (h ^ word) * prime;
+        }
+        for (; i < size; i++)
+        {
+            h = (h ^ (unsigned char)data[i]) * prime;
+        }
+        return h;
+    }
+
+    static bool read(const std::string &path, uint64_t sourceHash, SoftBodyMesh &outMesh)
+    {
+        MappedFile file(path);
+        if (!file.isOpen() || file.size() < sizeof(Header))
+            return false;
+
+        Header header;
+        std::memcpy(&header, file.data(), sizeof(Header));
+        if (std::memcmp(header.magic, MAGIC, 4) != 0 || header.version != VERSION ||
+            header.sourceHash != sourceHash || header.sectionCount != SECTION_COUNT)
+            return false;
+        for (uint32_t s = 0; s < SECTION_COUNT; s++)
+        {
+            const Section &sec = header.sections[s];
+            if (sec.elementSize != ELEMENT_SIZE[s] || sec.offset > file.size() ||
+                sec.count > (file.size() - sec.offset) / sec.elementSize)
+                return false;
+        }
+
+        SoftBodyMesh mesh;
+        readSection(file, header, VERTICES, mesh.vertices);
+        readSection(file, header, NORMALS, mesh.normals);
+        readSection(file, header, TEXCOORDS, mesh.texCoords);
+        readSection(file, header, FACES, mesh.faces);
+        readSection(file, header, RENDER_CORNERS, mesh.renderCorners);
+        readSection(file, header, RENDER_INDICES, mesh.renderIndices);
+        readSection(file, header, EDGES, mesh.edges);
+        readSection(file, header, VERTEX_EDGE_START, mesh.vertexEdgeStart);
+        readSection(file, header, VERTEX_EDGES, mesh.vertexEdges);
+        readSection(file, header, EDGE_FACE_START, mesh.edgeFaceStart);
+        readSection(file, header, EDGE_FACES, mesh.edgeFaces);
+        readSection(file, header, VERTEX_FACE_START, mesh.vertexFaceStart);
+        readSection(file, header, VERTEX_FACES, mesh.vertexFaces);
+        readSection(file, header, STRUCTURAL_PAIRS, mesh.structuralPairs);
+        readSection(file, header, STRUCTURAL_COLORS, mesh.structuralColors);
+        readSection(file, header, BEND_PAIRS, mesh.bendPairs);
+        readSection(file, header, DIHEDRALS, mesh.dihedrals);
+        readSection(file, header, DIHEDRAL_COLORS, mesh.dihedralColors);
+        readSection(file, header, X_OFFSET_ZERO, mesh.x_offset_zero);
+        mesh.x_cm_zero = glm::vec3(header.x_cm_zero[0], header.x_cm_zero[1], header.x_cm_zero[2]);
+        mesh.velocities.assign(mesh.vertices.size(), glm::vec3(0.0f));
+
+        outMesh = std::move(mesh);
+        return true;
+    }
+
+    // written to a temporary file first so a crash never leaves a half written cache behind
+    static bool write(const std::string &path, uint64_t sourceHash, const SoftBodyMesh &mesh)
+    {
+        Header header = {};
+        std::memcpy(header.magic, MAGIC, 4);
+        header.version = VERSION;
+        header.sourceHash = sourceHash;
+        header.x_cm_zero[0] = mesh.x_cm_zero.x;
+        header.x_cm_zero[1] = mesh.x_cm_zero.y;
+        header.x_cm_zero[2] = mesh.x_cm_zero.z;
+        header.sectionCount = SECTION_COUNT;
+
+        const void *payload[SECTION_COUNT];
+        uint64_t offset = align(sizeof(Header));
+        auto place = [&](SectionId id, const auto &data)
+        {
+            header.sections[id] = {offset, (uint64_t)data.size(), ELEMENT_SIZE[id], 0};
+            payload[id] = data.data();
+            offset = align(offset + data.size() * ELEMENT_SIZE[id]);
+        };
+        place(VERTICES, mesh.vertices);
+        place(NORMALS, mesh.normals);
+        place(TEXCOORDS, mesh.texCoords);
+        place(FACES, mesh.faces);
+        place(RENDER_CORNERS, mesh.renderCorners);
+        place(RENDER_INDICES, mesh.renderIndices);
+        place(EDGES, mesh.edges);
+        place(VERTEX_EDGE_START, mesh.vertexEdgeStart);
+        place(VERTEX_EDGES, mesh.vertexEdges);
+        place(EDGE_FACE_START, mesh.edgeFaceStart);
+        place(EDGE_FACES, mesh.edgeFaces);
+        place(VERTEX_FACE_START, mesh.vertexFaceStart);
+        place(VERTEX_FACES, mesh.vertexFaces);
+        place(STRUCTURAL_PAIRS, mesh.structuralPairs);
+        place(STRUCTURAL_COLORS, mesh.structuralColors);
+        place(BEND_PAIRS, mesh.bendPairs);
+        place(DIHEDRALS, mesh.dihedrals);
+        place(DIHEDRAL_COLORS, mesh.dihedralColors);
+        place(X_OFFSET_ZERO, mesh.x_offset_zero);
+
+        std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+            uint64_t written = sizeof(Header);
+            const char zeros[ALIGNMENT] = {};
+            for (uint32_t s = 0; s < SECTION_COUNT; s++)
+            {
+                const Section &sec = header.sections[s];
+                out.write(zeros, (std::streamsize)(sec.offset - written));
+                out.write(static_cast<const char *>(payload[s]), (std::streamsize)(sec.count * sec.elementSize));
+                written = sec.offset + sec.count * sec.elementSize;
+            }
+            if (!out)
+                return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    enum SectionId : uint32_t
+    {
+        VERTICES,
+        NORMALS,
+        TEXCOORDS,
+        FACES,
+        RENDER_CORNERS,
+        RENDER_INDICES,
+        EDGES,
+        VERTEX_EDGE_START,
+        VERTEX_EDGES,
+        EDGE_FACE_START,
+        EDGE_FACES,
+        VERTEX_FACE_START,
+        VERTEX_FACES,
+        STRUCTURAL_PAIRS,
+        STRUCTURAL_COLORS,
+        BEND_PAIRS,
+        DIHEDRALS,
+        DIHEDRAL_COLORS,
+        X_OFFSET_ZERO,
+        SECTION_COUNT
+    };
+
+    struct Section
+    {
+        uint64_t offset; // from start of file, ALIGNMENT aligned
+        uint64_t count;  // elements
+        uint32_t elementSize;
+        uint32_t reserved;
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        float x_cm_zero[3];
+        uint32_t sectionCount;
+        Section sections[SECTION_COUNT];
+    };
+
+    static constexpr char MAGIC[4] = {'S', 'B', 'M', '\0'};
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr uint32_t ELEMENT_SIZE[SECTION_COUNT] = {
+        sizeof(glm::vec3), sizeof(glm::vec3), sizeof(glm::vec2), sizeof(unsigned int), sizeof(unsigned int),
+        sizeof(unsigned int), sizeof(unsigned int), sizeof(unsigned int), sizeof(unsigned int), sizeof(unsigned int),
+        sizeof(unsigned int), sizeof(unsigned int), sizeof(unsigned int),
+        sizeof(Constraint), sizeof(unsigned int), sizeof(Constraint), sizeof(DihedralConstraint),
+        sizeof(unsigned int), sizeof(glm::vec3)};
+
+    // sections are raw memory images of the vectors
+    static_assert(std::is_standard_layout<Constraint>::value && sizeof(Constraint) == 12, "Constraint layout changed, bump VERSION");
+    static_assert(std::is_trivially_copyable<DihedralConstraint>::value && sizeof(DihedralConstraint) == 20, "DihedralConstraint layout changed, bump VERSION");
+    static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::vec2) == 8, "unexpected glm layout");
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    template <typename T>
+    static void readSection(const MappedFile &file, const Header &header, SectionId id, std::vector<T> &out)
+    {
+        const Section &sec = header.sections[id];
+        out.resize((size_t)sec.count);
+        if (sec.count > 0)
+            std::memcpy(static_cast<void *>(out.data()), file.data() + sec.offset, (size_t)(sec.count * sec.elementSize));
+    }
+};
+
+#endif
@@ -0,0 +1,565 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include <mappedfile.h>
+#include <rangecoder.h>
+#include <Physics/SPHSolver.h>
+#include <Physics/SoftBodyWorld.h>
+
+/**
+ * Compressed trajectory (.traj) of the fluid particles and soft body vertices, for reviewing long runs
+ * - positions are quantized to QUANT_BITS per axis inside the recorded box
+ * - every value is predicted from the previous frames of its particle (linear extrapolation, or the previous frame
+ *   right after a keyframe), keyframes predict from the previous particle of the same frame
+ * - the residuals are zigzag mapped and range coded with adaptive models, one model per axis and stream
+ * - a frame only depends on the frames back to its keyframe, the index table at the end of the file gives
+ *   the offset of every frame, so a seek is one lookup plus at most KEYFRAME_INTERVAL - 1 frame decodes
+ * - file layout: FileHeader | (FrameHeader payload)* | padding to 8 | uint64 offset per frame
+ */
+class TrajectoryCodec
+{
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr char MAGIC[4] = {'T', 'R', 'J', '\0'};
+
+    struct FileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t quantBits;
+        uint32_t keyframeInterval;
+        float boxMin[3];
+        float boxMax[3];
+        uint64_t frameCount;  // 0 while recording
+        uint64_t indexOffset; // 0 while recording, the reader then scans the frames
+    };
+
+    struct FrameHeader
+    {
+        uint32_t fluidCount;
+        uint32_t softCount;
+        uint32_t payloadSize; // range coded bytes following the header
+        uint32_t keyframe;
+        double time; // simulation time
+    };
+
+    enum Stream
+    {
+        FLUID,
+        SOFT,
+        STREAM_COUNT
+    };
+
+    void setup(glm::vec3 boxMin, glm::vec3 boxMax, int quantBits)
+    {
+        this->boxMin = boxMin;
+        maxQ = (1u << quantBits) - 1u;
+        glm::vec3 extent = glm::max(boxMax - boxMin, glm::vec3(1e-6f));
+        step = extent / (float)maxQ;
+        invStep = (float)maxQ / extent;
+        reset();
+    }
+
+    // forget the history, the next frame has to be a keyframe
+    void reset()
+    {
+        history = 0;
+        for (int s = 0; s < STREAM_COUNT; s++)
+        {
+            previous[s].clear();
+            beforePrevious[s].clear();
+        }
+    }
+
+    // quantize, predict and range code one frame, appends to out
+    void encode(bool keyframe, const glm::vec3 *fluid, size_t fluidCount, const glm::vec3 *soft, size_t softCount, std::vector<uint8_t> &out)
+    {
+        if (keyframe)
+            reset();
+        RangeEncoder rc(out);
+        const glm::vec3 *source[STREAM_COUNT] = {fluid, soft};
+        size_t count[STREAM_COUNT] = {fluidCount, softCount};
+        for (int s = 0; s < STREAM_COUNT; s++)
+        {
+            std::vector<uint16_t> &q = current[s];
+            q.resize(count[s] * 3);
+            for (size_t i = 0; i < count[s]; i++)
+            {
+                glm::vec3 cell = glm::round((source[s][i] - boxMin) * invStep);
+                for (int a = 0; a < 3; a++)
+                {
+                    q[i * 3 + a] = (uint16_t)std::min(std::max(cell[a], 0.0f), (float)maxQ);
+                }
+            }
+
+            for (int a = 0; a < 3; a++)
+            {
+                coders[a].reset();
+            }
+            for (size_t k = 0; k < q.size(); k++)
+            {
+                int residual = (int)q[k] - predict((Stream)s, k);
+                coders[k % 3].encode(rc, zigzag(residual));
+            }
+        }
+        rc.finish();
+        advance();
+    }
+
+    // inverse of encode, frames have to come in recording order from a keyframe on
+    void decode(bool keyframe, const uint8_t *payload, size_t payloadSize, glm::vec3 *fluid, size_t fluidCount, glm::vec3 *soft, size_t softCount)
+    {
+        if (keyframe)
+            reset();
+        RangeDecoder rc(payload, payloadSize);
+        glm::vec3 *target[STREAM_COUNT] = {fluid, soft};
+        size_t count[STREAM_COUNT] = {fluidCount, softCount};
+        for (int s = 0; s < STREAM_COUNT; s++)
+        {
+            std::vector<uint16_t> &q = current[s];
+            q.resize(count[s] * 3);
+            for (int a = 0; a < 3; a++)
+            {
+                coders[a].reset();
+            }
+            for (size_t k = 0; k < q.size(); k++)
+            {
+                int value = predict((Stream)s, k) + unzigzag(coders[k % 3].decode(rc));
+                q[k] = (uint16_t)std::min(std::max(value, 0), (int)maxQ);
+            }
+            for (size_t i = 0; i < count[s]; i++)
+            {
+                target[s][i] = boxMin + glm::vec3(q[i * 3], q[i * 3 + 1], q[i * 3 + 2]) * step;
+            }
+        }
+        advance();
+    }
+
+private:
+    glm::vec3 boxMin = glm::vec3(0.0f);
+    glm::vec3 step = glm::vec3(1.0f);
+    glm::vec3 invStep = glm::vec3(1.0f);
+    uint32_t maxQ = 65535;
+    int history = 0; // frames since the keyframe, capped at 2
+    std::vector<uint16_t> current[STREAM_COUNT];
+    std::vector<uint16_t> previous[STREAM_COUNT];
+    std::vector<uint16_t> beforePrevious[STREAM_COUNT];
+    AdaptiveIntegerCoder coders[3];
+
+    // value k (particle k / 3, axis k % 3) of stream s, from the history or from the previous particle
+    int predict(Stream s, size_t k) const
+    {
+        if (history >= 1 && k < previous[s].size())
+        {
+            int last = previous[s][k];
+            if (history >= 2 && k < beforePrevious[s].size())
+                return std::min(std::max(2 * last - (int)beforePrevious[s][k], 0), (int)maxQ);
+            return last;
+        }
+        return k >= 3 ? (int)current[s][k - 3] : (int)(maxQ / 2);
+    }
+
+    void advance()
+    {
+        for (int s = 0; s < STREAM_COUNT; s++)
+        {
+            std::swap(beforePrevious[s], previous[s]);
+            std::swap(previous[s], current[s]);
+        }
+        history = std::min(history + 1, 2);
+    }
+
+    static uint32_t zigzag(int value)
+    {
+        return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    }
+
+    static int unzigzag(uint32_t value)
+    {
+        return (int)(value >> 1) ^ -(int)(value & 1);
+    }
+};
+
+/**
+ * Streams frames to a .traj file from a background thread
+ * - record() copies the positions into a slot of a bounded single producer / single consumer ring and returns,
+ *   quantizing, coding and writing happen on the worker
+ * - the ring is lock free: head and tail are atomics, each side only writes its own, slots keep their capacity
+ * - a full ring either drops the frame (DROP_WHEN_FULL) or makes record() wait for the worker
+ * - the first failed write (full disk, I/O error) stops the recording: record() refuses frames and close() leaves the
+ *   index out, the file then reads like an unfinished recording up to the last complete frame
+ */
+class TrajectoryWriter
+{
+public:
+    //=======[adjustable parameters]========
+    int QUANT_BITS = 16;        // per axis, at most 16
+    int KEYFRAME_INTERVAL = 60; // frames between keyframes, bounds the decode work of a seek
+    int RECORD_EVERY = 4;       // record() calls per stored frame, e.g. solver steps per displayed frame
+    bool DROP_WHEN_FULL = false;
+    //======================================
+
+    static constexpr size_t QUEUE_SIZE = 8; // power of two
+
+    // stats, readable from any thread
+    std::atomic<uint64_t> framesWritten{0};
+    std::atomic<uint64_t> framesDropped{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> rawBytes{0}; // what the frames would take as plain glm::vec3
+    std::atomic<float> lastEncodeMs{0.0f};
+    std::atomic<bool> writeFailed{false}; // set by the first failed write, cleared by open()
+
+    TrajectoryWriter() {}
+    ~TrajectoryWriter()
+    {
+        close();
+    }
+
+    TrajectoryWriter(const TrajectoryWriter &) = delete;
+    TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+    // start a recording, positions outside [boxMin, boxMax] are clamped to it
+    bool open(const std::string &path, glm::vec3 boxMin, glm::vec3 boxMax)
+    {
+        close();
+        file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+            return false;
+        int bits = std::min(std::max(QUANT_BITS, 1), 16);
+        header = {};
+        std::memcpy(header.magic, TrajectoryCodec::MAGIC, 4);
+        header.version = TrajectoryCodec::VERSION;
+        header.quantBits = (uint32_t)bits;
+        header.keyframeInterval = (uint32_t)std::max(KEYFRAME_INTERVAL, 1);
+        for (int a = 0; a < 3; a++)
+        {
+            header.boxMin[a] = boxMin[a];
+            header.boxMax[a] = boxMax[a];
+        }
+        writeFailed = false;
+        if (std::fwrite(&header, sizeof(header), 1, file) != 1)
+        {
+            writeFailed = true;
+            std::fclose(file);
+            file = nullptr;
+            return false;
+        }
+        codec.setup(boxMin, boxMax, bits);
+        offsets.clear();
+        fileOffset = sizeof(header);
+        framesWritten = framesDropped = bytesWritten = rawBytes = 0;
+        head = tail = 0;
+        calls = 0;
+        stopping = false;
+        worker = std::thread(&TrajectoryWriter::run, this);
+        return true;
+    }
+
+    bool isOpen() const
+    {
+        return file != nullptr;
+    }
+
+    // queue one frame, false when it was dropped
+    bool record(double time, const glm::vec3 *fluid, size_t fluidCount, const glm::vec3 *soft, size_t softCount)
+    {
+        if (file == nullptr || writeFailed.load(std::memory_order_relaxed))
+            return false;
+        if (calls++ % (uint64_t)std::max(RECORD_EVERY, 1) != 0)
+            return true;
+        size_t t = tail.load(std::memory_order_relaxed);
+        while (t - head.load(std::memory_order_acquire) >= QUEUE_SIZE)
+        {
+            if (DROP_WHEN_FULL)
+            {
+                framesDropped++;
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        Slot &slot = slots[t & (QUEUE_SIZE - 1)];
+        slot.time = time;
+        slot.fluid.assign(fluid, fluid + fluidCount);
+        slot.soft.assign(soft, soft + softCount);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // the alive particles of the solver and the vertex pool of the world, either may be nullptr
+    bool record(double time, const SPHSolver *solver, const SoftBodyWorld *world)
+    {
+        return record(time, solver != nullptr ? solver->positions.data() : nullptr, solver != nullptr ? (size_t)solver->alive : 0,
+                      world != nullptr ? world->positions.data() : nullptr, world != nullptr ? world->positions.size() : 0);
+    }
+
+    /**
+     * Drain the queue, append the index table and finalize the header
+     * - fwrite only fills the stdio buffer, the flush before the header tells whether the frames reached the file;
+     *   a header naming an index is written only after the index itself made it
+     */
+    void close()
+    {
+        if (file == nullptr)
+            return;
+        stopping.store(true, std::memory_order_release);
+        worker.join();
+
+        if (!writeFailed)
+        {
+            uint64_t indexOffset = (fileOffset + 7) / 8 * 8;
+            const char zeros[8] = {};
+            size_t padding = (size_t)(indexOffset - fileOffset);
+            bool ok = std::fwrite(zeros, 1, padding, file) == padding &&
+                      std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size() &&
+                      std::fflush(file) == 0;
+            if (ok)
+            {
+                header.frameCount = offsets.size();
+                header.indexOffset = indexOffset;
+                ok = std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+            }
+            if (!ok)
+                writeFailed = true;
+        }
+        if (std::fclose(file) != 0)
+            writeFailed = true;
+        file = nullptr;
+    }
+
+private:
+    struct Slot
+    {
+        double time = 0.0;
+        std::vector<glm::vec3> fluid;
+        std::vector<glm::vec3> soft;
+    };
+
+    Slot slots[QUEUE_SIZE];
+    std::atomic<size_t> head{0}; // next slot the worker reads, written by the worker
+    std::atomic<size_t> tail{0}; // next slot record() fills, written by record()
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+    uint64_t calls = 0; // record() only
+
+    // worker only while recording
+    FILE *file = nullptr;
+    TrajectoryCodec::FileHeader header = {};
+    TrajectoryCodec codec;
+    std::vector<uint8_t> payload;
+    std::vector<uint64_t> offsets;
+    uint64_t fileOffset = 0;
+
+    void run()
+    {
+        while (true)
+        {
+            size_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire))
+            {
+                if (stopping.load(std::memory_order_acquire) && h == tail.load(std::memory_order_acquire))
+                    return;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            writeFrame(slots[h & (QUEUE_SIZE - 1)]);
+            head.store(h + 1, std::memory_order_release);
+        }
+    }
+
+    void writeFrame(const Slot &slot)
+    {
+        if (writeFailed.load(std::memory_order_relaxed))
+            return; // frames queued before the failure are dropped
+        auto start_time = std::chrono::high_resolution_clock::now();
+        bool keyframe = offsets.size() % header.keyframeInterval == 0;
+        payload.clear();
+        codec.encode(keyframe, slot.fluid.data(), slot.fluid.size(), slot.soft.data(), slot.soft.size(), payload);
+
+        TrajectoryCodec::FrameHeader frame = {(uint32_t)slot.fluid.size(), (uint32_t)slot.soft.size(),
+                                              (uint32_t)payload.size(), keyframe ? 1u : 0u, slot.time};
+        if (std::fwrite(&frame, sizeof(frame), 1, file) != 1 ||
+            std::fwrite(payload.data(), 1, payload.size(), file) != payload.size())
+        {
+            writeFailed = true;
+            return;
+        }
+        offsets.push_back(fileOffset);
+        fileOffset += sizeof(frame) + payload.size();
+
+        framesWritten++;
+        bytesWritten += sizeof(frame) + payload.size();
+        rawBytes += (slot.fluid.size() + slot.soft.size()) * sizeof(glm::vec3);
+        lastEncodeMs = (float)std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start_time).count();
+    }
+};
+
+/**
+ * Random access over a mapped .traj file
+ * - the index table is used in place inside the mapping; a recording that was never closed is indexed by
+ *   walking the frame headers, everything up to the first incomplete frame plays
+ * - readFrame() continues from the last decoded frame when it can, otherwise it restarts at the keyframe
+ */
+class TrajectoryReader
+{
+public:
+    TrajectoryReader() {}
+    explicit TrajectoryReader(const std::string &path)
+    {
+        open(path);
+    }
+
+    TrajectoryReader(const TrajectoryReader &) = delete;
+    TrajectoryReader &operator=(const TrajectoryReader &) = delete;
+
+    bool open(const std::string &path)
+    {
+        close();
+        if (!file.open(path) || file.size() < sizeof(TrajectoryCodec::FileHeader))
+            return fail();
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, TrajectoryCodec::MAGIC, 4) != 0 || header.version != TrajectoryCodec::VERSION ||
+            header.quantBits < 1 || header.quantBits > 16 || header.keyframeInterval == 0)
+            return fail();
+
+        bool hasIndex = header.indexOffset != 0 && header.indexOffset % 8 == 0 && header.indexOffset <= file.size();
+        if (hasIndex && header.frameCount <= (file.size() - header.indexOffset) / sizeof(uint64_t) &&
+            indexValid(reinterpret_cast<const uint64_t *>(file.data() + header.indexOffset), (size_t)header.frameCount))
+        {
+            index = reinterpret_cast<const uint64_t *>(file.data() + header.indexOffset);
+            frames = (size_t)header.frameCount;
+        }
+        else
+        {
+            // unfinished recording or a damaged index, the frames are found by walking their headers
+            uint64_t end = hasIndex ? header.indexOffset : file.size();
+            uint64_t offset = sizeof(header);
+            while (offset + sizeof(TrajectoryCodec::FrameHeader) <= end)
+            {
+                TrajectoryCodec::FrameHeader frame;
+                std::memcpy(&frame, file.data() + offset, sizeof(frame));
+                uint64_t next = offset + sizeof(frame) + frame.payloadSize;
+                if (next > end)
+                    break;
+                scannedIndex.push_back(offset);
+                offset = next;
+            }
+            index = scannedIndex.data();
+            frames = scannedIndex.size();
+        }
+        codec.setup(boxMin(), boxMax(), (int)header.quantBits);
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        scannedIndex.clear();
+        index = nullptr;
+        frames = 0;
+        decoded = SIZE_MAX;
+    }
+
+    bool isOpen() const
+    {
+        return file.isOpen();
+    }
+
+    size_t frameCount() const
+    {
+        return frames;
+    }
+
+    glm::vec3 boxMin() const
+    {
+        return glm::vec3(header.boxMin[0], header.boxMin[1], header.boxMin[2]);
+    }
+
+    glm::vec3 boxMax() const
+    {
+        return glm::vec3(header.boxMax[0], header.boxMax[1], header.boxMax[2]);
+    }
+
+    size_t keyframeInterval() const
+    {
+        return header.keyframeInterval;
+    }
+
+    TrajectoryCodec::FrameHeader frameHeader(size_t frame) const
+    {
+        TrajectoryCodec::FrameHeader result;
+        std::memcpy(&result, file.data() + index[frame], sizeof(result));
+        return result;
+    }
+
+    double frameTime(size_t frame) const
+    {
+        return frameHeader(frame).time;
+    }
+
+    // decode frame into fluid / soft (resized to the recorded counts)
+    bool readFrame(size_t frame, std::vector<glm::vec3> &fluid, std::vector<glm::vec3> &soft)
+    {
+        if (frame >= frames)
+            return false;
+        size_t keyframe = frame - frame % header.keyframeInterval;
+        // continue from the last decoded frame when it lies between the keyframe and the target
+        size_t first = (decoded != SIZE_MAX && decoded >= keyframe && decoded < frame) ? decoded + 1 : keyframe;
+        for (size_t f = first; f <= frame; f++)
+        {
+            TrajectoryCodec::FrameHeader header = frameHeader(f);
+            fluid.resize(header.fluidCount);
+            soft.resize(header.softCount);
+            codec.decode(f == keyframe, reinterpret_cast<const uint8_t *>(file.data() + index[f] + sizeof(header)), header.payloadSize,
+                         fluid.data(), fluid.size(), soft.data(), soft.size());
+        }
+        decoded = frame;
+        return true;
+    }
+
+private:
+    MappedFile file;
+    TrajectoryCodec::FileHeader header = {};
+    TrajectoryCodec codec;
+    const uint64_t *index = nullptr;
+    std::vector<uint64_t> scannedIndex;
+    size_t frames = 0;
+    size_t decoded = SIZE_MAX; // last frame that went through the codec
+
+    bool fail()
+    {
+        close();
+        header = {};
+        return false;
+    }
+
+    // every frame the index names, header and payload, lies between the file header and the index itself
+    bool indexValid(const uint64_t *entries, size_t count) const
+    {
+        const uint64_t frameHeaderSize = sizeof(TrajectoryCodec::FrameHeader);
+        for (size_t f = 0; f < count; f++)
+        {
+            uint64_t offset = entries[f];
+            if (offset < sizeof(header) || offset > header.indexOffset || header.indexOffset - offset < frameHeaderSize)
+                return false;
+            TrajectoryCodec::FrameHeader frame;
+            std::memcpy(&frame, file.data() + offset, sizeof(frame));
+            if (frame.payloadSize > header.indexOffset - offset - frameHeaderSize)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
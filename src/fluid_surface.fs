@@ -0,0 +1,25 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+
+uniform vec3 viewPos;
+uniform vec3 lightDir;
+uniform vec4 color;
+
+void main()
+{
+    vec3 norm = normalize(Normal);
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 toLight = normalize(-lightDir);
+
+    float diff = max(dot(norm, toLight), 0.0);
+    vec3 halfway = normalize(toLight + viewDir);
+    float spec = pow(max(dot(norm, halfway), 0.0), 64.0);
+    // fresnel, grazing angles reflect more
+    float fresnel = 0.04 + 0.96 * pow(1.0 - max(dot(norm, viewDir), 0.0), 5.0);
+
+    vec3 result = color.rgb * (0.25 + 0.75 * diff) + vec3(spec + 0.3 * fresnel);
+    FragColor = vec4(result, color.a);
+}
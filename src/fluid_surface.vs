@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+out vec3 FragPos;
+out vec3 Normal;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    FragPos = aPos; // extracted in world space
+    Normal = aNormal;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
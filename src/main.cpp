@@ -12,9 +12,15 @@
 #include <Graphic/shdaer_m.h>
 #include <camera.h>
 #include <objectloader.h>
+#include <meshoptimizer.h>
+#include <softbodycache.h>
+#include <Physics/SoftBodyWorld.h>
+#include <Physics/FluidCoupling.h>
+#include <Graphic/SoftBodyRenderBuffer.h>
 
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <Eigen/Dense>
 #include <Eigen/Eigenvalues>
 
@@ -44,10 +50,8 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 unsigned int loadTexture(char const *path);
 void renderSoftBody();
 void stepSolver(float frameTime);
-void stepSolver(float frameTime, SoftBodyMesh &softBody);
 void stepSolver(float frameTime, std::vector<SoftBodyObject *> &softBodies);
 std::vector<RenderAttribute> softBodyToVertex(std::vector<SoftBodyObject *> &objs);
-std::vector<RenderAttribute> softBodyToVertex(SoftBodyMesh &objs);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -148,12 +152,94 @@ const float GRAVITY = 0.0f;
 const float SPRING_CONSTANT = 1.0f;
 const float SPRING_DAMPING = 0.9f;
 const float SHAPE_STIFFNESS = 0.00005f;
+const float BEND_STIFFNESS = 0.02f;
+const float COLLISION_RADIUS = 0.01f; // vertex contact radius, also the thickness of triangle contacts between bodies
+
+// simulate dense meshes through a coarse voxel cage (render vertices are embedded)
+const bool USE_EMBEDDED_LATTICE = false;
+const int LATTICE_RESOLUTION = 8;
+
+// static mesh baked into a distance field at load, bodies collide with it besides the bounding box
+const bool USE_STATIC_COLLIDER = false;
+const char *STATIC_COLLIDER_PATH = "D:/CODE/ComGraphic/project-rework/resources/objects/plane.obj";
+const float STATIC_COLLIDER_VOXEL = 0.02f;
+
+// backward euler springs and projective dynamics can run at display rate, explicit springs need small steps
+const bool USE_IMPLICIT_INTEGRATOR = false;
+const bool USE_PROJECTIVE_DYNAMICS = false;
+const float SOFTBODY_TIMESTEP = (USE_IMPLICIT_INTEGRATOR || USE_PROJECTIVE_DYNAMICS) ? 1.0f / 60.0f : 1.0f / 720.0f;
+
+// gummies dropped into an SPH tank: FluidCoupling steps the fluid, pushes the bodies with it, then steps the bodies
+// the fluid works in its own units (particle gap 0.8, tank +-10), bodies are scaled into them and the scene is drawn scaled back
+const bool USE_FLUID_COUPLING = false;
+const int FLUID_GUMMIES = 3;
+const float FLUID_BODY_SCALE = 4.0f;  // mesh units -> fluid units
+const float FLUID_VIEW_SCALE = 0.2f;  // fluid units -> scene units, the tank lands on the floor
+const float FLUID_TIMESTEP = 1.0f / 240.0f;
+const int FLUID_BODY_SUBSTEPS = 3;    // explicit springs want 1/720
 
 int main()
 {
     // ObjectLoader
     SoftBodyMesh sdbmesh;
-    ObjectLoader::loadOBJ("D:/CODE/ComGraphic/project-rework/resources/objects/rabbit_with_texture.obj", sdbmesh);
+    // preprocessed mesh comes from rabbit_with_texture.sbm, rebuilt when the OBJ changes
+    SoftBodyMeshCache::load("D:/CODE/ComGraphic/project-rework/resources/objects/rabbit_with_texture.obj", sdbmesh);
+
+    // every simulated body lives in the world pool, sdbmesh only keeps topology for rendering
+    SoftBodyWorld softBodyWorld;
+    softBodyWorld.GRAVITY = GRAVITY;
+    softBodyWorld.SPRING_CONSTANT = SPRING_CONSTANT;
+    softBodyWorld.SPRING_DAMPING = SPRING_DAMPING;
+    softBodyWorld.SHAPE_STIFFNESS = SHAPE_STIFFNESS;
+    softBodyWorld.BEND_STIFFNESS = BEND_STIFFNESS;
+    softBodyWorld.collision.RADIUS = COLLISION_RADIUS;
+    softBodyWorld.triangleCollision.THICKNESS = COLLISION_RADIUS;
+
+    // the fluid fills the bottom of its tank, the gummies start in a row above it
+    std::unique_ptr<SPHSolver> fluid; // only built for the coupled scene
+    FluidCoupling coupling;
+    if (USE_FLUID_COUPLING)
+    {
+        fluid = std::make_unique<SPHSolver>(9.81f);
+        fluid->SPAWN_POS = glm::vec3(-4.0f, -9.0f, -4.0f);
+        fluid->resetSimulation();
+        coupling.BODY_SUBSTEPS = FLUID_BODY_SUBSTEPS;
+
+        ObjectLoader::scaleMesh(sdbmesh, FLUID_BODY_SCALE);
+        softBodyWorld.GRAVITY = fluid->GRAVITY;
+        softBodyWorld.BOX_MIN = fluid->BOX_MIN;
+        softBodyWorld.BOX_MAX = fluid->BOX_MAX;
+        softBodyWorld.RESTITUTION = fluid->RESTITUTION;
+        softBodyWorld.collision.RADIUS = COLLISION_RADIUS * FLUID_BODY_SCALE;
+        softBodyWorld.triangleCollision.THICKNESS = COLLISION_RADIUS * FLUID_BODY_SCALE;
+    }
+
+    std::vector<size_t> sdbBodies;
+    for (int g = 0; g < (USE_FLUID_COUPLING ? FLUID_GUMMIES : 1); g++)
+    {
+        glm::vec3 offset(0.0f);
+        if (USE_FLUID_COUPLING)
+            offset = glm::vec3(-5.0f + 10.0f * (g + 0.5f) / FLUID_GUMMIES, 4.0f, 0.0f) - sdbmesh.x_cm_zero;
+        size_t body = USE_EMBEDDED_LATTICE ? softBodyWorld.addEmbeddedBody(sdbmesh, LATTICE_RESOLUTION, offset)
+                                           : softBodyWorld.addBody(sdbmesh, offset);
+        if (USE_IMPLICIT_INTEGRATOR)
+            softBodyWorld.setIntegrator(body, IMPLICIT_EULER);
+        if (USE_PROJECTIVE_DYNAMICS)
+            softBodyWorld.setIntegrator(body, PROJECTIVE_DYNAMICS, USE_FLUID_COUPLING ? FLUID_TIMESTEP / FLUID_BODY_SUBSTEPS : SOFTBODY_TIMESTEP); // factor once at load
+        sdbBodies.push_back(body);
+    }
+    size_t sdbBody = sdbBodies[0];
+
+    ColliderSet staticColliders;
+    if (USE_STATIC_COLLIDER)
+    {
+        SoftBodyMesh colliderMesh;
+        SoftBodyMeshCache::load(STATIC_COLLIDER_PATH, colliderMesh);
+        SDFCollider &collider = staticColliders.add();
+        collider.bake(colliderMesh, STATIC_COLLIDER_VOXEL);
+        std::cout << "Baked collider: " << collider.activeBricks << "/" << collider.totalBricks << " bricks in " << collider.lastBakeMs << " ms" << std::endl;
+        softBodyWorld.colliders = &staticColliders;
+    }
 
     // glfw: initialize and configure
     // ------------------------------
@@ -320,22 +406,18 @@ int main()
     //     vel.y = 0.3f;
     //     vel.z = -0.2f;
     // }
-    std::vector<RenderAttribute> testMesh = softBodyToVertex(sdbmesh);
-
-    unsigned int newSoftBodyVAO, newSoftBodyVBO;
-    glGenVertexArrays(1, &newSoftBodyVAO);
-    glGenBuffers(1, &newSoftBodyVBO);
-    glBindVertexArray(newSoftBodyVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, newSoftBodyVBO);
-
-    glBufferData(GL_ARRAY_BUFFER, testMesh.size() * sizeof(RenderAttribute), testMesh.data(), GL_DYNAMIC_DRAW);
-    // glBufferData(GL_ARRAY_BUFFER, vertex.vertices.size() * sizeof(glm::vec3) + vertex.texCord.size() * sizeof(glm::vec3), cubeListRender.data(), GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(RenderAttribute), (void *)offsetof(RenderAttribute, vertex));
+    // indexed render buffer, uvs and indices are uploaded once, positions are streamed after every step
+    SoftBodyRenderBuffer softBodyRenderBuffer;
+    softBodyRenderBuffer.create(sdbmesh);
+
+    // fluid particles as points, positions are streamed every frame
+    unsigned int fluidVAO, fluidVBO;
+    glGenVertexArrays(1, &fluidVAO);
+    glGenBuffers(1, &fluidVBO);
+    glBindVertexArray(fluidVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, fluidVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(RenderAttribute), (void *)offsetof(RenderAttribute, normal));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(RenderAttribute), (void *)offsetof(RenderAttribute, texCoord));
-    glEnableVertexAttribArray(2);
     glBindVertexArray(0);
 
     // --- set up a simple white plane (floor) ---
@@ -504,12 +586,21 @@ int main()
         // glDrawElements(GL_TRIANGLES, softBodyIndices.size(), GL_UNSIGNED_INT, 0);
         // glBindVertexArray(0);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glBindVertexArray(newSoftBodyVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, newSoftBodyVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, testMesh.size() * sizeof(RenderAttribute), testMesh.data());
-        // glDrawElements(GL_TRIANGLES, softBodyIndices.size(), GL_UNSIGNED_INT, 0);
-        glDrawArrays(GL_TRIANGLES, 0, testMesh.size());
-        glBindVertexArray(0);
+        if (USE_FLUID_COUPLING)
+        {
+            // every gummy goes through the one render buffer
+            lightingShader.setMat4("model", glm::scale(glm::mat4(1.0f), glm::vec3(FLUID_VIEW_SCALE)));
+            for (size_t body : sdbBodies)
+            {
+                softBodyWorld.syncMesh(body, sdbmesh);
+                softBodyRenderBuffer.update(sdbmesh);
+                softBodyRenderBuffer.draw();
+            }
+        }
+        else
+        {
+            softBodyRenderBuffer.draw();
+        }
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
         // also draw the lamp object(s)
@@ -528,17 +619,41 @@ int main()
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
 
+        if (USE_FLUID_COUPLING)
+        {
+            lightCubeShader.setMat4("model", glm::scale(glm::mat4(1.0f), glm::vec3(FLUID_VIEW_SCALE)));
+            glBindVertexArray(fluidVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, fluidVBO);
+            glBufferData(GL_ARRAY_BUFFER, fluid->alive * sizeof(glm::vec3), fluid->positions.data(), GL_STREAM_DRAW);
+            glPointSize(3.0f);
+            glDrawArrays(GL_POINTS, 0, fluid->alive);
+            glBindVertexArray(0);
+        }
+
         // stepSolver(1.0f / 720.0f);
         if (!isSimulationPaused)
         {
-            for (auto &vel : sdbmesh.velocities)
+            softBodyWorld.addVelocity(userForce);
+            userForce = glm::vec3(0.0f);
+            bool wasAsleep = softBodyWorld.isAsleep(sdbBody);
+            if (USE_FLUID_COUPLING)
+                coupling.step(*fluid, softBodyWorld, FLUID_TIMESTEP, fluid->BOX_MIN, fluid->BOX_MAX);
+            else
+                softBodyWorld.step(SOFTBODY_TIMESTEP);
+            std::string title = "LearnOpenGL | awake: " + std::to_string(softBodyWorld.awakeBodies()) +
+                                " asleep: " + std::to_string(softBodyWorld.asleepBodies());
+            if (USE_IMPLICIT_INTEGRATOR)
+                title += " | CG iterations: " + std::to_string(softBodyWorld.lastCGIterations());
+            if (USE_FLUID_COUPLING)
+                title += " | fluid: " + std::to_string(coupling.lastFluidMs) + " ms bodies: " + std::to_string(coupling.lastBodyMs) + " ms";
+            glfwSetWindowTitle(window, title.c_str());
+            // a body that slept through the step has not moved, the mesh and the GPU buffer still hold its last state
+            // (the fluid scene restreams every gummy when drawing)
+            if (!wasAsleep && !USE_FLUID_COUPLING)
             {
-
-                vel += userForce;
+                softBodyWorld.syncMesh(sdbBody, sdbmesh);
+                softBodyRenderBuffer.update(sdbmesh);
             }
-            userForce = glm::vec3(0.0f);
-            stepSolver(1.0f / 720.0f, sdbmesh);
-            testMesh = softBodyToVertex(sdbmesh);
         }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -554,6 +669,9 @@ int main()
     // glDeleteVertexArrays(1, &planeVAO);
     // glDeleteBuffers(1, &VBO);
     // glDeleteBuffers(1, &planeVBO);
+    softBodyRenderBuffer.destroy(); // GL objects have to go before the context
+    glDeleteVertexArrays(1, &fluidVAO);
+    glDeleteBuffers(1, &fluidVBO);
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -761,125 +879,6 @@ void stepSolver(float frameTime, std::vector<SoftBodyObject *> &softBodies)
     }
 }
 
-void stepSolver(float frameTime, SoftBodyMesh &softBody)
-{
-
-    glm::vec3 x_cm(0.0f);
-    for (size_t i = 0; i < softBody.vertices.size(); ++i)
-    {
-        softBody.velocities[i].y -= GRAVITY * frameTime;
-        x_cm += softBody.vertices[i];
-    }
-    x_cm /= softBody.vertices.size();
-
-    glm::mat3 A_pq(0.0f);
-    for (size_t i = 0; i < softBody.vertices.size(); ++i)
-    {
-        glm::vec3 p_i = softBody.vertices[i] - x_cm; // Current position relative to center
-        glm::vec3 q_i = softBody.x_offset_zero[i];   // Rest position relative to center
-        A_pq += glm::outerProduct(p_i, q_i);
-    }
-    Eigen::Matrix3d apq;
-    for (int i = 0; i < 3; ++i)
-    {
-        for (int j = 0; j < 3; ++j)
-        {
-            apq(i, j) = A_pq[j][i]; // Note: GLM uses column-major, Eigen defaults to column-major but can be row-major
-        }
-    }
-
-    Eigen::JacobiSVD<Eigen::Matrix3d> svd(apq, Eigen::ComputeFullU | Eigen::ComputeFullV);
-    Eigen::Matrix3d R_eigen = svd.matrixU() * svd.matrixV().transpose();
-
-    // Ensure the rotation matrix is proper (no reflection/inversion)
-    if (R_eigen.determinant() < 0)
-    {
-        Eigen::Matrix3d U_mod = svd.matrixU();
-        U_mod.col(2) *= -1; // Flip the last column
-        R_eigen = U_mod * svd.matrixV().transpose();
-    }
-
-    // std::cout << R_eigen;
-    // Convert Eigen rotation matrix back to GLM
-    glm::mat3 R;
-    for (int i = 0; i < 3; ++i)
-    {
-        for (int j = 0; j < 3; ++j)
-        {
-            R[j][i] = R_eigen(i, j);
-        }
-    }
-
-    for (size_t i = 0; i < softBody.vertices.size(); ++i)
-    {
-        glm::vec3 goal_pos = (R * softBody.x_offset_zero[i]) + x_cm;
-        glm::vec3 goal_pos_diff = (goal_pos - softBody.vertices[i]) * (SHAPE_STIFFNESS / frameTime);
-
-        softBody.velocities[i] += goal_pos_diff;
-        // std::cout << goal_pos_diff.x << "," << goal_pos_diff.y << "," << goal_pos_diff.z << "\n";
-    }
-
-    for (auto &constraint : softBody.structuralPairs)
-    {
-        glm::vec3 i = softBody.vertices[constraint.pair.first];
-        glm::vec3 j = softBody.vertices[constraint.pair.second];
-        glm::vec3 vi = softBody.velocities[constraint.pair.first];
-        glm::vec3 vj = softBody.velocities[constraint.pair.second];
-
-        float current_dist = glm::length(i - j);
-        if (current_dist < 1e-6f)
-            continue;
-
-        glm::vec3 dir = glm::normalize(j - i);
-
-        float spring_force = SPRING_CONSTANT * (current_dist - constraint.distance);
-        float damping_force = SPRING_DAMPING * glm::dot(dir, vj - vi);
-
-        glm::vec3 force = dir * (spring_force + damping_force) * frameTime;
-
-        softBody.velocities[constraint.pair.first] += force;
-        softBody.velocities[constraint.pair.second] -= force;
-    }
-
-    float damping = 1.0f;
-    for (size_t i = 0; i < softBody.vertices.size(); ++i)
-    {
-
-        softBody.vertices[i] += softBody.velocities[i] * frameTime;
-        // collision with ground plane at y = -1.0f
-        if (softBody.vertices[i].y < -2.0f)
-        {
-            softBody.vertices[i].y = -2.0f;
-            softBody.velocities[i].y *= -1.0f * damping; // Simple collision response
-        }
-        if (softBody.vertices[i].y > 2.0f)
-        {
-            softBody.vertices[i].y = 2.0f;
-            softBody.velocities[i].y *= -1.0f * damping; // Simple collision response
-        }
-        if (softBody.vertices[i].x > 2.0f)
-        {
-            softBody.vertices[i].x = 2.0f;
-            softBody.velocities[i].x *= -1.0f * damping; // Simple collision response
-        }
-        if (softBody.vertices[i].x < -2.0f)
-        {
-            softBody.vertices[i].x = -2.0f;
-            softBody.velocities[i].x *= -1.0f * damping; // Simple collision response
-        }
-        if (softBody.vertices[i].z > 2.0f)
-        {
-            softBody.vertices[i].z = 2.0f;
-            softBody.velocities[i].z *= -1.0f * damping; // Simple collision response
-        }
-        if (softBody.vertices[i].z < -2.0f)
-        {
-            softBody.vertices[i].z = -2.0f;
-            softBody.velocities[i].z *= -1.0f * damping; // Simple collision response
-        }
-    }
-}
-
 std::vector<RenderAttribute> softBodyToVertex(std::vector<SoftBodyObject *> &objs)
 {
     // number of vertex equal to mesh indices size
@@ -896,19 +895,3 @@ std::vector<RenderAttribute> softBodyToVertex(std::vector<SoftBodyObject *> &obj
 
     return result;
 }
-
-std::vector<RenderAttribute> softBodyToVertex(SoftBodyMesh &objs)
-{
-
-    // number of vertex equal to mesh indices size
-    std::vector<RenderAttribute> result;
-    size_t total_face = objs.faces.size() / 3; // vertex & texture & normal = 3
-    result.reserve(total_face);
-
-    for (size_t face_idx = 0; face_idx < objs.faces.size(); face_idx += 3)
-    {
-        result.push_back({objs.vertices[objs.faces[face_idx]], objs.normals[objs.faces[face_idx + 2]], objs.texCoords[objs.faces[face_idx + 1]]});
-    }
-
-    return result;
-}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#version 330 core
+out float Depth;
+
+in vec2 TexCoords;
+
+uniform sampler2D depthMap;
+uniform vec2 direction; // one texel along the blurred axis
+uniform int filterRadius;
+uniform float blurScale;
+uniform float depthFalloff;
+
+void main()
+{
+    float depth = texture(depthMap, TexCoords).r;
+    if (depth <= 0.0)
+    {
+        Depth = 0.0;
+        return;
+    }
+
+    float sum = 0.0;
+    float weightSum = 0.0;
+    for (int i = -filterRadius; i <= filterRadius; i++)
+    {
+        float tap = texture(depthMap, TexCoords + float(i) * direction).r;
+        if (tap <= 0.0)
+            continue; // background does not pull the edge away
+        // spatial gaussian times range gaussian on the depth difference
+        float r = float(i) * blurScale;
+        float w = exp(-r * r);
+        float d = (tap - depth) * depthFalloff;
+        float g = exp(-d * d);
+        sum += tap * w * g;
+        weightSum += w * g;
+    }
+    Depth = weightSum > 0.0 ? sum / weightSum : depth;
+}
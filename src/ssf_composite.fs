@@ -0,0 +1,55 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D depthMap;
+uniform sampler2D thicknessMap;
+uniform mat4 projection;
+uniform vec2 texelSize; // of the offscreen targets
+uniform vec3 lightDir;  // eye space
+uniform vec4 fluidColor;
+uniform float absorption;
+
+// eye space position of the fluid surface at uv
+vec3 eyePosition(vec2 uv)
+{
+    float depth = texture(depthMap, uv).r;
+    vec2 ndc = uv * 2.0 - 1.0;
+    return vec3(ndc.x * depth / projection[0][0], ndc.y * depth / projection[1][1], -depth);
+}
+
+void main()
+{
+    float depth = texture(depthMap, TexCoords).r;
+    if (depth <= 0.0)
+        discard;
+    vec3 pos = eyePosition(TexCoords);
+
+    // one sided differences, take the side with the smaller step so silhouettes do not bend the normal
+    vec3 ddx = eyePosition(TexCoords + vec2(texelSize.x, 0.0)) - pos;
+    vec3 ddx2 = pos - eyePosition(TexCoords - vec2(texelSize.x, 0.0));
+    if (abs(ddx.z) > abs(ddx2.z))
+        ddx = ddx2;
+    vec3 ddy = eyePosition(TexCoords + vec2(0.0, texelSize.y)) - pos;
+    vec3 ddy2 = pos - eyePosition(TexCoords - vec2(0.0, texelSize.y));
+    if (abs(ddy.z) > abs(ddy2.z))
+        ddy = ddy2;
+    vec3 norm = normalize(cross(ddx, ddy));
+
+    vec3 viewDir = normalize(-pos);
+    vec3 toLight = normalize(-lightDir);
+    float diff = max(dot(norm, toLight), 0.0);
+    vec3 halfway = normalize(toLight + viewDir);
+    float spec = pow(max(dot(norm, halfway), 0.0), 64.0);
+    float fresnel = 0.04 + 0.96 * pow(1.0 - max(dot(norm, viewDir), 0.0), 5.0);
+
+    // Beer-Lambert: thick fluid absorbs more of what is behind it
+    float thickness = texture(thicknessMap, TexCoords).r;
+    float transmission = exp(-absorption * thickness);
+    vec3 result = fluidColor.rgb * (0.25 + 0.75 * diff) + vec3(spec + 0.3 * fresnel);
+    FragColor = vec4(result, fluidColor.a * clamp(1.0 - transmission + fresnel, 0.0, 1.0));
+
+    vec4 clipPos = projection * vec4(pos, 1.0);
+    gl_FragDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+}
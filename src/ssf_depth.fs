@@ -0,0 +1,20 @@
+#version 330 core
+out float Depth;
+
+in vec2 Corner;
+in vec3 EyeCenter;
+
+uniform mat4 projection;
+uniform float radius;
+
+void main()
+{
+    float r2 = dot(Corner, Corner);
+    if (r2 > 1.0)
+        discard;
+    // front point of the sphere under this fragment
+    vec3 eyePos = EyeCenter + vec3(Corner, sqrt(1.0 - r2)) * radius;
+    vec4 clipPos = projection * vec4(eyePos, 1.0);
+    gl_FragDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+    Depth = -eyePos.z; // linear eye depth, 0 is reserved for empty
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;    // quad corner in [-0.5, 0.5]
+layout (location = 1) in vec3 aOffset; // particle center
+
+out vec2 Corner;
+out vec3 EyeCenter;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float radius;
+
+void main()
+{
+    EyeCenter = (view * vec4(aOffset, 1.0)).xyz;
+    Corner = aPos.xy * 2.0; // [-1, 1], the unit disc is the sphere
+    // camera facing billboard around the center
+    vec3 eyePos = EyeCenter + vec3(Corner * radius, 0.0);
+    gl_Position = projection * vec4(eyePos, 1.0);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+out float Thickness;
+
+in vec2 Corner;
+in vec3 EyeCenter;
+
+uniform float radius;
+
+void main()
+{
+    float r2 = dot(Corner, Corner);
+    if (r2 > 1.0)
+        discard;
+    Thickness = 2.0 * sqrt(1.0 - r2) * radius; // chord through the sphere, blended additively
+}